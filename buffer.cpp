@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "buffer.h"
+
+//-----------------------------------------------------------------------------
+
+namespace buffer
+{
+
+//=============================================================================
+
+Buffer::Buffer(size_t capacity)
+    : m_data(capacity), m_size(0)
+{}
+
+//-----------------------------------------------------------------------------
+
+char * Buffer::data()
+{
+    return m_data.data();
+}
+
+//-----------------------------------------------------------------------------
+
+const char * Buffer::data() const
+{
+    return m_data.data();
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Buffer::size() const
+{
+    return m_size;
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Buffer::capacity() const
+{
+    return m_data.size();
+}
+
+//-----------------------------------------------------------------------------
+
+void Buffer::clear()
+{
+    m_size = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+void Buffer::resize(size_t size)
+{
+    m_reserve(size);
+    m_size = size;
+}
+
+//-----------------------------------------------------------------------------
+
+void Buffer::append(const char * data, size_t size)
+{
+    m_reserve(m_size + size);
+    memcpy(m_data.data() + m_size, data, size);
+    m_size += size;
+}
+
+//-----------------------------------------------------------------------------
+
+void Buffer::append(const std::string & data)
+{
+    append(data.data(), data.size());
+}
+
+//-----------------------------------------------------------------------------
+
+void Buffer::append(const char * data)
+{
+    append(data, strlen(data));
+}
+
+//-----------------------------------------------------------------------------
+
+void Buffer::append(char symbol)
+{
+    m_reserve(m_size + 1);
+    m_data[m_size++] = symbol;
+}
+
+//-----------------------------------------------------------------------------
+
+void Buffer::appendWord(uint32_t word)
+{
+    m_reserve(m_size + sizeof(word));
+
+    for (unsigned int i = 0; i < sizeof(word); i++)
+        m_data[m_size++] = char((word >> (8 * i)) & 0xff);
+}
+
+//-----------------------------------------------------------------------------
+
+void Buffer::appendHex(uint32_t value)
+{
+    static const char digits[] = "0123456789abcdef";
+    static const size_t width = 8;
+
+    m_reserve(m_size + width + 2);
+    m_data[m_size++] = '0';
+    m_data[m_size++] = 'x';
+
+    for (size_t i = width; i > 0; i--)
+        m_data[m_size++] = digits[(value >> (4 * (i - 1))) & 0xf];
+}
+
+//-----------------------------------------------------------------------------
+
+void Buffer::appendDec(uint64_t value)
+{
+    // Цифры записываются с конца во временный массив (не больше 20 цифр).
+    char digits[20];
+    size_t count = 0;
+
+    do
+    {
+        digits[sizeof(digits) - ++count] = char('0' + value % 10);
+        value /= 10;
+    }
+    while (value);
+
+    append(digits + sizeof(digits) - count, count);
+}
+
+//-----------------------------------------------------------------------------
+
+void Buffer::appendDouble(double value, int precision, bool fixed)
+{
+    auto format = fixed ? "%.*f" : "%.*g";
+
+    // Обычно число помещается в запас памяти, иначе память увеличивается
+    // до размера числа и оно записывается повторно.
+    m_reserve(m_size + s_numberSize);
+    auto free = m_data.size() - m_size;
+    auto len = size_t(snprintf(m_data.data() + m_size, free, format, precision,
+                               value));
+    if (len >= free)
+    {
+        m_reserve(m_size + len + 1);
+        snprintf(m_data.data() + m_size, len + 1, format, precision, value);
+    }
+
+    m_size += len;
+}
+
+//-----------------------------------------------------------------------------
+
+void Buffer::m_reserve(size_t size)
+{
+    if (size <= m_data.size())
+        return;
+
+    // Увеличивать память с запасом, чтобы не выделять ее на каждое добавление.
+    auto capacity = m_data.size() ? m_data.size() : s_defaultCapacity;
+    while (capacity < size)
+        capacity *= 2;
+
+    m_data.resize(capacity);
+}
+
+//=============================================================================
+
+} // namespace buffer
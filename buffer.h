@@ -0,0 +1,88 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+//-----------------------------------------------------------------------------
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+
+namespace buffer
+{
+
+//=============================================================================
+
+// Байтовый буфер с повторным использованием памяти. Память выделяется один раз
+// и не освобождается при очистке, поэтому после прогрева буфер работает без
+// выделений памяти.
+class Buffer
+{
+public:
+
+    Buffer(size_t capacity = s_defaultCapacity);
+    ~Buffer() {}
+
+    //-------------------------------------------------------------------------
+
+    // Получить указатель на данные.
+    char * data();
+    const char * data() const;
+    // Получить размер данных.
+    size_t size() const;
+    // Получить размер выделенной памяти.
+    size_t capacity() const;
+
+    //-------------------------------------------------------------------------
+
+    // Очистить буфер (память не освобождается).
+    void clear();
+    // Установить размер данных (память увеличивается при необходимости).
+    void resize(size_t size);
+    // Добавить данные в конец буфера.
+    void append(const char * data, size_t size);
+    // Добавить строку в конец буфера.
+    void append(const std::string & data);
+    void append(const char * data);
+    // Добавить символ в конец буфера.
+    void append(char symbol);
+
+    //-------------------------------------------------------------------------
+
+    // Добавить 32-битное слово в порядке little-endian.
+    void appendWord(uint32_t word);
+    // Добавить число в HEX-виде с ведущими нулями ("0x0000abcd").
+    void appendHex(uint32_t value);
+    // Добавить целое число в десятичном виде.
+    void appendDec(uint64_t value);
+    // Добавить число с плавающей точкой (fixed - precision знаков после
+    // запятой, иначе precision значащих цифр, как в std::stringstream).
+    void appendDouble(double value, int precision, bool fixed = false);
+
+private:
+
+    // Размер выделяемой по умолчанию памяти.
+    static const size_t s_defaultCapacity = 8192;
+    // Запас памяти для записи числа с плавающей точкой.
+    static const size_t s_numberSize = 32;
+
+    //-------------------------------------------------------------------------
+
+    // Память буфера.
+    std::vector<char> m_data;
+    // Размер данных в буфере.
+    size_t m_size;
+
+    //-------------------------------------------------------------------------
+
+    // Увеличить память, чтобы в буфер поместилось size байт.
+    void m_reserve(size_t size);
+};
+
+//=============================================================================
+
+} // namespace buffer
+
+#endif // BUFFER_H
@@ -0,0 +1,261 @@
+#include <string.h>
+#include <algorithm>
+
+#include "column.h"
+
+//-----------------------------------------------------------------------------
+
+namespace col
+{
+
+//=============================================================================
+
+ChunkBuilder::ChunkBuilder(uint32_t base, uint32_t regs, uint32_t maxRows)
+    : m_base(base), m_regs(regs), m_maxRows(maxRows), m_columns(regs + 1)
+{
+    // Память колонок выделяется один раз.
+    for (auto it = m_columns.begin(); it != m_columns.end(); it++)
+        it->reserve(maxRows);
+}
+
+//-----------------------------------------------------------------------------
+
+void ChunkBuilder::add(uint64_t stamp, const uint32_t * values)
+{
+    m_columns[0].push_back(stamp);
+    for (uint32_t i = 0; i < m_regs; i++)
+        m_columns[i + 1].push_back(values[i]);
+}
+
+//-----------------------------------------------------------------------------
+
+bool ChunkBuilder::isFull() const
+{
+    return m_columns[0].size() >= m_maxRows;
+}
+
+//-----------------------------------------------------------------------------
+
+uint32_t ChunkBuilder::getRows() const
+{
+    return uint32_t(m_columns[0].size());
+}
+
+//-----------------------------------------------------------------------------
+
+uint32_t ChunkBuilder::getBase() const
+{
+    return m_base;
+}
+
+//-----------------------------------------------------------------------------
+
+uint32_t ChunkBuilder::getRegs() const
+{
+    return m_regs;
+}
+
+//-----------------------------------------------------------------------------
+
+uint64_t ChunkBuilder::getFirstStamp() const
+{
+    return m_columns[0].size() ? m_columns[0].front() : 0;
+}
+
+//-----------------------------------------------------------------------------
+
+void ChunkBuilder::encode(buffer::Buffer & out)
+{
+    chunkHeader_t header {s_magic, m_base, m_regs, getRows()};
+    out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    // Метки времени - разностями второго порядка, регистры - первого.
+    for (size_t i = 0; i < m_columns.size(); i++)
+        m_encodeColumn(m_columns[i], i ? 1 : 2, out);
+
+    // Минимумы и максимумы колонок.
+    for (auto it = m_columns.begin(); it != m_columns.end(); it++)
+    {
+        columnStat_t stat {0, 0};
+        if (it->size())
+        {
+            auto minmax = std::minmax_element(it->begin(), it->end());
+            stat = {*minmax.first, *minmax.second};
+        }
+        out.append(reinterpret_cast<const char *>(&stat), sizeof(stat));
+    }
+
+    for (auto it = m_columns.begin(); it != m_columns.end(); it++)
+        it->clear();
+}
+
+//-----------------------------------------------------------------------------
+
+void ChunkBuilder::m_encodeColumn(const std::vector<uint64_t> & values,
+                                  uint8_t order, buffer::Buffer & out)
+{
+    auto rows = values.size();
+    columnHeader_t header {rows ? values[0] : 0,
+                           rows > 1 ? values[1] - values[0] : 0,
+                           0, order, 0, 0};
+
+    // Разность порядка order, переведенная в беззнаковый вид (zigzag).
+    auto residual = [&values, order](size_t i)
+    {
+        auto delta = int64_t(values[i] - values[i - 1]);
+        if (order == 2)
+            delta -= int64_t(values[i - 1] - values[i - 2]);
+        return (uint64_t(delta) << 1) ^ uint64_t(delta >> 63);
+    };
+
+    // Ширина упаковки - по наибольшей разности колонки.
+    uint64_t maxResidual = 0;
+    for (size_t i = order; i < rows; i++)
+        maxResidual = std::max(maxResidual, residual(i));
+    while (header.width < 64 && (maxResidual >> header.width))
+        header.width++;
+
+    auto count = rows > order ? rows - order : 0;
+    header.bytes = uint32_t((count * header.width + 7) / 8);
+    out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    // Упаковать разности младшими битами вперед.
+    uint8_t byte = 0;
+    unsigned int bitPos = 0;
+    for (size_t i = order; i < rows; i++)
+    {
+        auto value = residual(i);
+        for (unsigned int bit = 0; bit < header.width;)
+        {
+            auto take = std::min(8 - bitPos, header.width - bit);
+            byte |= uint8_t(((value >> bit) & ((1u << take) - 1)) << bitPos);
+            bit += take;
+            bitPos += take;
+            if (bitPos == 8)
+            {
+                out.append(char(byte));
+                byte = 0;
+                bitPos = 0;
+            }
+        }
+    }
+
+    if (bitPos)
+        out.append(char(byte));
+}
+
+//=============================================================================
+
+ChunkReader::ChunkReader()
+    : m_data(nullptr), m_size(0), m_header {0, 0, 0, 0}
+{}
+
+//-----------------------------------------------------------------------------
+
+bool ChunkReader::open(const char * data, size_t size)
+{
+    m_data = data;
+    m_size = size;
+    m_offsets.clear();
+
+    if (size < sizeof(m_header))
+        return false;
+
+    memcpy(&m_header, data, sizeof(m_header));
+    auto footer = (size_t(m_header.regs) + 1) * sizeof(columnStat_t);
+    if (m_header.magic != s_magic || footer > size - sizeof(m_header))
+        return false;
+
+    // Найти колонки, проверяя, что они не выходят за блок.
+    auto offset = sizeof(m_header);
+    for (uint32_t i = 0; i <= m_header.regs; i++)
+    {
+        columnHeader_t column;
+        if (offset + sizeof(column) > size - footer)
+            return false;
+
+        memcpy(&column, data + offset, sizeof(column));
+        if (offset + sizeof(column) + column.bytes > size - footer)
+            return false;
+
+        m_offsets.push_back(offset);
+        offset += sizeof(column) + column.bytes;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+const chunkHeader_t & ChunkReader::getHeader() const
+{
+    return m_header;
+}
+
+//-----------------------------------------------------------------------------
+
+columnStat_t ChunkReader::getStat(uint32_t column) const
+{
+    columnStat_t stat {0, 0};
+    if (column > m_header.regs)
+        return stat;
+
+    auto footer = (size_t(m_header.regs) + 1) * sizeof(columnStat_t);
+    memcpy(&stat, m_data + m_size - footer + column * sizeof(stat), sizeof(stat));
+    return stat;
+}
+
+//-----------------------------------------------------------------------------
+
+bool ChunkReader::decode(uint32_t column, std::vector<uint64_t> & values) const
+{
+    values.clear();
+    if (column >= m_offsets.size())
+        return false;
+
+    columnHeader_t header;
+    memcpy(&header, m_data + m_offsets[column], sizeof(header));
+
+    auto rows = size_t(m_header.rows);
+    auto count = rows > header.order ? rows - header.order : 0;
+    // Размер сравнивается в 64 битах: в поврежденном заголовке произведение
+    // может переполнить size_t.
+    if (header.order < 1 || header.order > 2 || header.width > 64 ||
+        (uint64_t(count) * header.width + 7) / 8 > header.bytes)
+        return false;
+
+    if (rows)
+        values.push_back(header.first);
+    if (header.order == 2 && rows > 1)
+        values.push_back(header.first + header.delta);
+
+    auto packed = reinterpret_cast<const uint8_t *>(m_data + m_offsets[column] +
+                                                    sizeof(header));
+    size_t bitPos = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t residual = 0;
+        for (unsigned int bit = 0; bit < header.width;)
+        {
+            auto shift = unsigned(bitPos % 8);
+            auto take = std::min(8 - shift, header.width - bit);
+            residual |= uint64_t((packed[bitPos / 8] >> shift) &
+                                 ((1u << take) - 1)) << bit;
+            bit += take;
+            bitPos += take;
+        }
+
+        // Обратное преобразование zigzag и восстановление значения.
+        auto delta = int64_t(residual >> 1) ^ -int64_t(residual & 1);
+        auto size = values.size();
+        if (header.order == 2)
+            delta += int64_t(values[size - 1] - values[size - 2]);
+        values.push_back(values[size - 1] + uint64_t(delta));
+    }
+
+    return true;
+}
+
+//=============================================================================
+
+} // namespace col
@@ -0,0 +1,130 @@
+#ifndef COLUMN_H
+#define COLUMN_H
+
+//-----------------------------------------------------------------------------
+
+#include <vector>
+#include <stdint.h>
+
+#include "buffer.h"
+
+//-----------------------------------------------------------------------------
+
+namespace col
+{
+
+//=============================================================================
+
+// Заголовок блока отсчетов одного устройства.
+typedef struct chunkHeader
+{
+    uint32_t magic;     // Признак блока.
+    uint32_t base;      // Базовый адрес устройства.
+    uint32_t regs;      // Количество регистров.
+    uint32_t rows;      // Количество отсчетов.
+} chunkHeader_t;
+
+// Заголовок колонки блока.
+typedef struct columnHeader
+{
+    uint64_t first;     // Первое значение.
+    uint64_t delta;     // Первая разность (для разностей второго порядка).
+    uint32_t bytes;     // Размер упакованных разностей.
+    uint8_t order;      // Порядок разностей (1 или 2).
+    uint8_t width;      // Количество бит на упакованную разность.
+    uint16_t reserved;
+} columnHeader_t;
+
+// Минимальное и максимальное значения колонки (в конце блока, чтобы блок
+// можно было пропустить без распаковки).
+typedef struct columnStat
+{
+    uint64_t min;
+    uint64_t max;
+} columnStat_t;
+
+// Признак блока ("COL1").
+static const uint32_t s_magic = 0x314c4f43;
+
+//-----------------------------------------------------------------------------
+
+// Блок отсчетов устройства в колоночном виде: метки времени и каждый регистр
+// хранятся отдельными колонками. Колонка кодируется разностями соседних
+// значений (метки времени - разностями второго порядка, так как период
+// считывания почти постоянен), разности переводятся в беззнаковый вид
+// (zigzag) и упаковываются минимальным для колонки количеством бит.
+// Все числа хранятся в порядке little-endian.
+class ChunkBuilder
+{
+public:
+
+    ChunkBuilder(uint32_t base, uint32_t regs, uint32_t maxRows);
+
+    //-------------------------------------------------------------------------
+
+    // Добавить отсчет (values - значения всех регистров).
+    void add(uint64_t stamp, const uint32_t * values);
+    // Проверить заполнен ли блок.
+    bool isFull() const;
+    // Получить количество отсчетов.
+    uint32_t getRows() const;
+    // Получить базовый адрес устройства.
+    uint32_t getBase() const;
+    // Получить количество регистров.
+    uint32_t getRegs() const;
+    // Получить метку времени первого отсчета.
+    uint64_t getFirstStamp() const;
+    // Закодировать блок в out и начать новый.
+    void encode(buffer::Buffer & out);
+
+private:
+
+    // Базовый адрес и количество регистров устройства.
+    uint32_t m_base;
+    uint32_t m_regs;
+    // Максимальное количество отсчетов в блоке.
+    uint32_t m_maxRows;
+    // Колонки (0 - метки времени, далее регистры).
+    std::vector<std::vector<uint64_t>> m_columns;
+
+    // Закодировать колонку.
+    void m_encodeColumn(const std::vector<uint64_t> & values, uint8_t order,
+                        buffer::Buffer & out);
+};
+
+//-----------------------------------------------------------------------------
+
+// Чтение блока отсчетов.
+class ChunkReader
+{
+public:
+
+    ChunkReader();
+
+    //-------------------------------------------------------------------------
+
+    // Проверить блок (false - данные не являются блоком).
+    bool open(const char * data, size_t size);
+    // Получить заголовок блока.
+    const chunkHeader_t & getHeader() const;
+    // Получить минимум и максимум колонки (0 - метки времени).
+    columnStat_t getStat(uint32_t column) const;
+    // Распаковать колонку (0 - метки времени).
+    bool decode(uint32_t column, std::vector<uint64_t> & values) const;
+
+private:
+
+    // Данные блока.
+    const char * m_data;
+    size_t m_size;
+    // Заголовок блока.
+    chunkHeader_t m_header;
+    // Смещения колонок в блоке.
+    std::vector<size_t> m_offsets;
+};
+
+//=============================================================================
+
+} // namespace col
+
+#endif // COLUMN_H
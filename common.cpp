@@ -20,4 +20,6 @@ namespace sep
 {
     char dataSep = ',';
     char baseSep = '/';
+    char optSep  = ':';
+    char valSep  = '=';
 }
@@ -25,6 +25,8 @@ namespace sep
 {
     extern char dataSep;
     extern char baseSep;
+    extern char optSep;
+    extern char valSep;
 }
 
 //-----------------------------------------------------------------------------
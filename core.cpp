@@ -1,3 +1,6 @@
+#include <signal.h>
+#include <pthread.h>
+
 #include "core.h"
 
 namespace core
@@ -5,8 +8,8 @@ namespace core
 
 //=============================================================================
 
-Core::Core():
-    m_devStat{&m_pkgCV}
+Core::Core()
+    : m_receiving(false), m_sending(false)
 {}
 
 //-----------------------------------------------------------------------------
@@ -19,18 +22,39 @@ bool Core::start()
 
     // Передать указатель на класс сбора статистики в класс протокола.
     m_proto.setPointerToStatistic(&m_devStat);
+    // Передать указатель на класс выполнения последовательностей в класс протокола.
+    m_proto.setPointerToSequencer(&m_seq);
+
+    // Запустить поток отправки пакетов со статистикой.
+    if (!m_startSender())
+        return false;
 
-    // Ожидать оповещения о готовых пакетах. Блокирующая функция (поток не вернется до завершения программы).
-    m_waitForPkg();
+    // Ожидать сигнала завершения. Блокирующая функция.
+    m_waitForSignal();
+    // Остановить сбор и отправку статистики.
+    m_stop();
 
-    // Функция никогда не достигнет этого места !
     return true;
 }
 
 //-----------------------------------------------------------------------------
 
+void Core::blockSignals()
+{
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+
+    // Маска наследуется всеми потоками, созданными после этого вызова.
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+}
+
+//-----------------------------------------------------------------------------
+
 bool Core::m_startThread()
 {
+    m_receiving = true;
     m_recvThread = std::thread(m_recvCmd, this);
     if (!m_recvThread.joinable())
     {
@@ -48,32 +72,102 @@ bool Core::m_startThread()
 
 void Core::m_recvCmd(Core * core)
 {    
-    while (true)
+    while (core->m_receiving.load())
     {
-        // Если Keep-Alive вернулся по таймауту, то приостановить сбор статистики.
-        if (!core->m_proto.waitForCommand())
+        // Если Keep-Alive вернулся по таймауту, то приостановить сбор
+        // статистики. Во время записи статистика собирается и без клиента.
+        if (!core->m_proto.waitForCommand() && !core->m_devStat.isRecording())
             core->m_devStat.stopStatistic();
     }
 }
 
 //-----------------------------------------------------------------------------
 
-void Core::m_waitForPkg()
+bool Core::m_startSender()
+{
+    m_sending = true;
+    m_sendThread = std::thread(m_sendPkgs, this);
+    if (!m_sendThread.joinable())
+    {
+        LOGGER_ERROR("Can't start sending statistic in thread");
+        return false;
+    }
+
+    LOGGER_INFO("Sending statistic started in thread");
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Core::m_stopSender()
 {
-    std::unique_lock<std::mutex> lk(m_pkgCVMutex);
-    while (true)
+    m_sending = false;
+    // Прервать ожидание пакетов потоком отправки.
+    m_devStat.wakeStatistic();
+
+    if (m_sendThread.joinable())
+        m_sendThread.join();
+}
+
+//-----------------------------------------------------------------------------
+
+void Core::m_sendPkgs(Core * core)
+{
+    ring::pkg_t * pkgs[s_sendBatch];
+    size_t count;
+
+    while (core->m_sending.load())
     {
-        m_pkgCV.wait(lk, [this]
+        // Ожидать оповещения от потока сбора статистики (оповещения
+        // накапливаются в eventfd, поэтому не теряются).
+        if (!core->m_devStat.waitStatistic())
+            continue;
+
+        // Отправить все готовые пакеты со статистикой пачками.
+        while ((count = core->m_devStat.readStatistic(pkgs, s_sendBatch)) != 0)
         {
-            while (this->m_devStat.readStatistic(this->m_pkg))
-            {
-                // Отправить пакет со статистикой.
-                this->m_proto.sendStatistic(this->m_pkg);
-            }
-            return false;
-        });
-        lk.unlock(); // needs ?
+            core->m_proto.sendStatistic(pkgs, count);
+            core->m_devStat.releaseStatistic(pkgs, count);
+        }
     }
+
+    core->log.trace(__FILE__, EP7TRACE_LEVEL_INFO, (tUINT16)__LINE__,
+                    __FUNCTION__, "Sending statistic thread stopped");
+}
+
+//-----------------------------------------------------------------------------
+
+void Core::m_waitForSignal()
+{
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+
+    int signal = 0;
+    while (sigwait(&signals, &signal) != 0)
+    {}
+
+    std::stringstream msg;
+    msg << "Signal " << signal << " received, stopping";
+    LOGGER_INFO(msg.str());
+}
+
+//-----------------------------------------------------------------------------
+
+void Core::m_stop()
+{
+    // Прервать ожидание команды и остановить поток приема команд (новые
+    // устройства больше не добавляются).
+    m_receiving = false;
+    m_proto.stop();
+    if (m_recvThread.joinable())
+        m_recvThread.join();
+
+    // Остановить сбор статистики (новых пакетов больше не будет).
+    m_devStat.stopStatistic();
+    // Отправить оставшиеся пакеты и остановить поток отправки.
+    m_stopSender();
 }
 
 //=============================================================================
@@ -4,10 +4,12 @@
 //-----------------------------------------------------------------------------
 
 #include <iostream>
-#include <condition_variable>
 #include <sstream>
+#include <atomic>
+#include <thread>
 
 #include "statistic.h"
+#include "sequence.h"
 #include "protocol.h"
 #include "logger-library/logger.h"
 
@@ -27,25 +29,22 @@ public:
 
     //-------------------------------------------------------------------------
 
-    // Запустить взаимодействие с ТПО.
+    // Запустить взаимодействие с ТПО (блокирующая функция, возвращается после
+    // получения сигнала завершения).
     bool start();
+    // Заблокировать сигналы завершения для всех потоков (вызывается до создания
+    // Core, сигналы принимает только start).
+    static void blockSignals();
 
 private:
 
     // Класс логирования.
     logger::Logger log;
 
-    // Для оповещения о новом пакете.
-    std::condition_variable m_pkgCV;
-    // Для блокировки в условной переменной.
-    std::mutex m_pkgCVMutex;
-    // Для сохранения нового пакета на отправку.
-    std::stringstream m_pkg;
-
-    //-------------------------------------------------------------------------
-
     // Для чтения статистики от устройств.
     statistic::Statistic m_devStat;
+    // Для выполнения последовательностей команд в потоке реального времени.
+    sequence::Sequencer m_seq;
     // Для взаимодействия с протоколом ТПО.
     tpoprotocol::TpoProtocol m_proto;
 
@@ -53,6 +52,8 @@ private:
 
     // Поток для получения данных от ТПО.
     std::thread m_recvThread;
+    // Флаг работы потока получения данных от ТПО.
+    std::atomic<bool> m_receiving;
     // Функция запуска потока получения данных от ТПО.
     bool m_startThread();
     // Функция потока для получения данных от ТПО.
@@ -60,8 +61,25 @@ private:
 
     //-------------------------------------------------------------------------
 
-    // Функция ожидания нового пакета.
-    void m_waitForPkg();
+    // Максимальное количество пакетов, отправляемых за один раз.
+    static const size_t s_sendBatch = 16;
+    // Поток отправки пакетов со статистикой.
+    std::thread m_sendThread;
+    // Флаг работы потока отправки.
+    std::atomic<bool> m_sending;
+    // Функция запуска потока отправки.
+    bool m_startSender();
+    // Функция остановки потока отправки.
+    void m_stopSender();
+    // Функция потока отправки пакетов со статистикой.
+    static void m_sendPkgs(Core * core);
+
+    //-------------------------------------------------------------------------
+
+    // Ожидать сигнала завершения.
+    void m_waitForSignal();
+    // Остановить сбор и отправку статистики.
+    void m_stop();
 };
 
 
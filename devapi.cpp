@@ -1,9 +1,11 @@
 #include <errno.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "devapi.h"
+#include "timers.h"
 #include "common.h"
 
 //-----------------------------------------------------------------------------
@@ -32,6 +34,18 @@ DevApi::~DevApi()
 //-----------------------------------------------------------------------------
 
 bool DevApi::read(std::stringstream & data)
+{
+    std::string value;
+    if (!read(value))
+        return false;
+
+    data << value;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool DevApi::read(std::string & value)
 {
     // Проверка файла.
     if (!m_check(true))
@@ -51,9 +65,8 @@ bool DevApi::read(std::stringstream & data)
         return false;
     }
 
-    // Сохранить данные в пакет (без символа переноса).
-    for (size_t i = 0; i < readBytes - 1; i++)
-        data << m_buffer[i];
+    // Сохранить данные (без символа переноса).
+    value.assign(m_buffer, readBytes - 1);
 
     return true;
 }
@@ -150,9 +163,16 @@ bool DevApi::m_check(bool read)
 //=============================================================================
 //=============================================================================
 
-DevsApi::DevsApi(file_t & fileName)
+DevsApi::DevsApi(file_t & fileName, unsigned int id)
 {
-    m_add(fileName);
+    m_add(fileName, id);
+}
+
+//-----------------------------------------------------------------------------
+
+DevsApi::DevsApi(apiEntry_t * entry)
+{
+    insert(entry);
 }
 
 //-----------------------------------------------------------------------------
@@ -164,23 +184,61 @@ DevsApi::~DevsApi()
 
 //-----------------------------------------------------------------------------
 
-bool DevsApi::read(std::stringstream & pkg)
+bool DevsApi::read(buffer::Buffer & pkg)
 {
-    std::stringstream tmpData;
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        (*it)->numeric = false;
+        if (!(*it)->api->read(m_value))
+            continue;
+
+        m_setNumber(*it, m_value);
+        m_checkTriggers(*it, m_value);
+
+        if (pkg.size())
+            pkg.append(sep::dataSep);
+
+        pkg.append((*it)->file.second);
+        pkg.append(sep::dataSep);
+        pkg.append(m_value);
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
 
+bool DevsApi::merge()
+{
     for (auto it = m_apis.begin(); it != m_apis.end(); it++)
     {
-        if (!(*it)->second->read(tmpData))
+        (*it)->numeric = false;
+        if (!(*it)->api->read(m_value))
             continue;
 
-        if (pkg.str().size())
-            pkg << sep::dataSep;
+        m_setNumber(*it, m_value);
+        m_checkTriggers(*it, m_value);
 
-        pkg << (*it)->first.second << sep::dataSep;
-        pkg << tmpData.str();
+        // Для файлов API сохраняется только последнее значение.
+        (*it)->merged = m_value;
+        (*it)->mergedCnt++;
+    }
 
-        // Очистить пакет.
-        tmpData.str(std::string());
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool DevsApi::sample()
+{
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        (*it)->numeric = false;
+        if (!(*it)->api->read(m_value))
+            continue;
+
+        m_setNumber(*it, m_value);
+        m_checkTriggers(*it, m_value);
     }
 
     return true;
@@ -188,12 +246,12 @@ bool DevsApi::read(std::stringstream & pkg)
 
 //-----------------------------------------------------------------------------
 
-bool DevsApi::add(file_t & fileName)
+bool DevsApi::add(file_t & fileName, unsigned int id)
 {
     if (m_isExist(fileName))
         return false;
 
-    m_add(fileName);
+    m_add(fileName, id);
     return true;
 }
 
@@ -203,7 +261,7 @@ bool DevsApi::remove(file_t & fileName)
 {
     for (auto it = m_apis.begin(); it != m_apis.end(); it++)
     {
-        if (fileName == (*it)->first)
+        if (fileName == (*it)->file)
         {
             m_deleteFile(*it);
             m_apis.erase(it);
@@ -231,13 +289,45 @@ files_t DevsApi::getActive()
     files_t data;
 
     for (auto it = m_apis.begin(); it != m_apis.end(); it++)
-        data.push_back((*it)->first);
+        data.push_back((*it)->file);
 
     return data;
 }
 
 //-----------------------------------------------------------------------------
 
+const DevsApi::apis_t & DevsApi::getEntries()
+{
+    return m_apis;
+}
+
+//-----------------------------------------------------------------------------
+
+DevsApi::apiEntry_t * DevsApi::extract(file_t & fileName)
+{
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        if (fileName == (*it)->file)
+        {
+            // Файл остается открытым у извлеченного файла API.
+            auto entry = *it;
+            m_apis.erase(it);
+            return entry;
+        }
+    }
+
+    return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+
+void DevsApi::insert(apiEntry_t * entry)
+{
+    m_apis.push_back(entry);
+}
+
+//-----------------------------------------------------------------------------
+
 bool DevsApi::isExist(file_t & fileName)
 {
     return m_isExist(fileName);
@@ -252,11 +342,61 @@ bool DevsApi::isActive()
 
 //-----------------------------------------------------------------------------
 
+bool DevsApi::addTrigger(file_t & fileName, const trig::Trigger & trigger)
+{
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        if (fileName == (*it)->file)
+        {
+            (*it)->triggers.push_back(trigger);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool DevsApi::removeTrigger(unsigned int id)
+{
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        auto & triggers = (*it)->triggers;
+        for (auto trig = triggers.begin(); trig != triggers.end(); trig++)
+        {
+            if (trig->getId() == id)
+            {
+                triggers.erase(trig);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+const trig::events_t & DevsApi::getEvents()
+{
+    return m_events;
+}
+
+//-----------------------------------------------------------------------------
+
+void DevsApi::clearEvents()
+{
+    m_events.resize(0);
+}
+
+//-----------------------------------------------------------------------------
+
 bool DevsApi::m_isExist(file_t & fileName)
 {
     for (auto it = m_apis.begin(); it != m_apis.end(); it++)
     {
-        if (fileName == (*it)->first)
+        if (fileName == (*it)->file)
             return true;
     }
 
@@ -265,20 +405,59 @@ bool DevsApi::m_isExist(file_t & fileName)
 
 //-----------------------------------------------------------------------------
 
-void DevsApi::m_add(file_t & fileName)
+void DevsApi::m_setNumber(apiEntry_t * entry, const std::string & value)
+{
+    char * end;
+    entry->number = strtod(value.c_str(), &end);
+    entry->numeric = end != value.c_str() && *end == '\0';
+}
+
+//-----------------------------------------------------------------------------
+
+void DevsApi::m_checkTriggers(apiEntry_t * entry, const std::string & value)
+{
+    // Триггеры проверяются только для числовых значений.
+    if (!entry->triggers.size() || !entry->numeric)
+        return;
+
+    for (auto it = entry->triggers.begin(); it != entry->triggers.end(); it++)
+    {
+        bool rise;
+        if (!it->check(entry->number, rise))
+            continue;
+
+        if (m_events.size() == s_maxEvents)
+        {
+            LOGGER_WARNING("Too many events, trigger event dropped");
+            continue;
+        }
+
+        m_events.push_back({it->getId(), entry->file.second, value, rise,
+                            timers::now()});
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void DevsApi::m_add(file_t & fileName, unsigned int id)
 {
-    api_t * api = new api_t;
-    api->first = fileName;
-    api->second = new DevApi(fileName.first);
+    apiEntry_t * api = new apiEntry_t;
+    api->file = fileName;
+    api->api = new DevApi(fileName.first);
+    api->id = id;
+    api->mergedCnt = 0;
+    api->number = 0;
+    api->numeric = false;
 
     m_apis.push_back(api);
 }
 
 //-----------------------------------------------------------------------------
 
-void DevsApi::m_deleteFile(api_t * api)
+void DevsApi::m_deleteFile(apiEntry_t * api)
 {
-    delete api->second;
+    delete api->api;
+    delete api;
 }
 
 //-----------------------------------------------------------------------------
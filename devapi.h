@@ -8,6 +8,8 @@
 #include <vector>
 #include <cstdio>
 
+#include "buffer.h"
+#include "trigger.h"
 #include "logger-library/logger.h"
 
 //-----------------------------------------------------------------------------
@@ -35,6 +37,8 @@ public:
 
     // Прочитать файл.
     bool read(std::stringstream & data);
+    // Прочитать файл в строку (память строки используется повторно).
+    bool read(std::string & value);
     // Записать значение.
     bool write(std::string & apiVal);
 
@@ -76,24 +80,61 @@ class DevsApi
 {
 public:
 
-    DevsApi(file_t & fileName);
+    // Файл API в пуле чтения (перемещается между пулами целиком вместе с
+    // открытым файлом и состоянием).
+    struct apiEntry_t
+    {
+        file_t file;        // Путь к файлу и его alias.
+        DevApi * api;       // Указатель на класс файла устройства.
+        unsigned int id;    // Идентификатор подписки.
+
+        // Последнее значение, накопленное при переполнении очереди пакетов.
+        std::string merged;
+        // Количество накопленных считываний.
+        unsigned int mergedCnt;
+
+        // Триггеры на числовое значение файла.
+        std::vector<trig::Trigger> triggers;
+        // Числовое значение последнего чтения (numeric - файл прочитан и его
+        // значение является числом).
+        double number;
+        bool numeric;
+    };
+
+    // Вектор указателей на файлы устройств.
+    typedef std::vector<apiEntry_t *> apis_t;
+
+    //-------------------------------------------------------------------------
+
+    DevsApi(file_t & fileName, unsigned int id);
+    DevsApi(apiEntry_t * entry);
     ~DevsApi();
 
     //-------------------------------------------------------------------------
 
     // Прочитать файлы устройства.
-    bool read(std::stringstream & pkg);
+    bool read(buffer::Buffer & pkg);
+    // Прочитать файлы устройства и накопить значения вместо передачи.
+    bool merge();
+    // Прочитать файлы устройства без передачи данных (проверяются триггеры).
+    bool sample();
 
     //-------------------------------------------------------------------------
 
     // Добавить файл к пулу чтения.
-    bool add(file_t & fileName);
+    bool add(file_t & fileName, unsigned int id);
     // Удалить файлы API из пула чтения.
     bool remove(file_t & fileName);
     // Удалить все файлы API из пула чтения.
     void removeAll();
     // Получить список активных файлов.
     files_t getActive();
+    // Вернуть файлы API пула.
+    const apis_t & getEntries();
+    // Извлечь файл API из пула без освобождения памяти (nullptr - нет файла).
+    apiEntry_t * extract(file_t & fileName);
+    // Добавить ранее извлеченный файл API в пул.
+    void insert(apiEntry_t * entry);
 
     //-------------------------------------------------------------------------
 
@@ -102,35 +143,49 @@ public:
     // Проверить есть ли активные файлы для чтения.
     bool isActive();
 
+    //-------------------------------------------------------------------------
+
+    // Добавить триггер на значение файла пула (false - файл не читается).
+    bool addTrigger(file_t & fileName, const trig::Trigger & trigger);
+    // Удалить триггер по идентификатору.
+    bool removeTrigger(unsigned int id);
+    // Вернуть события, накопленные с последней очистки.
+    const trig::events_t & getEvents();
+    // Очистить события после передачи.
+    void clearEvents();
+
 private:
 
     // Класс логирования.
     logger::Logger log;
 
-    // Путь к файлу и указатель на класс файла устройства.
-    typedef std::pair<file_t, DevApi *> api_t;
-    // Вектор указателей на файлы устройств.
-    typedef std::vector<api_t *> apis_t;
-
-    //-------------------------------------------------------------------------
-
     // Вектор файлов.
     apis_t m_apis;
+    // Значение прочитанного файла (используется повторно).
+    std::string m_value;
+    // События сработавших триггеров.
+    trig::events_t m_events;
+    // Максимальное количество непереданных событий.
+    static const size_t s_maxEvents = 64;
 
     //-------------------------------------------------------------------------
 
     // Проверить существует ли файл.
     bool m_isExist(file_t & fileName);
+    // Сохранить числовое значение прочитанного файла.
+    void m_setNumber(apiEntry_t * entry, const std::string & value);
+    // Проверить триггеры файла на прочитанном значении.
+    void m_checkTriggers(apiEntry_t * entry, const std::string & value);
 
     //-------------------------------------------------------------------------
 
     // Добавить файл в пул чтения.
-    void m_add(file_t & fileName);
+    void m_add(file_t & fileName, unsigned int id);
 
     //-------------------------------------------------------------------------
 
     // Удалить память, выделенную под класс DevApi.
-    void m_deleteFile(api_t * api);
+    void m_deleteFile(apiEntry_t * api);
     // Отчистить вектор файлов чтения и удалть выделенную память.
     void m_deleteFiles();
 };
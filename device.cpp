@@ -3,7 +3,12 @@
 #include <string.h>
 
 #include "device.h"
+#include "timers.h"
 #include <atomic>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <math.h>
 
 //-----------------------------------------------------------------------------
 
@@ -12,11 +17,18 @@ namespace dev
 
 //=============================================================================
 
+std::mutex Device::s_pageMutexes[Device::s_pageStripes];
+
+//-----------------------------------------------------------------------------
+
 Device::Device(devInfo_t & dev)
     : m_fd(-1), m_dev(dev), m_mapBase(nullptr), m_mappedFlag(false)
 {
     // Получить смещение на странице памяти.
     m_offset = (unsigned int)(m_dev.first & (m_pagesize - 1));
+    // Отобразить все страницы, которые занимает регион.
+    auto regionEnd = m_offset + size_t(m_dev.second) * m_step;
+    m_mapSize = ((regionEnd + m_pagesize - 1) / m_pagesize) * m_pagesize;
 
     //-------------------------------------------------------------------------
 
@@ -31,9 +43,9 @@ Device::Device(devInfo_t & dev)
 Device::~Device()
 {
     // Прекратить отображение региона.
-    if (m_mapBase != MAP_FAILED)
+    if (m_mappedFlag)
     {
-        if (munmap(m_mapBase, m_pagesize) != 0)
+        if (munmap(m_mapBase, m_mapSize) != 0)
             LOGGER_ERROR("Cannot unmap device registers");
     }
 
@@ -73,7 +85,7 @@ bool Device::read(region_t & region)
 
 bool Device::write(uint32_t & value)
 {
-    void * virt_addr;
+    volatile uint32_t * reg;
 
     // Проверить отображено ли устройство.
     if (!m_mappedFlag)
@@ -82,12 +94,78 @@ bool Device::write(uint32_t & value)
         return false;
     }
 
+    // Не допустить записи посреди чтения-изменения-записи другого клиента.
+    auto locks = m_lockPages();
+
     auto tmpOffset = m_offset;
     // Записать значение по адресам.
     for (unsigned int i = 0; i < m_dev.second; i++)
     {
-        virt_addr = m_mapBase + tmpOffset;
-        *((uint32_t *) virt_addr) = value;
+        reg = (volatile uint32_t *) ((uint8_t *) m_mapBase + tmpOffset);
+        *reg = value;
+        tmpOffset += m_step;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Device::write(std::vector<uint32_t> & values)
+{
+    volatile uint32_t * reg;
+
+    // Проверить отображено ли устройство.
+    if (!m_mappedFlag)
+    {
+        LOGGER_ERROR("Device isn't remapped");
+        return false;
+    }
+
+    // Массив не должен выходить за пределы отображенного региона.
+    if (values.size() > m_dev.second)
+    {
+        LOGGER_ERROR("Too many values for device region");
+        return false;
+    }
+
+    // Не допустить записи посреди чтения-изменения-записи другого клиента.
+    auto locks = m_lockPages();
+
+    auto tmpOffset = m_offset;
+    // Записать значения в последовательные регистры.
+    for (unsigned int i = 0; i < values.size(); i++)
+    {
+        reg = (volatile uint32_t *) ((uint8_t *) m_mapBase + tmpOffset);
+        *reg = values[i];
+        tmpOffset += m_step;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Device::modify(uint32_t & value, uint32_t & mask)
+{
+    volatile uint32_t * reg;
+
+    // Проверить отображено ли устройство.
+    if (!m_mappedFlag)
+    {
+        LOGGER_ERROR("Device isn't remapped");
+        return false;
+    }
+
+    // Чтение и запись выполняются под блокировкой страниц региона.
+    auto locks = m_lockPages();
+
+    auto tmpOffset = m_offset;
+    // Изменить только биты, указанные в маске.
+    for (unsigned int i = 0; i < m_dev.second; i++)
+    {
+        reg = (volatile uint32_t *) ((uint8_t *) m_mapBase + tmpOffset);
+        *reg = (*reg & ~mask) | (value & mask);
         tmpOffset += m_step;
     }
 
@@ -96,6 +174,58 @@ bool Device::write(uint32_t & value)
 
 //-----------------------------------------------------------------------------
 
+bool Device::burst(unsigned int count, std::vector<uint64_t> & stamps,
+                   std::vector<uint32_t> & data)
+{
+    // Проверить отображено ли устройство.
+    if (!m_mappedFlag)
+    {
+        LOGGER_ERROR("Device isn't remapped");
+        return false;
+    }
+
+    // Память выделяется до начала считываний, чтобы между ними не было
+    // ничего, кроме чтения регистров и метки времени.
+    stamps.resize(count);
+    data.resize(size_t(count) * m_dev.second);
+
+    auto regs = (volatile uint32_t *) ((uint8_t *) m_mapBase + m_offset);
+    auto value = data.data();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        stamps[i] = timers::now();
+        for (unsigned int reg = 0; reg < m_dev.second; reg++)
+            *value++ = regs[reg];
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+Device::pageLocks_t Device::m_lockPages()
+{
+    pageLocks_t locks;
+    std::vector<size_t> stripes;
+    size_t firstPage = (m_dev.first & ~(m_pagesize - 1)) / m_pagesize;
+
+    // Номера мьютексов страниц региона (разные страницы могут попасть на
+    // один мьютекс, он блокируется один раз).
+    for (size_t i = 0; i < m_mapSize / m_pagesize; i++)
+        stripes.push_back((firstPage + i) % s_pageStripes);
+    std::sort(stripes.begin(), stripes.end());
+    stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+
+    // Мьютексы блокируются по возрастанию номера, чтобы избежать взаимной
+    // блокировки.
+    for (auto it = stripes.begin(); it != stripes.end(); it++)
+        locks.emplace_back(s_pageMutexes[*it]);
+
+    return locks;
+}
+
+//-----------------------------------------------------------------------------
+
 bool Device::m_mapRegion()
 {
     if (!m_dev.second)
@@ -119,14 +249,14 @@ bool Device::m_mapRegion()
 
 void Device::m_readRegion(region_t & region)
 {
-    void * virt_addr;
+    volatile uint32_t * reg;
 
     auto tmpOffset = m_offset;
     // Прочитать значения регистров в устройстве.
     for (unsigned int i = 0; i < m_dev.second; i++)
     {
-        virt_addr = m_mapBase + tmpOffset;
-        region[i].second = *((uint32_t *) virt_addr);
+        reg = (volatile uint32_t *) ((uint8_t *) m_mapBase + tmpOffset);
+        region[i].second = *reg;
         tmpOffset += m_step;
     }
 }
@@ -152,7 +282,7 @@ bool Device::m_openChrdev()
 
 bool Device::m_mmap()
 {
-    m_mapBase = mmap(0, m_pagesize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd,
+    m_mapBase = mmap(0, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd,
                     m_dev.first & ~((typeof(m_dev.first))m_pagesize - 1));
 
     if (m_mapBase == MAP_FAILED)
@@ -170,10 +300,23 @@ bool Device::m_mmap()
 //=============================================================================
 //=============================================================================
 
-Devices::Devices(devInfo_t & dev)
+Devices::Devices(devInfo_t & dev, unsigned int id, const subOpts_t & opts,
+                 Device * mapped)
+    : m_eventText(s_hexSize), m_stamp(0)
 {
+    m_events.reserve(s_maxEvents);
     // Создать устройство.
-    m_createDev(dev);
+    m_createDev(dev, id, opts, mapped);
+}
+
+//-----------------------------------------------------------------------------
+
+Devices::Devices(devEntry_t * entry)
+    : m_eventText(s_hexSize), m_stamp(0)
+{
+    m_events.reserve(s_maxEvents);
+    // Добавить ранее извлеченное устройство.
+    insert(entry);
 }
 
 //-----------------------------------------------------------------------------
@@ -191,10 +334,23 @@ Devices::~Devices()
 bool Devices::read(devsRegion_t ** regions)
 {
     // Прочитать регионы устройств.
+    m_stamp = 0;
     auto ret = m_readRegions();
     if (!ret)
         return ret;
 
+    // Пропустить значения через фильтры.
+    m_filter();
+    // Проверить триггеры на отфильтрованных значениях.
+    m_checkTriggers();
+    // Добавить значения в захваты (в том числе начатые триггерами).
+    m_capture();
+    // Сохранить значения в истории.
+    m_history();
+    // Накопить значения устройств с агрегацией.
+    m_accumulate(true);
+    // Добавить значения в гистограммы.
+    m_countHgrams();
     // Получить регионы устройств.
     m_getRegions();
 
@@ -205,6 +361,71 @@ bool Devices::read(devsRegion_t ** regions)
 
 //-----------------------------------------------------------------------------
 
+bool Devices::merge()
+{
+    if (!sample())
+        return false;
+
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        // Данные устройств с агрегацией передаются только агрегатами, а
+        // устройств без передачи данных - только событиями триггеров.
+        if ((*it)->opts.aggWindow || (*it)->opts.hgramWindow ||
+            (*it)->opts.quiet || !(*it)->sampleReady)
+        {
+            continue;
+        }
+
+        auto & region = *(*it)->region;
+        auto & merged = (*it)->merged;
+
+        // Первое накопленное значение.
+        if (!(*it)->mergedCnt)
+        {
+            merged.resize(region.size());
+            for (unsigned int i = 0; i < region.size(); i++)
+                merged[i] = {region[i].second, region[i].second, region[i].second};
+        }
+        else
+        {
+            for (unsigned int i = 0; i < region.size(); i++)
+            {
+                auto value = region[i].second;
+                merged[i].min = std::min(merged[i].min, value);
+                merged[i].max = std::max(merged[i].max, value);
+                merged[i].last = value;
+            }
+        }
+
+        (*it)->mergedCnt++;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Devices::sample()
+{
+    // Прочитать регионы устройств.
+    m_stamp = 0;
+    if (!m_readRegions())
+        return false;
+
+    m_filter();
+    m_checkTriggers();
+    m_capture();
+    m_history();
+    // Окно агрегации и период гистограмм продлеваются до освобождения
+    // очереди.
+    m_accumulate(false);
+    m_countHgrams();
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
 bool Devices::m_isExist(uint32_t & addr)
 {
     for (unsigned int i = 0; i < m_devs.size(); i++)
@@ -218,7 +439,8 @@ bool Devices::m_isExist(uint32_t & addr)
 
 //-----------------------------------------------------------------------------
 
-bool Devices::add(devInfo_t & devInfo)
+bool Devices::add(devInfo_t & devInfo, unsigned int id,
+                  const subOpts_t & opts, Device * mapped)
 {
     // Проверить есть ли такое устройство в пуле.
     if (m_isExist(devInfo.first))
@@ -229,7 +451,7 @@ bool Devices::add(devInfo_t & devInfo)
     LOGGER_DEBUG("Device ins't exist");
 
     // Создать и добавить устройство к общему пулу.
-    m_createDev(devInfo);
+    m_createDev(devInfo, id, opts, mapped);
     return true;
 }
 
@@ -241,8 +463,10 @@ bool Devices::remove(uint32_t & addr)
     {
         if (addr == (*it)->devInfo.first)
         {
+            m_resetAggReady();
             m_deleteDev(*it);
             m_devs.erase(it);
+            m_layoutAggs();
             return true;
         }
     }
@@ -252,12 +476,74 @@ bool Devices::remove(uint32_t & addr)
 
 //-----------------------------------------------------------------------------
 
+Device * Devices::release(uint32_t & addr)
+{
+    for (auto it = std::begin(m_devs); it != std::end(m_devs); it++)
+    {
+        if (addr == (*it)->devInfo.first)
+        {
+            // Отображение не удаляется вместе с устройством.
+            auto mapped = (*it)->dev;
+            (*it)->dev = nullptr;
+            m_resetAggReady();
+            m_deleteDev(*it);
+            m_devs.erase(it);
+            m_layoutAggs();
+            return mapped;
+        }
+    }
+
+    return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+
 void Devices::removeAll()
 {
+    m_resetAggReady();
     for (auto it = std::begin(m_devs); it != std::end(m_devs); it++)
         m_deleteDev(*it);
 
     m_devs.resize(0);
+    m_layoutAggs();
+}
+
+//-----------------------------------------------------------------------------
+
+Devices::devEntry_t * Devices::extract(uint32_t & addr)
+{
+    for (auto it = std::begin(m_devs); it != std::end(m_devs); it++)
+    {
+        if (addr == (*it)->devInfo.first)
+        {
+            // Отображение и регион остаются у извлеченного устройства.
+            auto entry = *it;
+            m_resetAggReady();
+            // Незавершенное окно агрегации продолжается в новом пуле.
+            if (entry->aggCnt)
+            {
+                auto src = m_aggs.begin() + entry->aggOffset;
+                entry->aggCarry.assign(src, src + entry->devInfo.second);
+            }
+            m_devs.erase(it);
+            m_layoutAggs();
+            return entry;
+        }
+    }
+
+    return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::insert(devEntry_t * entry)
+{
+    // Размер истории в секундах зависит от частоты считывания.
+    m_initHistory(entry);
+    m_resetAggReady();
+    m_devs.push_back(entry);
+    m_regions.reserve(m_devs.size());
+    m_layoutAggs();
 }
 
 //-----------------------------------------------------------------------------
@@ -280,6 +566,27 @@ devsInfo_t Devices::getActive()
 
 //-----------------------------------------------------------------------------
 
+const Devices::devs_t & Devices::getEntries()
+{
+    return m_devs;
+}
+
+//-----------------------------------------------------------------------------
+
+const Devices::devs_t & Devices::getAggReady()
+{
+    return m_aggReady;
+}
+
+//-----------------------------------------------------------------------------
+
+const Devices::aggregate_t * Devices::getAggregates(devEntry_t * entry)
+{
+    return &m_aggs[entry->aggOffset];
+}
+
+//-----------------------------------------------------------------------------
+
 bool Devices::isExist(uint32_t & addr)
 {
     return m_isExist(addr);
@@ -287,6 +594,89 @@ bool Devices::isExist(uint32_t & addr)
 
 //-----------------------------------------------------------------------------
 
+bool Devices::addTrigger(uint32_t & addr, const trig::Trigger & trigger)
+{
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        auto base = (*it)->devInfo.first;
+        auto regs = (*it)->devInfo.second;
+        if (addr < base || addr >= base + regs * sizeof(uint32_t) ||
+            (addr - base) % sizeof(uint32_t))
+        {
+            continue;
+        }
+
+        unsigned int reg = (addr - base) / sizeof(uint32_t);
+        (*it)->triggers.push_back({reg, trigger});
+        return true;
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Devices::removeTrigger(unsigned int id)
+{
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        auto & triggers = (*it)->triggers;
+        for (auto trig = triggers.begin(); trig != triggers.end(); trig++)
+        {
+            if (trig->second.getId() == id)
+            {
+                triggers.erase(trig);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+const trig::events_t & Devices::getEvents()
+{
+    return m_events;
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::clearEvents()
+{
+    m_events.resize(0);
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::releaseCapture(devEntry_t * entry)
+{
+    auto & cap = entry->capture;
+    cap.state = capState_t::IDLE;
+    cap.count = 0;
+    cap.trigger = 0;
+    cap.id = 0;
+    cap.sent = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Devices::isHgramReady(devEntry_t * entry)
+{
+    return entry->opts.hgramWindow && entry->hgramCnt >= entry->opts.hgramWindow;
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::releaseHgram(devEntry_t * entry)
+{
+    std::fill(entry->hgramCounts.begin(), entry->hgramCounts.end(), 0);
+    entry->hgramCnt = 0;
+}
+
+//-----------------------------------------------------------------------------
+
 bool Devices::isActive()
 {
     return bool(m_devs.size());
@@ -294,10 +684,16 @@ bool Devices::isActive()
 
 //-----------------------------------------------------------------------------
 
-void Devices::m_createDev(devInfo_t & devInfo)
+void Devices::m_createDev(devInfo_t & devInfo, unsigned int id,
+                          const subOpts_t & opts, Device * mapped)
 {
-    m_dev_t * devData = new m_dev_t;
-    devData->dev = new Device(devInfo);
+    devEntry_t * devData = new devEntry_t;
+    devData->id = id;
+    devData->mergedCnt = 0;
+    devData->opts = opts;
+    devData->aggCnt = 0;
+    devData->aggOffset = 0;
+    devData->dev = mapped ? mapped : new Device(devInfo);
     devData->region = new region_t;
     // Задать размер региона для сохранения прочитанных данных.
     devData->region->resize(devInfo.second);
@@ -305,12 +701,538 @@ void Devices::m_createDev(devInfo_t & devInfo)
     // Заполнить регион начальными базовыми адресами.
     region_t * reg = devData->region;
     devData->dev->fillAddrs(*reg);
+    m_initFilters(devData);
+    m_initCapture(devData);
+    devData->history = {{}, 0, 0, 0};
+    m_initHistory(devData);
+    m_initHgram(devData);
+    m_resetAggReady();
     m_devs.push_back(devData);
+    // Указатели на регионы всех устройств помещаются без выделения памяти
+    // при считывании.
+    m_regions.reserve(m_devs.size());
+    m_layoutAggs();
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::m_layoutAggs()
+{
+    aggregates_t aggs;
+
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        if (!(*it)->opts.aggWindow)
+            continue;
+
+        auto offset = aggs.size();
+        auto regs = (*it)->devInfo.second;
+        // Перенести накопленные значения устройства на новое место (для
+        // устройства из другого пула - из перенесенных агрегатов).
+        if ((*it)->aggCnt && (*it)->aggCarry.size())
+        {
+            aggs.insert(aggs.end(), (*it)->aggCarry.begin(),
+                        (*it)->aggCarry.end());
+            (*it)->aggCarry.clear();
+        }
+        else if ((*it)->aggCnt)
+        {
+            auto src = m_aggs.begin() + (*it)->aggOffset;
+            aggs.insert(aggs.end(), src, src + regs);
+        }
+        else
+        {
+            aggs.resize(offset + regs);
+        }
+
+        (*it)->aggOffset = offset;
+    }
+
+    m_aggs.swap(aggs);
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::m_resetAggReady()
+{
+    for (auto it = m_aggReady.begin(); it != m_aggReady.end(); it++)
+        (*it)->aggCnt = 0;
+    m_aggReady.resize(0);
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::m_accumulate(bool ready)
+{
+    // Окна, завершенные при прошлом считывании, уже переданы.
+    m_resetAggReady();
+
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        auto entry = *it;
+        // Фильтры с прореживанием выдают значения не при каждом считывании.
+        if (!entry->opts.aggWindow || !entry->sampleReady)
+            continue;
+
+        auto & region = *entry->region;
+        auto aggs = &m_aggs[entry->aggOffset];
+        auto n = ++entry->aggCnt;
+
+        for (unsigned int i = 0; i < region.size(); i++)
+        {
+            auto value = region[i].second;
+            auto & agg = aggs[i];
+
+            // Первое значение окна.
+            if (n == 1)
+            {
+                agg = {value, value, value, double(value), 0};
+                continue;
+            }
+
+            agg.min = std::min(agg.min, value);
+            agg.max = std::max(agg.max, value);
+            agg.last = value;
+
+            auto delta = double(value) - agg.mean;
+            agg.mean += delta / n;
+            agg.m2 += delta * (double(value) - agg.mean);
+        }
+
+        if (ready && entry->aggCnt >= entry->opts.aggWindow)
+            m_aggReady.push_back(entry);
+    }
 }
 
 //-----------------------------------------------------------------------------
 
-void Devices::m_deleteDev(m_dev_t * devInfo)
+void Devices::m_initFilters(devEntry_t * entry)
+{
+    auto stages = entry->opts.filters.size();
+    auto regs = entry->devInfo.second;
+
+    entry->filterState.assign(stages * regs, filterState_t());
+    entry->filterCnt.assign(stages, 0);
+    entry->filterOuts.assign(stages, 0);
+    entry->filterVal.resize(stages ? regs : 0);
+    entry->sampleReady = true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::m_filter()
+{
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        auto entry = *it;
+        if (!entry->opts.filters.size())
+            continue;
+
+        auto & region = *entry->region;
+        auto & val = entry->filterVal;
+        for (unsigned int i = 0; i < region.size(); i++)
+            val[i] = region[i].second;
+
+        // Значение проходит ступени по порядку, пока одна из них не задержит
+        // его до завершения своего окна прореживания.
+        entry->sampleReady = true;
+        for (size_t stage = 0; stage < entry->opts.filters.size(); stage++)
+        {
+            if (!m_filterStage(entry, stage))
+            {
+                entry->sampleReady = false;
+                break;
+            }
+        }
+
+        if (!entry->sampleReady)
+            continue;
+
+        // Отфильтрованные значения передаются вместо прочитанных.
+        for (unsigned int i = 0; i < region.size(); i++)
+        {
+            auto value = llround(val[i]);
+            if (value < 0)
+                value = 0;
+            else if (value > UINT32_MAX)
+                value = UINT32_MAX;
+            region[i].second = uint32_t(value);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool Devices::m_filterStage(devEntry_t * entry, size_t stage)
+{
+    auto & filter = entry->opts.filters[stage];
+    auto & cnt = entry->filterCnt[stage];
+    auto & val = entry->filterVal;
+    auto states = &entry->filterState[stage * val.size()];
+
+    switch (filter.type)
+    {
+    case filter_t::BOX:
+    {
+        for (unsigned int i = 0; i < val.size(); i++)
+            states[i].acc += val[i];
+
+        if (++cnt < filter.n)
+            return false;
+
+        for (unsigned int i = 0; i < val.size(); i++)
+        {
+            val[i] = states[i].acc / filter.n;
+            states[i].acc = 0;
+        }
+        cnt = 0;
+        return true;
+    }
+
+    case filter_t::EMA:
+    {
+        for (unsigned int i = 0; i < val.size(); i++)
+        {
+            auto & y = states[i].acc;
+            // Первое значение задает начальное состояние.
+            y = cnt ? y + filter.alpha * (val[i] - y) : val[i];
+            val[i] = y;
+        }
+        cnt = 1;
+        return true;
+    }
+
+    case filter_t::CIC:
+    {
+        // Интеграторы работают на частоте считывания в целочисленной
+        // арифметике по модулю 2^64 - переполнение компенсируется
+        // гребенчатыми звеньями.
+        for (unsigned int i = 0; i < val.size(); i++)
+        {
+            auto & st = states[i];
+            st.integ[0] += uint64_t(llround(val[i]));
+            for (unsigned int k = 1; k < s_cicOrder; k++)
+                st.integ[k] += st.integ[k - 1];
+        }
+
+        if (++cnt < filter.n)
+            return false;
+
+        // Гребенчатые звенья работают на прореженной частоте, коэффициент
+        // усиления фильтра N^порядок.
+        auto gain = pow(double(filter.n), s_cicOrder);
+        for (unsigned int i = 0; i < val.size(); i++)
+        {
+            auto & st = states[i];
+            auto y = st.integ[s_cicOrder - 1];
+            for (unsigned int k = 0; k < s_cicOrder; k++)
+            {
+                auto prev = st.comb[k];
+                st.comb[k] = y;
+                y -= prev;
+            }
+            val[i] = double(int64_t(y)) / gain;
+        }
+        cnt = 0;
+
+        // Пока гребенчатые звенья не заполнены, на выходе переходный процесс.
+        auto & outs = entry->filterOuts[stage];
+        if (outs < s_cicOrder)
+        {
+            outs++;
+            return false;
+        }
+        return true;
+    }
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::m_checkTriggers()
+{
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        auto entry = *it;
+        // Триггеры проверяются только на значениях, выданных фильтрами.
+        if (!entry->triggers.size() || !entry->sampleReady)
+            continue;
+
+        auto & region = *entry->region;
+        for (auto trig = entry->triggers.begin(); trig != entry->triggers.end(); trig++)
+        {
+            auto & reg = region[trig->first];
+            bool rise;
+            if (!trig->second.check(reg.second, rise))
+                continue;
+
+            // Срабатывание начинает захват, если он ожидает триггер.
+            if (entry->capture.state == capState_t::IDLE &&
+                (entry->opts.capPre || entry->opts.capPost))
+            {
+                entry->capture.trigger = trig->second.getId();
+            }
+
+            if (m_events.size() == s_maxEvents)
+            {
+                LOGGER_WARNING("Too many events, trigger event dropped");
+                continue;
+            }
+
+            // Место под события зарезервировано, а строки адреса и значения
+            // помещаются в строку без выделения памяти.
+            m_events.emplace_back();
+            auto & event = m_events.back();
+            event.id = trig->second.getId();
+            m_eventText.clear();
+            m_eventText.appendHex(reg.first);
+            event.source.assign(m_eventText.data(), m_eventText.size());
+            m_eventText.clear();
+            m_eventText.appendHex(reg.second);
+            event.value.assign(m_eventText.data(), m_eventText.size());
+            event.rise = rise;
+            event.stamp = m_getStamp();
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+uint64_t Devices::getHistoryFirst(devEntry_t * entry)
+{
+    return entry->history.total - entry->history.filled;
+}
+
+//-----------------------------------------------------------------------------
+
+uint64_t Devices::findHistory(devEntry_t * entry, uint64_t stamp)
+{
+    // Метки времени в истории возрастают - двоичный поиск по номерам.
+    auto first = getHistoryFirst(entry);
+    auto last = entry->history.total;
+
+    while (first < last)
+    {
+        auto mid = first + (last - first) / 2;
+        auto record = getHistoryRecord(entry, mid);
+        auto midStamp = uint64_t(record[0]) | (uint64_t(record[1]) << 32);
+        if (midStamp < stamp)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+
+    return first;
+}
+
+//-----------------------------------------------------------------------------
+
+const uint32_t * Devices::getHistoryRecord(devEntry_t * entry, uint64_t seq)
+{
+    auto & hist = entry->history;
+    auto capacity = entry->opts.histSamples;
+    auto words = s_stampWords + entry->devInfo.second;
+    // Индекс записи отсчитывается назад от следующей записи.
+    auto back = hist.total - seq;
+    auto idx = (hist.head + capacity - back) % capacity;
+
+    return hist.records.data() + idx * words;
+}
+
+//-----------------------------------------------------------------------------
+
+uint64_t Devices::m_getStamp()
+{
+    // Время берется один раз на считывание.
+    if (!m_stamp)
+        m_stamp = timers::now();
+
+    return m_stamp;
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::m_initCapture(devEntry_t * entry)
+{
+    auto & cap = entry->capture;
+    auto regs = entry->devInfo.second;
+    auto pre = entry->opts.capPre;
+    // Отсчеты до срабатывания, отсчет срабатывания и отсчеты после него.
+    auto total = (entry->opts.capPre || entry->opts.capPost) ?
+                 pre + 1 + entry->opts.capPost : 0;
+
+    cap.state = capState_t::IDLE;
+    cap.hist.resize(size_t(pre) * regs);
+    cap.histStamps.resize(pre);
+    cap.head = 0;
+    cap.filled = 0;
+    cap.data.resize(size_t(total) * regs);
+    cap.stamps.resize(total);
+    cap.count = 0;
+    cap.pre = 0;
+    cap.postLeft = 0;
+    cap.trigger = 0;
+    cap.id = 0;
+    cap.sent = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::m_capture()
+{
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        auto entry = *it;
+        if (!(entry->opts.capPre || entry->opts.capPost) || !entry->sampleReady)
+            continue;
+
+        auto & cap = entry->capture;
+        auto & region = *entry->region;
+        auto regs = region.size();
+        auto pre = entry->opts.capPre;
+        auto stamp = m_getStamp();
+
+        // Триггер сработал - зафиксировать последние отсчеты в порядке
+        // поступления.
+        if (cap.state == capState_t::IDLE && cap.trigger)
+        {
+            auto first = cap.filled ? (cap.head + pre - cap.filled) % pre : 0;
+            for (size_t i = 0; i < cap.filled; i++)
+            {
+                auto idx = (first + i) % pre;
+                std::copy(cap.hist.begin() + idx * regs,
+                          cap.hist.begin() + (idx + 1) * regs,
+                          cap.data.begin() + i * regs);
+                cap.stamps[i] = cap.histStamps[idx];
+            }
+
+            cap.count = cap.filled;
+            cap.pre = cap.filled;
+            // Отсчет срабатывания и отсчеты после него.
+            cap.postLeft = entry->opts.capPost + 1;
+            cap.state = capState_t::COLLECT;
+        }
+
+        if (cap.state == capState_t::COLLECT)
+        {
+            for (size_t i = 0; i < regs; i++)
+                cap.data[cap.count * regs + i] = region[i].second;
+            cap.stamps[cap.count++] = stamp;
+
+            if (!--cap.postLeft)
+                cap.state = capState_t::READY;
+        }
+
+        // Буфер последних отсчетов заполняется всегда, чтобы следующий захват
+        // сразу содержал отсчеты до срабатывания.
+        if (!pre)
+            continue;
+
+        for (size_t i = 0; i < regs; i++)
+            cap.hist[cap.head * regs + i] = region[i].second;
+        cap.histStamps[cap.head] = stamp;
+        cap.head = (cap.head + 1) % pre;
+        if (cap.filled < pre)
+            cap.filled++;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::m_initHistory(devEntry_t * entry)
+{
+    auto & hist = entry->history;
+    auto words = s_stampWords + entry->devInfo.second;
+    auto size = size_t(entry->opts.histSamples) * words;
+    if (hist.records.size() == size)
+        return;
+
+    // При изменении размера (MOD истории в секундах) в новое кольцо
+    // переносятся самые новые записи, а счетчик отсчетов сохраняется, чтобы
+    // номера отсчетов не менялись.
+    auto oldSamples = hist.records.size() / words;
+    auto keep = std::min(hist.filled, size_t(entry->opts.histSamples));
+    std::vector<uint32_t> records(size, 0);
+    for (size_t i = 0; i < keep; i++)
+    {
+        auto from = (hist.head + oldSamples - keep + i) % oldSamples;
+        std::copy_n(&hist.records[from * words], words, &records[i * words]);
+    }
+
+    hist.records.swap(records);
+    hist.head = entry->opts.histSamples ? keep % entry->opts.histSamples : 0;
+    hist.filled = keep;
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::m_history()
+{
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        auto entry = *it;
+        if (!entry->opts.histSamples || !entry->sampleReady)
+            continue;
+
+        auto & hist = entry->history;
+        auto & region = *entry->region;
+        auto stamp = m_getStamp();
+        auto record = &hist.records[hist.head * (s_stampWords + region.size())];
+
+        record[0] = uint32_t(stamp);
+        record[1] = uint32_t(stamp >> 32);
+        for (size_t i = 0; i < region.size(); i++)
+            record[s_stampWords + i] = region[i].second;
+
+        hist.head = (hist.head + 1) % entry->opts.histSamples;
+        if (hist.filled < entry->opts.histSamples)
+            hist.filled++;
+        hist.total++;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::m_initHgram(devEntry_t * entry)
+{
+    auto & opts = entry->opts;
+    if (opts.hgramBins)
+        entry->hgramBuckets.setLinear(opts.hgramBins, opts.hgramLo, opts.hgramHi);
+    else
+        entry->hgramBuckets.setLogLinear(opts.hgramSub);
+
+    // Счетчики выделяются один раз при добавлении устройства.
+    auto size = opts.hgramWindow ? entry->hgramBuckets.getSize() : 0;
+    entry->hgramCounts.assign(size * entry->devInfo.second, 0);
+    entry->hgramCnt = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::m_countHgrams()
+{
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        auto entry = *it;
+        if (!entry->opts.hgramWindow || !entry->sampleReady)
+            continue;
+
+        auto & region = *entry->region;
+        auto & buckets = entry->hgramBuckets;
+        auto counts = entry->hgramCounts.data();
+        auto size = buckets.getSize();
+
+        for (size_t i = 0; i < region.size(); i++, counts += size)
+            counts[buckets.index(region[i].second)]++;
+        entry->hgramCnt++;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Devices::m_deleteDev(devEntry_t * devInfo)
 {
     delete devInfo->dev;
     delete devInfo->region;
@@ -355,12 +1277,21 @@ bool Devices::m_readRegions()
 
 void Devices::m_getRegions()
 {
+    // Регионы не копируются: передаются указатели на регионы устройств.
     m_regions.resize(0);
 
     for (unsigned int i = 0; i < m_devs.size(); i++)
     {
-        region_t tmpRegion = *m_devs[i]->region;
-        m_regions.push_back(tmpRegion);
+        // Данные устройств с агрегацией передаются только агрегатами (с
+        // гистограммами - только гистограммами), а устройств без передачи
+        // данных - только событиями триггеров.
+        if (m_devs[i]->opts.aggWindow || m_devs[i]->opts.hgramWindow ||
+            m_devs[i]->opts.quiet || !m_devs[i]->sampleReady)
+        {
+            continue;
+        }
+
+        m_regions.push_back(m_devs[i]->region);
     }
 }
 
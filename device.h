@@ -7,7 +7,12 @@
 #include <unistd.h>
 #include <vector>
 #include <list>
+#include <map>
+#include <mutex>
 
+#include "trigger.h"
+#include "hgram.h"
+#include "buffer.h"
 #include "logger-library/logger.h"
 
 //-----------------------------------------------------------------------------
@@ -26,8 +31,47 @@ typedef std::vector<devInfo_t> devsInfo_t;
 typedef std::pair<uint32_t, uint32_t> register_t;
 // Вектор регистров со значениями.
 typedef std::vector<register_t> region_t;
-// Вектор регионов.
-typedef std::vector<region_t> devsRegion_t;
+// Вектор регионов (указатели на регионы, которыми владеют устройства).
+typedef std::vector<region_t *> devsRegion_t;
+
+// Тип ступени фильтра.
+enum class filter_t
+{
+    BOX,        // Скользящее среднее по N отсчетам с прореживанием в N раз.
+    EMA,        // Экспоненциальное скользящее среднее.
+    CIC         // CIC-фильтр 3-го порядка с прореживанием в N раз.
+};
+
+// Ступень фильтра подписки.
+struct filterStage_t
+{
+    filter_t type;              // Тип ступени.
+    unsigned int n;             // Коэффициент прореживания (BOX, CIC).
+    double alpha;               // Коэффициент сглаживания (EMA).
+};
+
+// Параметры подписки на устройство.
+struct subOpts_t
+{
+    double aggSec;              // Окно агрегации в секундах (0 - без агрегации).
+    unsigned int aggWindow;     // Количество значений в окне агрегации.
+    std::vector<filterStage_t> filters;     // Ступени фильтров (по порядку).
+    bool quiet;                 // Данные не передаются (только события триггеров).
+    unsigned int capPre;        // Отсчетов в захвате до срабатывания триггера.
+    unsigned int capPost;       // Отсчетов в захвате после срабатывания триггера.
+    double histSec;             // Размер истории в секундах (0 - без истории).
+    double histMb;              // Размер истории в МБ (вместо секунд).
+    unsigned int histSamples;   // Количество отсчетов в истории.
+    double hgramSec;            // Период передачи гистограмм в секундах (0 - без гистограмм).
+    unsigned int hgramWindow;   // Количество значений в периоде гистограмм.
+    unsigned int hgramBins;     // Количество линейных интервалов (0 - лог-линейные).
+    double hgramLo;             // Нижняя граница линейных интервалов.
+    double hgramHi;             // Верхняя граница линейных интервалов.
+    unsigned int hgramSub;      // Количество бит деления степени двойки.
+};
+
+// Триггер на регистр устройства (индекс регистра в регионе и триггер).
+typedef std::pair<unsigned int, trig::Trigger> regTrigger_t;
 
 //-----------------------------------------------------------------------------
 
@@ -46,6 +90,15 @@ public:
     bool read(region_t & region);
     // Записать значение в регион целиком.
     bool write(uint32_t & value);
+    // Записать массив значений в последовательные регистры региона.
+    bool write(std::vector<uint32_t> & values);
+    // Изменить биты регистров региона по маске (чтение-изменение-запись).
+    bool modify(uint32_t & value, uint32_t & mask);
+    // Прочитать регион count раз подряд без пауз: метки времени считываний
+    // (нс, CLOCK_MONOTONIC) - в stamps, значения регистров подряд по
+    // считываниям - в data (емкость буферов сохраняется между пачками).
+    bool burst(unsigned int count, std::vector<uint64_t> & stamps,
+               std::vector<uint32_t> & data);
 
     //-------------------------------------------------------------------------
 
@@ -62,6 +115,8 @@ private:
     void * m_mapBase;
     // Смещение в странице памяти.
     uint32_t m_offset;
+    // Размер отображенной памяти (целое количество страниц).
+    size_t m_mapSize;
     // Флаг, обозначающий, что память устройства была отображена.
     bool m_mappedFlag;
     // Размер смещения до следующего регистра.
@@ -78,6 +133,19 @@ private:
 
     //-------------------------------------------------------------------------
 
+    // Блокировки страниц регистров.
+    typedef std::vector<std::unique_lock<std::mutex>> pageLocks_t;
+    // Количество мьютексов страниц.
+    static const size_t s_pageStripes = 64;
+    // Мьютексы страниц регистров (общие для всех экземпляров устройств):
+    // страница защищается мьютексом с номером, равным номеру страницы по
+    // модулю s_pageStripes, поэтому память не растет с числом страниц.
+    static std::mutex s_pageMutexes[s_pageStripes];
+    // Заблокировать все страницы, которые занимает регион.
+    pageLocks_t m_lockPages();
+
+    //-------------------------------------------------------------------------
+
     // Открыть файл символьного устройства.
     bool m_openChrdev();
     // Отобразить устройство в физическую память.
@@ -91,28 +159,185 @@ class Devices
 {
 public:
 
-    Devices(dev::devInfo_t & dev);
+    // Накопленные значения регистра (минимум, максимум и последнее).
+    struct merged_t
+    {
+        uint32_t min;
+        uint32_t max;
+        uint32_t last;
+    };
+
+    // Состояние захвата.
+    enum class capState_t
+    {
+        IDLE,       // Ожидание срабатывания триггера.
+        COLLECT,    // Сбор отсчетов после срабатывания.
+        READY       // Захват собран и ожидает передачи.
+    };
+
+    // Осциллографический захват устройства: кольцевой буфер последних отсчетов
+    // постоянно заполняется, а при срабатывании триггера его содержимое
+    // фиксируется и дополняется отсчетами после срабатывания. Буферы выделяются
+    // при добавлении устройства.
+    struct capture_t
+    {
+        capState_t state;               // Состояние захвата.
+        std::vector<uint32_t> hist;     // Последние значения регистров (по отсчетам).
+        std::vector<uint64_t> histStamps;   // Метки времени последних отсчетов.
+        size_t head;                    // Индекс следующего отсчета в буфере.
+        size_t filled;                  // Количество отсчетов в буфере.
+        std::vector<uint32_t> data;     // Значения регистров захвата.
+        std::vector<uint64_t> stamps;   // Метки времени отсчетов захвата.
+        size_t count;                   // Количество отсчетов в захвате.
+        size_t pre;                     // Из них до срабатывания триггера.
+        unsigned int postLeft;          // Осталось собрать после срабатывания.
+        unsigned int trigger;           // Сработавший триггер (0 - нет).
+        unsigned int id;                // Идентификатор передаваемого захвата (0 - не назначен).
+        size_t sent;                    // Передано частей захвата.
+    };
+
+    // История отсчетов устройства: кольцо записей фиксированного размера
+    // (метка времени в нс - 2 слова, затем значения регистров). Номер отсчета
+    // не хранится - записи идут подряд, и номер вычисляется по счетчику.
+    struct history_t
+    {
+        std::vector<uint32_t> records;  // Записи отсчетов.
+        size_t head;                    // Индекс следующей записи.
+        size_t filled;                  // Количество записей в кольце.
+        uint64_t total;                 // Номер следующего отсчета.
+    };
+
+    // Количество слов метки времени в записи истории.
+    static const size_t s_stampWords = 2;
+
+    // Порядок CIC-фильтра.
+    static const unsigned int s_cicOrder = 3;
+
+    // Состояние ступени фильтра для одного регистра.
+    struct filterState_t
+    {
+        double acc;                     // Сумма (BOX) или выход (EMA).
+        uint64_t integ[s_cicOrder];     // Интеграторы CIC.
+        uint64_t comb[s_cicOrder];      // Задержки гребенчатых звеньев CIC.
+    };
+
+    // Агрегат регистра за окно (среднее и сумма квадратов отклонений
+    // считаются инкрементально по алгоритму Уэлфорда).
+    struct aggregate_t
+    {
+        uint32_t min;
+        uint32_t max;
+        uint32_t last;
+        double mean;
+        double m2;
+    };
+
+    // Устройство в пуле считываемых (перемещается между пулами целиком вместе
+    // с отображением и состоянием).
+    struct devEntry_t
+    {
+        devInfo_t devInfo;  // Информация о базовом адресе и количестве регистров.
+        Device * dev;       // Указатель на класс устройства.
+        region_t * region;  // Регион устройства.
+        unsigned int id;    // Идентификатор подписки.
+
+        // Значения, накопленные при переполнении очереди пакетов.
+        std::vector<merged_t> merged;
+        // Количество накопленных считываний.
+        unsigned int mergedCnt;
+
+        // Параметры подписки.
+        subOpts_t opts;
+        // Количество считываний в текущем окне агрегации.
+        unsigned int aggCnt;
+        // Смещение агрегатов устройства в массиве агрегатов пула.
+        size_t aggOffset;
+        // Агрегаты незавершенного окна, перенесенные из другого пула (MOD).
+        std::vector<aggregate_t> aggCarry;
+
+        // Состояние ступеней фильтров (подряд по регистрам для каждой ступени).
+        std::vector<filterState_t> filterState;
+        // Количество отсчетов, поступивших на ступени с прореживанием.
+        std::vector<unsigned int> filterCnt;
+        // Количество значений, выданных ступенями (для переходного процесса CIC).
+        std::vector<unsigned int> filterOuts;
+        // Значения регистров между ступенями фильтров.
+        std::vector<double> filterVal;
+        // Фильтры выдали значение при последнем считывании (без фильтров - всегда).
+        bool sampleReady;
+
+        // Триггеры на регистры устройства.
+        std::vector<regTrigger_t> triggers;
+        // Осциллографический захват (при заданных capPre/capPost).
+        capture_t capture;
+        // История отсчетов (при заданном histSamples).
+        history_t history;
+
+        // Интервалы гистограмм регистров (при заданном hgramWindow).
+        hgram::Buckets hgramBuckets;
+        // Счетчики интервалов (подряд для каждого регистра).
+        std::vector<uint32_t> hgramCounts;
+        // Количество значений в гистограммах текущего периода.
+        unsigned int hgramCnt;
+    };
+
+    // Вектор агрегатов регистров.
+    typedef std::vector<aggregate_t> aggregates_t;
+
+    // Вектор указателей на устройство и его информацию.
+    typedef std::vector<devEntry_t *> devs_t;
+
+    //-------------------------------------------------------------------------
+
+    // mapped - отображение устройства, переданное пулу (nullptr - отобразить
+    // заново).
+    Devices(dev::devInfo_t & dev, unsigned int id, const subOpts_t & opts,
+            Device * mapped = nullptr);
+    Devices(devEntry_t * entry);
     ~Devices();
 
     //-------------------------------------------------------------------------
 
-    // Прочитать регионы устройств.
+    // Прочитать регионы устройств (регионы устройств с агрегацией не
+    // возвращаются, а накапливаются в агрегатах).
     bool read(devsRegion_t ** regions);
+    // Прочитать регионы устройств и накопить значения вместо передачи.
+    bool merge();
+    // Прочитать регионы устройств без передачи данных: фильтры, триггеры,
+    // захваты, история, агрегаты и гистограммы обновляются (окна агрегации и
+    // периоды гистограмм продлеваются до освобождения очереди).
+    bool sample();
 
     //-------------------------------------------------------------------------
 
-    // Добавить устройство к пулу считываемых.
-    bool add(dev::devInfo_t & devInfo);
+    // Добавить устройство к пулу считываемых (mapped - переданное пулу
+    // отображение, при ошибке остается у вызывающего).
+    bool add(dev::devInfo_t & devInfo, unsigned int id, const subOpts_t & opts,
+             Device * mapped = nullptr);
     // Удалить устройство из пула считываемых.
     bool remove(uint32_t & addr);
+    // Удалить устройство из пула, передав его отображение вызывающему
+    // (nullptr - нет устройства).
+    Device * release(uint32_t & addr);
     // Удалить все устройства из пула считываемых.
     void removeAll();
+    // Извлечь устройство из пула без освобождения памяти (nullptr - нет устройства).
+    devEntry_t * extract(uint32_t & addr);
+    // Добавить ранее извлеченное устройство в пул.
+    void insert(devEntry_t * entry);
 
 
     //-------------------------------------------------------------------------
 
     // Вернуть список активных устройств.
     devsInfo_t getActive();
+    // Вернуть устройства пула.
+    const devs_t & getEntries();
+    // Вернуть устройства, окно агрегации которых завершилось при последнем
+    // считывании.
+    const devs_t & getAggReady();
+    // Вернуть агрегаты регистров устройства.
+    const aggregate_t * getAggregates(devEntry_t * entry);
     // Проверить находится ли устройство в пуле.
     bool isExist(uint32_t & addr);
     // Проверить есть ли активные устройства.
@@ -120,25 +345,56 @@ public:
 
     //-------------------------------------------------------------------------
 
+    // Добавить триггер на регистр устройства пула (false - регистр не считывается).
+    bool addTrigger(uint32_t & addr, const trig::Trigger & trigger);
+    // Удалить триггер по идентификатору.
+    bool removeTrigger(unsigned int id);
+    // Вернуть события, накопленные с последней очистки.
+    const trig::events_t & getEvents();
+    // Очистить события после передачи.
+    void clearEvents();
+    // Освободить переданный захват устройства (захват снова ожидает триггер).
+    void releaseCapture(devEntry_t * entry);
+    // Проверить завершился ли период гистограмм устройства.
+    bool isHgramReady(devEntry_t * entry);
+    // Начать новый период гистограмм после передачи.
+    void releaseHgram(devEntry_t * entry);
+
+    //-------------------------------------------------------------------------
+
+    // Получить номер самого старого отсчета в истории устройства.
+    uint64_t getHistoryFirst(devEntry_t * entry);
+    // Найти номер первого отсчета истории с меткой времени не меньше stamp.
+    uint64_t findHistory(devEntry_t * entry, uint64_t stamp);
+    // Получить запись истории по номеру отсчета (номер должен быть в истории).
+    const uint32_t * getHistoryRecord(devEntry_t * entry, uint64_t seq);
+
+    //-------------------------------------------------------------------------
+
 private:
 
     // Класс логирования.
     logger::Logger log;
 
-    // Структура устройства.
-    struct m_dev_t
-    {
-        devInfo_t devInfo;  // Информация о базовом адресе и количестве регистров.
-        Device * dev;       // Указатель на класс устройства.
-        region_t * region;  // Регион устройства.
-    };
-    // Вектор указателей на устройство и его информацию.
-    typedef std::vector<m_dev_t *> devs_t;
-
     // Вектор устройств.
     devs_t m_devs;
     // Вектор регионов устройств.
     devsRegion_t m_regions;
+    // Агрегаты регистров устройств с агрегацией (подряд для каждого устройства).
+    aggregates_t m_aggs;
+    // Устройства, окно агрегации которых завершилось.
+    devs_t m_aggReady;
+    // События сработавших триггеров.
+    trig::events_t m_events;
+    // Максимальное количество непереданных событий (при переполнении очереди
+    // пакетов с политикой MERGE события не передаются, но триггеры проверяются).
+    static const size_t s_maxEvents = 64;
+    // Длина адреса или значения регистра в HEX-виде ("0x0000abcd").
+    static const size_t s_hexSize = 10;
+    // Буфер для записи адреса и значения регистра события в HEX-виде.
+    buffer::Buffer m_eventText;
+    // Время текущего считывания в нс (0 - еще не получено).
+    uint64_t m_stamp;
 
     //-------------------------------------------------------------------------
 
@@ -148,7 +404,44 @@ private:
     //-------------------------------------------------------------------------
 
     // Создать и добавить устройство в пул.
-    void m_createDev(devInfo_t & devInfo);
+    void m_createDev(devInfo_t & devInfo, unsigned int id,
+                     const subOpts_t & opts, Device * mapped);
+
+    //-------------------------------------------------------------------------
+
+    // Перераспределить массив агрегатов после изменения состава пула
+    // (накопленные значения устройств сохраняются).
+    void m_layoutAggs();
+    // Начать заново окна, завершенные при прошлом считывании (они уже
+    // переданы). Вызывается до изменения состава пула.
+    void m_resetAggReady();
+    // Накопить прочитанные значения в агрегатах (ready - отмечать устройства,
+    // окно агрегации которых завершилось).
+    void m_accumulate(bool ready);
+    // Подготовить состояние фильтров устройства.
+    void m_initFilters(devEntry_t * entry);
+    // Пропустить прочитанные значения через фильтры устройств.
+    void m_filter();
+    // Пропустить значения через ступень фильтра (false - ступень не выдала
+    // значение, например, при прореживании).
+    bool m_filterStage(devEntry_t * entry, size_t stage);
+    // Проверить триггеры устройств на прочитанных значениях.
+    void m_checkTriggers();
+    // Получить время текущего считывания (одно на считывание).
+    uint64_t m_getStamp();
+    // Подготовить буферы захвата устройства.
+    void m_initCapture(devEntry_t * entry);
+    // Добавить прочитанные значения в захваты устройств.
+    void m_capture();
+    // Подготовить кольцо истории устройства (история сбрасывается, только если
+    // изменился ее размер).
+    void m_initHistory(devEntry_t * entry);
+    // Добавить прочитанные значения в историю устройств.
+    void m_history();
+    // Подготовить гистограммы устройства.
+    void m_initHgram(devEntry_t * entry);
+    // Добавить прочитанные значения в гистограммы устройств.
+    void m_countHgrams();
 
     //-------------------------------------------------------------------------
 
@@ -160,7 +453,7 @@ private:
     //-------------------------------------------------------------------------
 
     // Очистить память, выделенную под устройство.
-    void m_deleteDev(m_dev_t * devInfo);
+    void m_deleteDev(devEntry_t * devInfo);
     // Очистить память и удалить устройства.
     void m_deleteDevs();
     // Очистить вектор регионов устройств.
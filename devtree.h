@@ -21,7 +21,8 @@ typedef std::string file_t;
 
 //=============================================================================
 
-// CPU (int(answer['CPU_temp']) * 503.975)/4096) - 273.15
+// Температура CPU в градусах вычисляется на плате производным каналом
+// cpu-temp (см. секцию [DERIVED] конфигурационного файла).
 
 // Определен ниже.
 class Api;
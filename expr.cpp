@@ -0,0 +1,477 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "expr.h"
+
+//-----------------------------------------------------------------------------
+
+namespace expr
+{
+
+//=============================================================================
+
+Program::Program()
+    : m_text(nullptr), m_pos(nullptr), m_depth(0), m_nesting(0)
+{}
+
+//-----------------------------------------------------------------------------
+
+bool Program::compile(const std::string & text, std::string & error)
+{
+    m_code.clear();
+    m_consts.clear();
+    m_sources.clear();
+    m_text = text.c_str();
+    m_pos = m_text;
+    m_depth = 0;
+    m_nesting = 0;
+    m_error.clear();
+
+    auto ok = m_parseOr();
+    m_match("");
+    if (ok && *m_pos)
+        ok = m_fail("unexpected symbol");
+
+    if (!ok)
+    {
+        error = m_error;
+        m_code.clear();
+    }
+
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+
+const std::vector<source_t> & Program::getSources() const
+{
+    return m_sources;
+}
+
+//-----------------------------------------------------------------------------
+
+double Program::run(const double * values) const
+{
+    double stack[s_maxDepth];
+    size_t sp = 0;
+
+    for (auto it = m_code.begin(); it != m_code.end(); it++)
+    {
+        switch (it->op)
+        {
+        case op_t::CONST:
+            stack[sp++] = m_consts[it->arg];
+            break;
+        case op_t::LOAD:
+            stack[sp++] = values[it->arg];
+            break;
+        case op_t::NEG:
+        case op_t::ABS:
+        case op_t::NOT:
+        case op_t::BITS:
+            stack[sp - 1] = m_apply(*it, stack[sp - 1], 0);
+            break;
+        default:
+            sp--;
+            stack[sp - 1] = m_apply(*it, stack[sp - 1], stack[sp]);
+            break;
+        }
+    }
+
+    return sp ? stack[0] : 0;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_parseOr()
+{
+    if (!m_parseXor())
+        return false;
+
+    while (m_match("|"))
+    {
+        if (!m_parseXor() || !m_emit(op_t::OR))
+            return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_parseXor()
+{
+    if (!m_parseAnd())
+        return false;
+
+    while (m_match("^"))
+    {
+        if (!m_parseAnd() || !m_emit(op_t::XOR))
+            return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_parseAnd()
+{
+    if (!m_parseShift())
+        return false;
+
+    while (m_match("&"))
+    {
+        if (!m_parseShift() || !m_emit(op_t::AND))
+            return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_parseShift()
+{
+    if (!m_parseAdd())
+        return false;
+
+    while (true)
+    {
+        op_t op;
+        if (m_match("<<"))
+            op = op_t::SHL;
+        else if (m_match(">>"))
+            op = op_t::SHR;
+        else
+            return true;
+
+        if (!m_parseAdd() || !m_emit(op))
+            return false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_parseAdd()
+{
+    if (!m_parseMul())
+        return false;
+
+    while (true)
+    {
+        op_t op;
+        if (m_match("+"))
+            op = op_t::ADD;
+        else if (m_match("-"))
+            op = op_t::SUB;
+        else
+            return true;
+
+        if (!m_parseMul() || !m_emit(op))
+            return false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_parseMul()
+{
+    if (!m_parseUnary())
+        return false;
+
+    while (true)
+    {
+        op_t op;
+        if (m_match("*"))
+            op = op_t::MUL;
+        else if (m_match("/"))
+            op = op_t::DIV;
+        else if (m_match("%"))
+            op = op_t::MOD;
+        else
+            return true;
+
+        if (!m_parseUnary() || !m_emit(op))
+            return false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_parseUnary()
+{
+    if (m_match("-"))
+        return m_parseNested(&Program::m_parseUnary) && m_emit(op_t::NEG);
+    if (m_match("~"))
+        return m_parseNested(&Program::m_parseUnary) && m_emit(op_t::NOT);
+    if (m_match("+"))
+        return m_parseNested(&Program::m_parseUnary);
+
+    return m_parsePostfix();
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_parsePostfix()
+{
+    if (!m_parsePrimary())
+        return false;
+
+    // Битовое поле [hi:lo] или [bit].
+    while (m_match("["))
+    {
+        double hi;
+        double lo;
+        m_match("");
+        if (!m_parseNumber(hi))
+            return false;
+
+        lo = hi;
+        if (m_match(":"))
+        {
+            m_match("");
+            if (!m_parseNumber(lo))
+                return false;
+        }
+
+        if (!m_match("]"))
+            return m_fail("']' expected");
+        if (hi != floor(hi) || lo != floor(lo) || lo < 0 || hi < lo || hi > 31)
+            return m_fail("invalid bit field");
+
+        if (!m_emit(op_t::BITS, 0, uint8_t(lo), uint8_t(hi - lo + 1)))
+            return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_parsePrimary()
+{
+    if (m_match("("))
+    {
+        if (!m_parseNested(&Program::m_parseOr))
+            return false;
+        return m_match(")") || m_fail("')' expected");
+    }
+
+    if (m_match("reg("))
+        return m_parseSource(false);
+    if (m_match("api("))
+        return m_parseSource(true);
+    if (m_match("abs("))
+    {
+        if (!m_parseNested(&Program::m_parseOr))
+            return false;
+        if (!m_match(")"))
+            return m_fail("')' expected");
+        return m_emit(op_t::ABS);
+    }
+
+    double value;
+    if (!m_parseNumber(value))
+        return false;
+
+    m_consts.push_back(value);
+    return m_emit(op_t::CONST, uint32_t(m_consts.size() - 1));
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_parseNested(bool (Program::*parse)())
+{
+    if (m_nesting == s_maxNesting)
+        return m_fail("expression is too deep");
+
+    m_nesting++;
+    auto ok = (this->*parse)();
+    m_nesting--;
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_parseSource(bool api)
+{
+    source_t source {api, 0, ""};
+    m_match("");
+
+    if (api)
+    {
+        // Alias файла API - до закрывающей скобки без пробелов.
+        auto end = m_pos;
+        while (*end && *end != ')' && !isspace((unsigned char) *end))
+            end++;
+        if (end == m_pos || !memchr(m_pos, '@', size_t(end - m_pos)))
+            return m_fail("API alias expected");
+
+        source.alias.assign(m_pos, end);
+        m_pos = end;
+    }
+    else
+    {
+        double addr;
+        if (!m_parseNumber(addr))
+            return false;
+        if (addr != floor(addr) || addr > 0xffffffff || uint32_t(addr) % 4)
+            return m_fail("invalid register address");
+
+        source.addr = uint32_t(addr);
+    }
+
+    if (!m_match(")"))
+        return m_fail("')' expected");
+
+    // Повторные обращения к источнику используют один номер.
+    uint32_t index = 0;
+    for (; index < m_sources.size(); index++)
+    {
+        auto & it = m_sources[index];
+        if (it.api == api && it.addr == source.addr && it.alias == source.alias)
+            break;
+    }
+
+    if (index == m_sources.size())
+        m_sources.push_back(source);
+
+    return m_emit(op_t::LOAD, index);
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_parseNumber(double & value)
+{
+    char * end = nullptr;
+
+    // Шестнадцатеричные числа - только целые, десятичные - с дробной частью
+    // и порядком (strtod допускает также inf и nan, поэтому проверяется
+    // первый символ).
+    if (!strncmp(m_pos, "0x", 2) || !strncmp(m_pos, "0X", 2))
+        value = double(strtoull(m_pos, &end, 16));
+    else if (isdigit((unsigned char) *m_pos) || *m_pos == '.')
+        value = strtod(m_pos, &end);
+
+    if (!end || end == m_pos)
+        return m_fail("number expected");
+
+    m_pos = end;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_match(const char * token)
+{
+    while (isspace((unsigned char) *m_pos))
+        m_pos++;
+
+    auto size = strlen(token);
+    if (strncmp(m_pos, token, size))
+        return false;
+
+    m_pos += size;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_fail(const char * what)
+{
+    if (!m_error.size())
+        m_error = std::string(what) + " at " + std::to_string(m_pos - m_text);
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Program::m_emit(op_t op, uint32_t arg, uint8_t lo, uint8_t width)
+{
+    instr_t in {op, lo, width, 0, arg};
+    auto size = m_code.size();
+
+    switch (op)
+    {
+    case op_t::CONST:
+    case op_t::LOAD:
+        if (++m_depth > s_maxDepth)
+            return m_fail("expression is too deep");
+        break;
+
+    case op_t::NEG:
+    case op_t::ABS:
+    case op_t::NOT:
+    case op_t::BITS:
+        // Операция над константой заменяется результатом.
+        if (size && m_code[size - 1].op == op_t::CONST)
+        {
+            auto & value = m_consts[m_code[size - 1].arg];
+            value = m_apply(in, value, 0);
+            return true;
+        }
+        break;
+
+    default:
+        m_depth--;
+        // Операция над двумя константами заменяется результатом (константы
+        // добавляются по порядку, поэтому вторая - последняя в таблице).
+        if (size > 1 && m_code[size - 1].op == op_t::CONST &&
+            m_code[size - 2].op == op_t::CONST)
+        {
+            auto & value = m_consts[m_code[size - 2].arg];
+            value = m_apply(in, value, m_consts.back());
+            m_consts.pop_back();
+            m_code.pop_back();
+            return true;
+        }
+        break;
+    }
+
+    if (size == s_maxCode)
+        return m_fail("expression is too long");
+
+    m_code.push_back(in);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+double Program::m_apply(const instr_t & in, double a, double b)
+{
+    // Побитовые операции - над 32-битными целыми (значения вне диапазона
+    // 64-битных целых считаются нулем).
+    auto toInt = [](double value)
+    {
+        return fabs(value) < 9.2e18 ? uint32_t(int64_t(value)) : 0u;
+    };
+    auto x = toInt(a);
+    auto y = toInt(b);
+
+    switch (in.op)
+    {
+    case op_t::ADD: return a + b;
+    case op_t::SUB: return a - b;
+    case op_t::MUL: return a * b;
+    case op_t::DIV: return a / b;
+    case op_t::MOD: return fmod(a, b);
+    case op_t::NEG: return -a;
+    case op_t::ABS: return fabs(a);
+    case op_t::NOT: return double(uint32_t(~x));
+    case op_t::AND: return double(x & y);
+    case op_t::OR: return double(x | y);
+    case op_t::XOR: return double(x ^ y);
+    case op_t::SHL: return y < 32 ? double(uint32_t(x << y)) : 0;
+    case op_t::SHR: return y < 32 ? double(x >> y) : 0;
+    case op_t::BITS:
+        return double((uint64_t(x) >> in.lo) & ((uint64_t(1) << in.width) - 1));
+    default: return 0;
+    }
+}
+
+//=============================================================================
+
+} // namespace expr
@@ -0,0 +1,140 @@
+#ifndef EXPR_H
+#define EXPR_H
+
+//-----------------------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+
+namespace expr
+{
+
+//=============================================================================
+
+// Операция байт-кода.
+enum class op_t : uint8_t
+{
+    CONST,      // Поместить в стек константу.
+    LOAD,       // Поместить в стек значение источника.
+    ADD,        // Сложение.
+    SUB,        // Вычитание.
+    MUL,        // Умножение.
+    DIV,        // Деление.
+    MOD,        // Остаток от деления.
+    NEG,        // Смена знака.
+    ABS,        // Модуль.
+    NOT,        // Побитовое НЕ.
+    AND,        // Побитовое И.
+    OR,         // Побитовое ИЛИ.
+    XOR,        // Побитовое исключающее ИЛИ.
+    SHL,        // Сдвиг влево.
+    SHR,        // Сдвиг вправо.
+    BITS        // Выделение битового поля.
+};
+
+// Инструкция байт-кода.
+typedef struct instr
+{
+    op_t op;            // Операция.
+    uint8_t lo;         // Младший бит поля (BITS).
+    uint8_t width;      // Ширина поля в битах (BITS).
+    uint8_t reserved;
+    uint32_t arg;       // Номер константы (CONST) или источника (LOAD).
+} instr_t;
+
+// Источник значения выражения.
+typedef struct source
+{
+    bool api;           // Файл API (иначе регистр).
+    uint32_t addr;      // Адрес регистра.
+    std::string alias;  // Alias файла API ("AD1@/calib_mode").
+} source_t;
+
+//-----------------------------------------------------------------------------
+
+// Выражение над значениями регистров и файлов API, скомпилированное в байт-код
+// стековой машины. Выражение разбирается один раз, а вычисляется при каждом
+// считывании без выделения памяти.
+// Операнды: числа (десятичные и 0x...), reg(<адрес>) - значение регистра,
+// api(<alias>) - числовое значение файла API. Операции (по убыванию
+// приоритета): x[hi:lo] - битовое поле, унарные - и ~, abs(x), * / %, + -,
+// << >>, &, ^, |. Побитовые операции выполняются над 32-битными целыми
+// (разрядность регистров), остальные - над double.
+class Program
+{
+public:
+
+    Program();
+
+    //-------------------------------------------------------------------------
+
+    // Скомпилировать выражение (false - ошибка, error - ее описание).
+    bool compile(const std::string & text, std::string & error);
+    // Получить источники выражения (в порядке номеров).
+    const std::vector<source_t> & getSources() const;
+    // Вычислить выражение по значениям источников (в порядке номеров).
+    double run(const double * values) const;
+
+private:
+
+    // Байт-код.
+    std::vector<instr_t> m_code;
+    // Константы.
+    std::vector<double> m_consts;
+    // Источники.
+    std::vector<source_t> m_sources;
+
+    // Максимальная глубина стека.
+    static const size_t s_maxDepth = 32;
+    // Максимальное количество инструкций.
+    static const size_t s_maxCode = 256;
+    // Максимальная вложенность унарных операций и скобок при разборе.
+    static const size_t s_maxNesting = 32;
+
+    //-------------------------------------------------------------------------
+
+    // Состояние разбора: текст, текущая позиция, глубина стека, вложенность
+    // и ошибка.
+    const char * m_text;
+    const char * m_pos;
+    size_t m_depth;
+    size_t m_nesting;
+    std::string m_error;
+
+    // Разобрать операции по уровням приоритета.
+    bool m_parseOr();
+    bool m_parseXor();
+    bool m_parseAnd();
+    bool m_parseShift();
+    bool m_parseAdd();
+    bool m_parseMul();
+    bool m_parseUnary();
+    bool m_parsePostfix();
+    bool m_parsePrimary();
+    // Разобрать вложенную часть выражения с ограничением глубины рекурсии
+    // (длинная строка "((((..." или "----..." не переполняет стек).
+    bool m_parseNested(bool (Program::*parse)());
+    // Разобрать источник после "reg(" или "api(".
+    bool m_parseSource(bool api);
+    // Разобрать число.
+    bool m_parseNumber(double & value);
+
+    // Пропустить пробелы и проверить следующую лексему (при совпадении она
+    // пропускается).
+    bool m_match(const char * token);
+    // Запомнить ошибку в текущей позиции.
+    bool m_fail(const char * what);
+    // Добавить инструкцию (константные операции сворачиваются).
+    bool m_emit(op_t op, uint32_t arg = 0, uint8_t lo = 0, uint8_t width = 0);
+    // Выполнить операцию над значениями стека.
+    static double m_apply(const instr_t & in, double a, double b);
+};
+
+//=============================================================================
+
+} // namespace expr
+
+#endif // EXPR_H
@@ -0,0 +1,55 @@
+#include "hgram.h"
+
+//-----------------------------------------------------------------------------
+
+namespace hgram
+{
+
+//=============================================================================
+
+Buckets::Buckets()
+    : m_scale(scale_t::LOGLIN), m_bins(0), m_lo(0), m_hi(0), m_perUnit(0),
+      m_subBits(s_defSubBits)
+{}
+
+//-----------------------------------------------------------------------------
+
+void Buckets::setLinear(unsigned int bins, double lo, double hi)
+{
+    m_scale = scale_t::LINEAR;
+    m_bins = bins;
+    m_lo = lo;
+    m_hi = hi;
+    m_perUnit = bins / (hi - lo);
+}
+
+//-----------------------------------------------------------------------------
+
+void Buckets::setLogLinear(unsigned int subBits)
+{
+    m_scale = scale_t::LOGLIN;
+    m_subBits = subBits;
+}
+
+//-----------------------------------------------------------------------------
+
+scale_t Buckets::getScale() const
+{
+    return m_scale;
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Buckets::getSize() const
+{
+    if (m_scale == scale_t::LINEAR)
+        return m_bins + 2;
+
+    // Собственные интервалы малых значений и по 2^subBits интервалов на
+    // каждую степень двойки от subBits до 31.
+    return size_t(33 - m_subBits) << m_subBits;
+}
+
+//=============================================================================
+
+} // namespace hgram
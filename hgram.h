@@ -0,0 +1,100 @@
+#ifndef HGRAM_H
+#define HGRAM_H
+
+//-----------------------------------------------------------------------------
+
+#include <stddef.h>
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+
+namespace hgram
+{
+
+//=============================================================================
+
+// Вид интервалов гистограммы.
+enum class scale_t
+{
+    LINEAR,     // Равные интервалы в заданном диапазоне.
+    LOGLIN      // Лог-линейные интервалы во всем диапазоне 32-битных значений.
+};
+
+// Максимальное количество линейных интервалов.
+static const unsigned int s_maxBins = 1024;
+// Максимальное и используемое по умолчанию количество бит деления степени
+// двойки на лог-линейные интервалы.
+static const unsigned int s_maxSubBits = 4;
+static const unsigned int s_defSubBits = 2;
+
+//-----------------------------------------------------------------------------
+
+// Отображение значения регистра в номер интервала гистограммы.
+// Линейные интервалы: интервал 0 - значения меньше lo, интервалы от 1 до bins
+// делят [lo, hi) на равные части, интервал bins + 1 - значения не меньше hi.
+// Лог-линейные интервалы: значения меньше 2^subBits имеют собственные
+// интервалы, далее каждая степень двойки делится на 2^subBits равных
+// интервалов, поэтому относительная ширина интервала не больше 2^-subBits.
+class Buckets
+{
+public:
+
+    Buckets();
+
+    //-------------------------------------------------------------------------
+
+    // Задать линейные интервалы.
+    void setLinear(unsigned int bins, double lo, double hi);
+    // Задать лог-линейные интервалы.
+    void setLogLinear(unsigned int subBits);
+    // Получить вид интервалов.
+    scale_t getScale() const;
+    // Получить количество интервалов.
+    size_t getSize() const;
+
+    //-------------------------------------------------------------------------
+
+    // Получить номер интервала значения (вызывается при каждом считывании).
+    size_t index(uint32_t value) const
+    {
+        if (m_scale == scale_t::LINEAR)
+        {
+            if (value < m_lo)
+                return 0;
+            if (value >= m_hi)
+                return m_bins + 1;
+
+            auto bin = size_t((value - m_lo) * m_perUnit);
+            return 1 + (bin < m_bins ? bin : m_bins - 1);
+        }
+
+        if (value < (1u << m_subBits))
+            return value;
+
+        // Старший бит задает степень двойки, следующие subBits бит - интервал
+        // внутри нее.
+        auto exp = unsigned(31 - __builtin_clz(value));
+        auto shift = exp - m_subBits;
+        return (size_t(shift + 1) << m_subBits) +
+               ((value >> shift) & ((1u << m_subBits) - 1));
+    }
+
+private:
+
+    // Вид интервалов.
+    scale_t m_scale;
+    // Параметры линейных интервалов.
+    unsigned int m_bins;
+    double m_lo;
+    double m_hi;
+    // Количество интервалов на единицу значения.
+    double m_perUnit;
+    // Количество бит деления степени двойки.
+    unsigned int m_subBits;
+};
+
+//=============================================================================
+
+} // namespace hgram
+
+#endif // HGRAM_H
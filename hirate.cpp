@@ -0,0 +1,428 @@
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <math.h>
+#include <iomanip>
+#include <algorithm>
+
+#include "hirate.h"
+#include "common.h"
+#include "config-library/iiniparams.h"
+#include "config-library/ciniparser.h"
+
+//-----------------------------------------------------------------------------
+
+namespace hirate
+{
+
+//=============================================================================
+
+Sampler::Sampler(int eventFd)
+    : m_cfg(m_readConfig()), m_dropsTotal(0),
+      m_ring(m_cfg.queuePackets, s_maxPkgSize, eventFd),
+      m_timer(m_cfg.maxHz), m_activated(false)
+{}
+
+//-----------------------------------------------------------------------------
+
+Sampler::~Sampler()
+{
+    m_stop();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_channels.begin(); it != m_channels.end(); it++)
+        delete it->dev;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Sampler::isHighRate(timers::hz_t hz)
+{
+    return hz > s_baseMaxHz;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Sampler::add(dev::devInfo_t & devInfo, timers::hz_t hz, unsigned int id,
+                  dev::Device * mapped)
+{
+    auto period = m_timer.hzToPeriod(hz);
+    if (!period)
+    {
+        LOGGER_ERROR("Wrong frequency for high-rate sampling");
+        return false;
+    }
+
+    // Высокочастотно считываются только небольшие наборы регистров.
+    if (!devInfo.second || devInfo.second > m_cfg.maxRegs)
+    {
+        LOGGER_ERROR("Too many registers for high-rate sampling");
+        return false;
+    }
+
+    auto dev = mapped ? mapped : new dev::Device(devInfo);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_find(devInfo.first) != m_channels.end())
+        {
+            if (!mapped)
+                delete dev;
+            return false;
+        }
+
+        m_channels.emplace_back();
+        auto & ch = m_channels.back();
+        ch.devInfo = devInfo;
+        ch.dev = dev;
+        ch.region.resize(devInfo.second);
+        ch.dev->fillAddrs(ch.region);
+        ch.id = id;
+        ch.drops = 0;
+        m_setRate(ch, hz, period);
+    }
+
+    m_timer.add(period);
+    return m_start();
+}
+
+//-----------------------------------------------------------------------------
+
+bool Sampler::remove(uint32_t & addr, channelInfo_t & info,
+                     dev::Device ** mapped)
+{
+    bool empty;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto ch = m_find(addr);
+        if (ch == m_channels.end())
+            return false;
+
+        // Неполная пачка отсчетов не отправляется.
+        info = {ch->devInfo, ch->hz, ch->id, ch->drops};
+        m_timer.remove(ch->period);
+        if (mapped)
+            *mapped = ch->dev;
+        else
+            delete ch->dev;
+        m_channels.erase(ch);
+        empty = !m_channels.size();
+    }
+
+    // Остановить поток, если это было последнее устройство.
+    if (empty)
+        m_stop();
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Sampler::removeAll(std::vector<unsigned int> & ids)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_channels.begin(); it != m_channels.end(); it++)
+        {
+            ids.push_back(it->id);
+            m_timer.remove(it->period);
+            delete it->dev;
+        }
+        m_channels.clear();
+    }
+
+    m_stop();
+}
+
+//-----------------------------------------------------------------------------
+
+bool Sampler::mod(uint32_t & addr, timers::hz_t hz)
+{
+    auto period = m_timer.hzToPeriod(hz);
+    if (!period)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto ch = m_find(addr);
+    if (ch == m_channels.end())
+        return false;
+
+    if (ch->period == period)
+        return true;
+
+    m_timer.remove(ch->period);
+    m_setRate(*ch, hz, period);
+    m_timer.add(period);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Sampler::isExist(uint32_t & addr)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_find(addr) != m_channels.end();
+}
+
+//-----------------------------------------------------------------------------
+
+void Sampler::getChannels(std::vector<channelInfo_t> & channels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_channels.begin(); it != m_channels.end(); it++)
+        channels.push_back({it->devInfo, it->hz, it->id, it->drops});
+}
+
+//-----------------------------------------------------------------------------
+
+uint64_t Sampler::getDrops()
+{
+    return m_dropsTotal.load();
+}
+
+//-----------------------------------------------------------------------------
+
+timers::schedStat_t Sampler::getSchedStat()
+{
+    return m_timer.getStat();
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Sampler::peek(ring::pkg_t ** pkgs, size_t max)
+{
+    return m_ring.peek(pkgs, max);
+}
+
+//-----------------------------------------------------------------------------
+
+void Sampler::release(size_t count)
+{
+    m_ring.release(count);
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Sampler::size()
+{
+    return m_ring.size();
+}
+
+//-----------------------------------------------------------------------------
+
+Sampler::samplerCfg_t Sampler::m_readConfig()
+{
+    samplerCfg_t cfg {s_maxHz, s_maxRegs, s_packetMs, s_queuePackets, -1};
+
+    auto params = cfg::ini::parseConfig("/opt/control/conf", "tpoprotocol.ini",
+                                        "STATISTIC");
+    if (!params)
+        return cfg;
+
+    auto maxHz = params->getInt("hirate-max-hz", int(s_maxHz));
+    if (maxHz > s_baseMaxHz)
+        cfg.maxHz = maxHz;
+
+    auto maxRegs = params->getInt("hirate-max-regs", int(s_maxRegs));
+    if (maxRegs > 0)
+        cfg.maxRegs = (unsigned int)maxRegs;
+
+    auto packetMs = params->getInt("hirate-packet-ms", int(s_packetMs));
+    if (packetMs > 0)
+        cfg.packetMs = (unsigned int)packetMs;
+
+    auto packets = params->getInt("hirate-queue-packets", int(s_queuePackets));
+    if (packets > 0)
+        cfg.queuePackets = size_t(packets);
+
+    cfg.cpu = params->getInt("hirate-cpu", -1);
+    return cfg;
+}
+
+//-----------------------------------------------------------------------------
+
+std::list<Sampler::channel_t>::iterator Sampler::m_find(uint32_t & addr)
+{
+    for (auto it = m_channels.begin(); it != m_channels.end(); it++)
+    {
+        if (it->devInfo.first == addr)
+            return it;
+    }
+
+    return m_channels.end();
+}
+
+//-----------------------------------------------------------------------------
+
+void Sampler::m_setRate(channel_t & ch, timers::hz_t hz,
+                        timers::period_t period)
+{
+    ch.hz = m_timer.periodToHz(period);
+    ch.period = period;
+
+    // Количество отсчетов за время пачки, но не больше, чем помещается в пакет.
+    auto sampleSize = s_stampSize + ch.devInfo.second * sizeof(uint32_t);
+    auto batch = (unsigned int)llround(hz * m_cfg.packetMs / 1000.0);
+    auto maxBatch = (unsigned int)((s_maxPkgSize / 2) / sampleSize);
+    ch.batch = std::max(1u, std::min(batch, maxBatch));
+
+    // Заголовок пакета: адрес/количество регистров, частота, количество
+    // отсчетов и метка начала бинарных данных.
+    std::stringstream prefix;
+    prefix << "0x" << std::setfill('0') << std::setw(8) << std::hex
+           << ch.devInfo.first << sep::baseSep << std::dec << ch.devInfo.second
+           << sep::dataSep << ch.hz << sep::dataSep << ch.batch
+           << sep::dataSep << "BIN" << sep::dataSep;
+    ch.prefix = prefix.str();
+
+    // Накопленные с прежней частотой отсчеты отбрасываются.
+    ch.pending.clear();
+    ch.count = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+void Sampler::m_doSample(Sampler * sampler)
+{
+    while (sampler->m_activated.load())
+    {
+        // Заснуть до ближайшего срока считывания.
+        sampler->m_timer.sleep();
+        sampler->m_timer.popDue(sampler->m_due);
+        if (!sampler->m_due.size())
+            continue;
+
+        std::lock_guard<std::mutex> lock(sampler->m_mutex);
+        for (auto it = sampler->m_channels.begin();
+             it != sampler->m_channels.end(); it++)
+        {
+            auto & due = sampler->m_due;
+            if (std::find(due.begin(), due.end(), it->period) != due.end())
+                sampler->m_sample(*it);
+        }
+    }
+    sampler->log.trace(__FILE__, EP7TRACE_LEVEL_INFO, (tUINT16)__LINE__,
+                       __FUNCTION__, "High-rate sampling thread stopped");
+}
+
+//-----------------------------------------------------------------------------
+
+bool Sampler::m_start()
+{
+    // Поток уже запущен.
+    if (m_activated.load())
+        return true;
+
+    m_activated = true;
+    m_thread = std::thread(m_doSample, this);
+    if (!m_thread.joinable())
+    {
+        m_activated = false;
+        LOGGER_ERROR("Can't start high-rate sampling in thread");
+        return false;
+    }
+
+    // Закрепить поток за отдельным ядром.
+    if (m_cfg.cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(m_cfg.cpu, &set);
+
+        auto ret = pthread_setaffinity_np(m_thread.native_handle(),
+                                          sizeof(set), &set);
+        if (ret != 0)
+        {
+            std::stringstream msg;
+            msg << "Can't pin high-rate sampling to CPU " << m_cfg.cpu
+                << " (" << ret << ") : " << strerror(ret);
+            LOGGER_WARNING(msg.str());
+        }
+    }
+
+    LOGGER_INFO("High-rate sampling started in thread");
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Sampler::m_stop()
+{
+    m_activated = false;
+    m_timer.wake();
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+//-----------------------------------------------------------------------------
+
+void Sampler::m_sample(channel_t & ch)
+{
+    // Метка времени берется непосредственно перед чтением регистров.
+    auto stamp = timers::now();
+    if (!ch.dev->read(ch.region))
+        return;
+
+    if (!ch.count)
+        ch.pending.append(ch.prefix);
+
+    m_addStamp(stamp, ch.pending);
+    for (auto it = ch.region.begin(); it != ch.region.end(); it++)
+        m_addWord(it->second, ch.pending);
+
+    if (++ch.count == ch.batch)
+        m_publish(ch);
+}
+
+//-----------------------------------------------------------------------------
+
+void Sampler::m_publish(channel_t & ch)
+{
+    auto slot = m_ring.acquire();
+    // Поток отправки не успевает - пачка теряется.
+    if (!slot)
+    {
+        ch.drops += ch.count;
+        m_dropsTotal += ch.count;
+    }
+    else
+    {
+        slot->data.append(ch.pending.data(), ch.pending.size());
+        slot->type = ring::type_t::HIRATE;
+        slot->subs.push_back(ch.id);
+        m_ring.commit();
+    }
+
+    ch.pending.clear();
+    ch.count = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+void Sampler::m_addWord(uint32_t word, buffer::Buffer & data)
+{
+    char bytes[sizeof(word)];
+
+    for (unsigned int i = 0; i < sizeof(word); i++)
+        bytes[i] = char((word >> (8 * i)) & 0xff);
+
+    data.append(bytes, sizeof(bytes));
+}
+
+//-----------------------------------------------------------------------------
+
+void Sampler::m_addStamp(uint64_t stamp, buffer::Buffer & data)
+{
+    char bytes[sizeof(stamp)];
+
+    for (unsigned int i = 0; i < sizeof(stamp); i++)
+        bytes[i] = char((stamp >> (8 * i)) & 0xff);
+
+    data.append(bytes, sizeof(bytes));
+}
+
+//=============================================================================
+
+} // namespace hirate
@@ -0,0 +1,186 @@
+#ifndef HIRATE_H
+#define HIRATE_H
+
+//-----------------------------------------------------------------------------
+
+#include <list>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "device.h"
+#include "timers.h"
+#include "ring.h"
+#include "buffer.h"
+#include "logger-library/logger.h"
+
+//-----------------------------------------------------------------------------
+
+namespace hirate
+{
+
+//=============================================================================
+
+// Высокочастотное считывание небольших наборов регистров (выше 100 Гц).
+// Считывание выполняется отдельным потоком со своим планировщиком и своей
+// очередью пакетов, поэтому не влияет на сбор обычной статистики. Отсчеты
+// накапливаются пачкой (каждый со своей меткой времени) и публикуются одним
+// пакетом.
+class Sampler
+{
+public:
+
+    // Состояние канала для ответов пользователю.
+    typedef struct channelInfo
+    {
+        dev::devInfo_t devInfo;     // Базовый адрес и количество регистров.
+        timers::hz_t hz;            // Частота считывания.
+        unsigned int id;            // Идентификатор подписки.
+        uint64_t drops;             // Количество потерянных отсчетов.
+    } channelInfo_t;
+
+    //-------------------------------------------------------------------------
+
+    // eventFd - дескриптор eventfd, в который оповещается поток отправки.
+    Sampler(int eventFd);
+    ~Sampler();
+
+    //-------------------------------------------------------------------------
+
+    // Проверить относится ли частота к высокочастотному считыванию.
+    bool isHighRate(timers::hz_t hz);
+    // Добавить устройство для высокочастотного считывания (mapped - переданное
+    // каналу отображение, при ошибке остается у вызывающего).
+    bool add(dev::devInfo_t & devInfo, timers::hz_t hz, unsigned int id,
+             dev::Device * mapped = nullptr);
+    // Удалить устройство (info - состояние удаленного канала; если задан
+    // mapped, отображение передается вызывающему вместо удаления).
+    bool remove(uint32_t & addr, channelInfo_t & info,
+                dev::Device ** mapped = nullptr);
+    // Удалить все устройства (ids - идентификаторы подписок удаленных устройств).
+    void removeAll(std::vector<unsigned int> & ids);
+    // Изменить частоту считывания устройства (без повторного отображения).
+    bool mod(uint32_t & addr, timers::hz_t hz);
+    // Проверить считывается ли устройство.
+    bool isExist(uint32_t & addr);
+    // Получить состояние каналов.
+    void getChannels(std::vector<channelInfo_t> & channels);
+    // Получить общее количество потерянных отсчетов.
+    uint64_t getDrops();
+    // Получить точность пробуждений потока считывания.
+    timers::schedStat_t getSchedStat();
+
+    //-------------------------------------------------------------------------
+
+    // Получить до max самых старых пакетов (вызывается потоком отправки).
+    size_t peek(ring::pkg_t ** pkgs, size_t max);
+    // Освободить пакеты после отправки (вызывается потоком отправки).
+    void release(size_t count);
+    // Получить количество пакетов в очереди.
+    size_t size();
+
+private:
+
+    // Класс логирования.
+    logger::Logger log;
+
+    //-------------------------------------------------------------------------
+
+    // Параметры высокочастотного считывания.
+    typedef struct samplerCfg
+    {
+        timers::hz_t maxHz;     // Максимальная частота считывания.
+        unsigned int maxRegs;   // Максимальное количество регистров устройства.
+        unsigned int packetMs;  // Время, за которое отсчеты собираются в пакет.
+        size_t queuePackets;    // Количество пакетов в очереди.
+        int cpu;                // Ядро для закрепления потока (-1 - не закреплять).
+    } samplerCfg_t;
+
+    // Параметры по умолчанию.
+    static constexpr timers::hz_t s_maxHz = 10000;
+    static const unsigned int s_maxRegs = 16;
+    static const unsigned int s_packetMs = 10;
+    static const size_t s_queuePackets = 64;
+    // Частота, выше которой считывание становится высокочастотным.
+    static constexpr timers::hz_t s_baseMaxHz = 100;
+    // Максимальный размер пакета.
+    static const size_t s_maxPkgSize = 8192;
+    // Размер отсчета без регистров (метка времени).
+    static const size_t s_stampSize = sizeof(uint64_t);
+
+    // Прочитать параметры из конфигурационного файла.
+    samplerCfg_t m_readConfig();
+
+    // Параметры (читаются из конфигурационного файла).
+    samplerCfg_t m_cfg;
+
+    //-------------------------------------------------------------------------
+
+    // Канал высокочастотного считывания.
+    typedef struct channel
+    {
+        dev::devInfo_t devInfo;     // Базовый адрес и количество регистров.
+        dev::Device * dev;          // Отображенное устройство.
+        dev::region_t region;       // Регион устройства.
+        unsigned int id;            // Идентификатор подписки.
+        timers::hz_t hz;            // Частота считывания.
+        timers::period_t period;    // Период считывания.
+        unsigned int batch;         // Количество отсчетов в пакете.
+        unsigned int count;         // Количество накопленных отсчетов.
+        std::string prefix;         // Заголовок пакета канала.
+        buffer::Buffer pending;     // Накапливаемый пакет.
+        uint64_t drops;             // Количество потерянных отсчетов.
+    } channel_t;
+
+    // Каналы считывания.
+    std::list<channel_t> m_channels;
+    // Для работы с каналами.
+    std::mutex m_mutex;
+    // Общее количество потерянных отсчетов.
+    std::atomic<uint64_t> m_dropsTotal;
+
+    // Найти канал по адресу устройства.
+    std::list<channel_t>::iterator m_find(uint32_t & addr);
+    // Установить частоту считывания канала (пачка и заголовок пакета).
+    void m_setRate(channel_t & ch, timers::hz_t hz, timers::period_t period);
+
+    //-------------------------------------------------------------------------
+
+    // Очередь пакетов (поток считывания - производитель, поток отправки -
+    // потребитель).
+    ring::PkgRing m_ring;
+    // Планировщик сроков считывания.
+    timers::Scheduler m_timer;
+    // Периоды, сроки которых наступили в текущем пробуждении.
+    std::vector<timers::period_t> m_due;
+
+    //-------------------------------------------------------------------------
+
+    // Поток считывания.
+    std::thread m_thread;
+    // Переменная, обозначающая, что поток запущен.
+    std::atomic<bool> m_activated;
+    // Функция считывания.
+    static void m_doSample(Sampler * sampler);
+    // Запустить поток считывания.
+    bool m_start();
+    // Остановить поток считывания (вызывается без m_mutex).
+    void m_stop();
+
+    //-------------------------------------------------------------------------
+
+    // Считать отсчет канала и опубликовать пакет, если пачка собрана.
+    void m_sample(channel_t & ch);
+    // Опубликовать накопленный пакет канала.
+    void m_publish(channel_t & ch);
+    // Добавить 32-битное слово в порядке little-endian.
+    void m_addWord(uint32_t word, buffer::Buffer & data);
+    // Добавить метку времени (64 бита) в порядке little-endian.
+    void m_addStamp(uint64_t stamp, buffer::Buffer & data);
+};
+
+//=============================================================================
+
+} // namespace hirate
+
+#endif // HIRATE_H
@@ -19,27 +19,49 @@ logger.file                 = logger-library/logger.pro
 config.file                 = config-library/config.pro
 
 SOURCES += \
+    buffer.cpp \
+    column.cpp \
     common.cpp \
     core.cpp \
     devapi.cpp \
     device.cpp \
     devtree.cpp \
+    expr.cpp \
+    hgram.cpp \
+    hirate.cpp \
+    lod.cpp \
     main.cpp \
     protocol.cpp \
+    recorder.cpp \
+    ring.cpp \
+    sequence.cpp \
     statistic.cpp \
     timers.cpp \
-    udpserver.cpp
+    trigger.cpp \
+    udpserver.cpp \
+    workers.cpp
 
 HEADERS += \
+    buffer.h \
+    column.h \
     common.h \
     core.h \
     devapi.h \
     device.h \
     devtree.h \
+    expr.h \
+    hgram.h \
+    hirate.h \
+    lod.h \
     protocol.h \
+    recorder.h \
+    ring.h \
+    sequence.h \
     statistic.h \
     timers.h \
-    udpserver.h
+    trigger.h \
+    udpserver.h \
+    workers.h
 
 
 # LIBS += -L$$_PRO_FILE_PWD_/../libs -ldevice
@@ -54,5 +76,6 @@ INCLUDEPATH += $$_PRO_FILE_PWD_/../ ./logger-library/p7
 DISTFILES += \
     Makefile \
     build.ninja \
+    tools/recreader.cpp \
     app_dir/conf/logger.ini \
     app_dir/conf/tpoprotocol.ini
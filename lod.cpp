@@ -0,0 +1,329 @@
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <filesystem>
+#include <algorithm>
+#include <iomanip>
+
+#include "lod.h"
+
+//-----------------------------------------------------------------------------
+
+namespace lod
+{
+
+//=============================================================================
+
+Pyramid::Pyramid()
+{}
+
+//-----------------------------------------------------------------------------
+
+Pyramid::~Pyramid()
+{
+    close();
+}
+
+//-----------------------------------------------------------------------------
+
+bool Pyramid::open(const std::string & dir, uint64_t baseNs,
+                   unsigned int part)
+{
+    close();
+    m_dir = dir;
+
+    auto bucketNs = baseNs;
+    for (unsigned int i = 0; i < s_levels; i++, bucketNs *= s_factor)
+    {
+        auto fd = m_create(i, part, bucketNs);
+        if (fd == -1)
+        {
+            close();
+            return false;
+        }
+
+        m_levels.push_back({fd, sizeof(levelHeader_t), bucketNs, 0, {}, {}});
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Pyramid::rotate(unsigned int part)
+{
+    for (unsigned int i = 0; i < m_levels.size(); i++)
+    {
+        auto fd = m_create(i, part, m_levels[i].bucketNs);
+        if (fd == -1)
+        {
+            close();
+            return false;
+        }
+
+        ::close(m_levels[i].fd);
+        m_levels[i].fd = fd;
+        m_levels[i].bytes = sizeof(levelHeader_t);
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Pyramid::close()
+{
+    for (auto it = m_levels.begin(); it != m_levels.end(); it++)
+    {
+        m_flush(*it);
+        ::close(it->fd);
+    }
+
+    m_levels.clear();
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Pyramid::getBytes() const
+{
+    size_t bytes = 0;
+    for (auto it = m_levels.begin(); it != m_levels.end(); it++)
+        bytes += it->bytes;
+
+    return bytes;
+}
+
+//-----------------------------------------------------------------------------
+
+void Pyramid::remove(const std::string & dir, unsigned int part)
+{
+    for (unsigned int i = 0; i < s_levels; i++)
+        unlink(m_getPath(dir, i, part).c_str());
+}
+
+//-----------------------------------------------------------------------------
+
+void Pyramid::add(uint64_t stamp, uint32_t addr, uint32_t value)
+{
+    for (auto it = m_levels.begin(); it != m_levels.end(); it++)
+    {
+        // Начался новый интервал - сбросить все регистры уровня.
+        auto bucket = stamp / it->bucketNs;
+        if (bucket > it->current)
+        {
+            m_flush(*it);
+            it->current = bucket;
+        }
+
+        auto & acc = it->accums[addr];
+        if (!acc.count)
+        {
+            acc.min = value;
+            acc.max = value;
+            acc.sum = 0;
+        }
+
+        acc.count++;
+        acc.min = std::min(acc.min, value);
+        acc.max = std::max(acc.max, value);
+        acc.sum += value;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool Pyramid::query(const std::string & dir, uint32_t addr, uint64_t from,
+                    uint64_t to, size_t points, unsigned int & level,
+                    uint64_t & bucketNs, std::vector<bucket_t> & buckets)
+{
+    if (to < from || !points)
+        return false;
+
+    auto parts = m_getParts(dir);
+    if (!parts.size())
+        return false;
+
+    // Выбрать уровень по длительностям интервалов из заголовков файлов
+    // первой части.
+    bool found = false;
+    for (unsigned int i = 0; i < s_levels; i++)
+    {
+        auto fd = ::open(m_getPath(dir, i, parts.front()).c_str(),
+                         O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            break;
+
+        levelHeader_t header;
+        auto ret = read(fd, &header, sizeof(header));
+        ::close(fd);
+        if (ret != sizeof(header) || header.magic != s_magic ||
+            !header.bucketNs)
+            break;
+
+        found = true;
+        level = i;
+        bucketNs = header.bucketNs;
+
+        if ((to - from) / bucketNs + 1 <= points)
+            break;
+    }
+
+    if (!found)
+        return false;
+
+    // Части читаются по порядку, начиная с интервала, в который попадает from.
+    auto first = from / bucketNs * bucketNs;
+    bool done = false;
+    for (auto it = parts.begin(); it != parts.end() && !done; it++)
+    {
+        auto fd = ::open(m_getPath(dir, level, *it).c_str(),
+                         O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            continue;
+
+        done = m_readPart(fd, addr, first, to, points, buckets);
+        ::close(fd);
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+std::string Pyramid::m_getPath(const std::string & dir, unsigned int level,
+                               unsigned int part)
+{
+    std::stringstream path;
+    path << dir << "/" << std::setfill('0') << std::setw(6) << part << ".lod"
+         << level;
+    return path.str();
+}
+
+//-----------------------------------------------------------------------------
+
+std::vector<unsigned int> Pyramid::m_getParts(const std::string & dir)
+{
+    std::vector<unsigned int> parts;
+
+    // Номера частей берутся по файлам уровня 0.
+    std::error_code err;
+    for (const auto & entry : std::filesystem::directory_iterator(dir, err))
+    {
+        auto file = entry.path();
+        auto stem = file.stem().string();
+        if (file.extension() != ".lod0" || !stem.size() ||
+            !std::all_of(stem.begin(), stem.end(), ::isdigit))
+            continue;
+
+        parts.push_back((unsigned int)std::stoul(stem));
+    }
+
+    std::sort(parts.begin(), parts.end());
+    return parts;
+}
+
+//-----------------------------------------------------------------------------
+
+int Pyramid::m_create(unsigned int level, unsigned int part, uint64_t bucketNs)
+{
+    auto path = m_getPath(m_dir, level, part);
+    auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                     0644);
+    levelHeader_t header {s_magic, level, bucketNs, {0, 0}};
+    if (fd == -1 || write(fd, &header, sizeof(header)) != sizeof(header))
+    {
+        std::stringstream msg;
+        msg << "Can't create level file " << path << " (" << errno
+            << ") : " << strerror(errno);
+        LOGGER_ERROR(msg.str());
+
+        if (fd != -1)
+            ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Pyramid::m_readPart(int fd, uint32_t addr, uint64_t first, uint64_t to,
+                         size_t points, std::vector<bucket_t> & buckets)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(levelHeader_t))
+        return false;
+
+    // Двоичный поиск первой записи с началом интервала не раньше first.
+    size_t low = 0;
+    size_t high = (size_t(st.st_size) - sizeof(levelHeader_t)) / sizeof(bucket_t);
+    while (low < high)
+    {
+        auto mid = low + (high - low) / 2;
+        bucket_t bucket;
+        auto offset = off_t(sizeof(levelHeader_t) + mid * sizeof(bucket_t));
+        if (pread(fd, &bucket, sizeof(bucket), offset) != sizeof(bucket))
+            break;
+
+        if (bucket.start < first)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    // Читать блоками до конца диапазона.
+    static const size_t blockSize = 256;
+    bucket_t block[blockSize];
+    auto offset = off_t(sizeof(levelHeader_t) + low * sizeof(bucket_t));
+    bool done = false;
+    while (!done)
+    {
+        auto ret = pread(fd, block, sizeof(block), offset);
+        if (ret < ssize_t(sizeof(bucket_t)))
+            break;
+
+        auto count = size_t(ret) / sizeof(bucket_t);
+        offset += off_t(count * sizeof(bucket_t));
+        for (size_t i = 0; i < count && !done; i++)
+        {
+            done = block[i].start > to || buckets.size() == points;
+            if (!done && block[i].addr == addr)
+                buckets.push_back(block[i]);
+        }
+    }
+
+    return done;
+}
+
+//-----------------------------------------------------------------------------
+
+void Pyramid::m_flush(level_t & level)
+{
+    level.pending.clear();
+    for (auto it = level.accums.begin(); it != level.accums.end(); it++)
+    {
+        auto & acc = it->second;
+        if (!acc.count)
+            continue;
+
+        level.pending.push_back({level.current * level.bucketNs, it->first,
+                                 acc.count, acc.min, acc.max,
+                                 acc.sum / acc.count});
+        acc.count = 0;
+    }
+
+    if (!level.pending.size())
+        return;
+
+    auto size = level.pending.size() * sizeof(bucket_t);
+    if (write(level.fd, level.pending.data(), size) != ssize_t(size))
+        LOGGER_WARNING("Can't write level of detail");
+    else
+        level.bytes += size;
+}
+
+//=============================================================================
+
+} // namespace lod
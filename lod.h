@@ -0,0 +1,141 @@
+#ifndef LOD_H
+#define LOD_H
+
+//-----------------------------------------------------------------------------
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "logger-library/logger.h"
+
+//-----------------------------------------------------------------------------
+
+namespace lod
+{
+
+//=============================================================================
+
+// Интервал уровня пирамиды для одного регистра (запись файла уровня).
+typedef struct bucket
+{
+    uint64_t start;     // Начало интервала (нс, CLOCK_MONOTONIC).
+    uint32_t addr;      // Адрес регистра.
+    uint32_t count;     // Количество значений в интервале.
+    uint32_t min;       // Минимальное значение.
+    uint32_t max;       // Максимальное значение.
+    double mean;        // Среднее значение.
+} bucket_t;
+
+// Заголовок файла уровня (размером с запись, чтобы записи шли с шагом).
+typedef struct levelHeader
+{
+    uint32_t magic;     // Признак файла уровня.
+    uint32_t level;     // Номер уровня.
+    uint64_t bucketNs;  // Длительность интервала уровня.
+    uint64_t reserved[2];
+} levelHeader_t;
+
+//-----------------------------------------------------------------------------
+
+// Пирамида уровней детализации записи: для каждого регистра на каждом уровне
+// хранятся минимум, максимум и среднее за интервалы, которые на каждом
+// следующем уровне в s_factor раз длиннее. Уровни строятся по мере записи
+// и хранятся в отдельных файлах каталога записи, поэтому обзор длинной записи
+// не требует чтения всех пакетов. Записи файла уровня упорядочены по началу
+// интервала (все регистры уровня сбрасываются вместе при смене интервала).
+// Файлы уровней делятся на части по номерам сегментов записи, чтобы вместе
+// со старым сегментом удалялись и интервалы уровней за его время.
+class Pyramid
+{
+public:
+
+    Pyramid();
+    ~Pyramid();
+
+    //-------------------------------------------------------------------------
+
+    // Количество уровней.
+    static const unsigned int s_levels = 6;
+    // Во сколько раз интервал уровня длиннее интервала предыдущего уровня.
+    static const unsigned int s_factor = 4;
+
+    //-------------------------------------------------------------------------
+
+    // Создать файлы уровней части part в каталоге записи (baseNs - интервал
+    // уровня 0).
+    bool open(const std::string & dir, uint64_t baseNs, unsigned int part);
+    // Продолжить запись уровней в файлы новой части (незавершенные интервалы
+    // сохраняются; false - файлы не созданы, пирамида закрыта).
+    bool rotate(unsigned int part);
+    // Сбросить незавершенные интервалы и закрыть файлы.
+    void close();
+    // Получить размер файлов текущей части.
+    size_t getBytes() const;
+    // Удалить файлы уровней части part.
+    static void remove(const std::string & dir, unsigned int part);
+    // Добавить значение регистра.
+    void add(uint64_t stamp, uint32_t addr, uint32_t value);
+    // Выбрать самый детальный уровень, на котором диапазон [from, to]
+    // укладывается в points интервалов (иначе самый грубый), и прочитать
+    // интервалы регистра addr этого уровня.
+    static bool query(const std::string & dir, uint32_t addr, uint64_t from,
+                      uint64_t to, size_t points, unsigned int & level,
+                      uint64_t & bucketNs, std::vector<bucket_t> & buckets);
+
+private:
+
+    // Класс логирования.
+    logger::Logger log;
+
+    //-------------------------------------------------------------------------
+
+    // Признак файла уровня ("LOD0").
+    static const uint32_t s_magic = 0x30444f4c;
+
+    // Накопленные за текущий интервал значения регистра.
+    typedef struct accum
+    {
+        uint32_t count;
+        uint32_t min;
+        uint32_t max;
+        double sum;
+    } accum_t;
+
+    // Уровень пирамиды.
+    typedef struct level
+    {
+        int fd;                             // Дескриптор файла уровня.
+        size_t bytes;                       // Размер файла текущей части.
+        uint64_t bucketNs;                  // Длительность интервала.
+        uint64_t current;                   // Номер текущего интервала.
+        std::map<uint32_t, accum_t> accums; // Накопленные значения по адресам.
+        std::vector<bucket_t> pending;      // Интервалы для записи в файл.
+    } level_t;
+
+    // Уровни пирамиды.
+    std::vector<level_t> m_levels;
+    // Каталог записи.
+    std::string m_dir;
+
+    // Получить путь к файлу уровня части.
+    static std::string m_getPath(const std::string & dir, unsigned int level,
+                                 unsigned int part);
+    // Получить номера частей в порядке возрастания.
+    static std::vector<unsigned int> m_getParts(const std::string & dir);
+    // Создать файл уровня части с заголовком (-1 - не удалось).
+    int m_create(unsigned int level, unsigned int part, uint64_t bucketNs);
+    // Прочитать интервалы регистра addr части, начиная с интервала first
+    // (true - диапазон или количество точек исчерпаны).
+    static bool m_readPart(int fd, uint32_t addr, uint64_t first, uint64_t to,
+                           size_t points, std::vector<bucket_t> & buckets);
+    // Записать накопленные интервалы уровня в файл.
+    void m_flush(level_t & level);
+};
+
+//=============================================================================
+
+} // namespace lod
+
+#endif // LOD_H
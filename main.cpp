@@ -2,6 +2,9 @@
 
 int main()
 {
+    // Сигналы завершения принимает только основной поток.
+    core::Core::blockSignals();
+
     core::Core core;
     core.start();
 
@@ -1,5 +1,7 @@
 #include <algorithm>
 #include <cstring>
+#include <cstdlib>
+#include <cmath>
 #include <iostream>
 #include <sys/wait.h>
 #include <algorithm>
@@ -29,11 +31,68 @@ void TpoProtocol::init()
 
 //-----------------------------------------------------------------------------
 
+void TpoProtocol::stop()
+{
+    m_udp.stop();
+}
+
+//-----------------------------------------------------------------------------
+
 void TpoProtocol::sendStatistic(std::stringstream & data)
 {
     auto header = status["GET"];
     auto pkg = header + data.str();
-    m_sendPkg(const_cast<char*>(pkg.c_str()));
+    m_sendPkg(pkg);
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::sendStatistic(ring::pkg_t ** pkgs, size_t count)
+{
+    m_parts.resize(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // Заголовок зависит от типа пакета.
+        auto & header = m_getHeader(pkgs[i]->type);
+
+        // Заголовок и данные отправляются одним пакетом без копирования.
+        m_parts[i].head = reinterpret_cast<const byte_t *>(header.data());
+        m_parts[i].headSize = header.size();
+        m_parts[i].buf = reinterpret_cast<const byte_t *>(pkgs[i]->data.data());
+        m_parts[i].size = pkgs[i]->data.size();
+    }
+
+    m_udp.sendData(m_parts.data(), count);
+}
+
+//-----------------------------------------------------------------------------
+
+std::string & TpoProtocol::m_getHeader(ring::type_t type)
+{
+    switch (type)
+    {
+        case ring::type_t::MERGED:
+            return status["MERGED"];
+        case ring::type_t::HIRATE:
+            return status["HIRATE"];
+        case ring::type_t::AGG:
+            return status["AGG"];
+        case ring::type_t::EVENT:
+            return status["EVENT"];
+        case ring::type_t::CAPTURE:
+            return status["CAPTURE"];
+        case ring::type_t::RECORD:
+            return status["RECORD"];
+        case ring::type_t::HGRAM:
+            return status["HGRAM"];
+        case ring::type_t::DERIVED:
+            return status["DERIVED"];
+        case ring::type_t::FRAME:
+            return status["FRAME"];
+        default:
+            return status["GET"];
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -45,6 +104,13 @@ void TpoProtocol::setPointerToStatistic(statistic::Statistic * stat)
 
 //-----------------------------------------------------------------------------
 
+void TpoProtocol::setPointerToSequencer(sequence::Sequencer * seq)
+{
+    m_sequencer = seq;
+}
+
+//-----------------------------------------------------------------------------
+
 bool TpoProtocol::waitForCommand()
 {
     auto data = m_pkg.data();
@@ -54,6 +120,9 @@ bool TpoProtocol::waitForCommand()
     // Вернулся из-за Keep-Alive.
     if (ret == -1)
         return false;
+    // Пустой пакет (или сервер остановлен).
+    if (!size)
+        return true;
 
     // Преобразовать пакет в сообщение.
     m_msg = std::string(m_pkg.begin(), m_pkg.end());
@@ -68,6 +137,9 @@ bool TpoProtocol::waitForCommand()
 
 void TpoProtocol::m_parsePkg()
 {
+    // Бинарные данные не должны проходить через удаление пробелов и переносов.
+    m_splitPayload();
+
     // Удалить все пробелы из сообщения.
     m_msg.erase(remove(m_msg.begin(), m_msg.end(), ' '), m_msg.end());
     // Удалить все переносы новой строки из сообщения.
@@ -160,10 +232,48 @@ void TpoProtocol::m_handleDel()
 
 //-----------------------------------------------------------------------------
 
+void TpoProtocol::m_handleMod()
+{
+    auto data = splitString(m_body, sep::dataSep);
+
+    // Запрос состоит из пар: устройство/API и новая частота считывания.
+    if (!data.size() || data.size() % 2)
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    jobData_t tmp;
+    for (unsigned long i = 0; i < data.size(); i+=2)
+    {
+        tmp = m_modJob(data[i], data[i+1]);
+        // Если произошла ошибка при обработке работы.
+        if (m_jobError)
+        {
+            m_sendBadCmd();
+            continue;
+        }
+
+        if (tmp.device) // Перенести устройство.
+            m_modDev(tmp);
+        else            // Перенести файл API.
+            m_modFile(tmp);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
 void TpoProtocol::m_handleSet()
 {
     auto data = splitString(m_body, sep::dataSep);
 
+    // Запись в регистр по маске: set,<адрес>,<значение>,<маска>.
+    if (m_isSetMaskRequest(data))
+    {
+        m_handleSetMask(data);
+        return;
+    }
+
     // Проверить правильность команды SET.
     if (!m_isSetRequestCorrect(data))
     {
@@ -191,6 +301,56 @@ void TpoProtocol::m_handleSet()
 
 //-----------------------------------------------------------------------------
 
+void TpoProtocol::m_handleSetMask(std::vector<std::string> & request)
+{
+    // Запрос состоит из троек: адрес, значение, маска.
+    if (!request.size() || request.size() % 3)
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    jobData_t tmp;
+    for (unsigned long i = 0; i < request.size(); i+=3)
+    {
+        tmp = m_setMaskJob(request[i], request[i+1], request[i+2]);
+        // Если произошла ошибка при обработке работы.
+        if (m_jobError)
+        {
+            m_sendBadCmd();
+            continue;
+        }
+
+        m_setDevMask(tmp);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_handleSetBlk()
+{
+    auto data = splitString(m_body, sep::dataSep);
+
+    // Нужен адрес и хотя бы одно значение (или метка бинарных данных).
+    if (data.size() < 2)
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    auto tmp = m_setBlkJob(data);
+    // Если произошла ошибка при обработке работы.
+    if (m_jobError)
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    m_setDevBlk(tmp);
+}
+
+//-----------------------------------------------------------------------------
+
 void TpoProtocol::m_handleDtb()
 {
     // Если запрашивается дерево устройств целиком.
@@ -224,6 +384,543 @@ void TpoProtocol::m_handleStop()
 
 //-----------------------------------------------------------------------------
 
+void TpoProtocol::m_handleFmt()
+{
+    // Если запрос FMT без параметров - отправить текущий формат.
+    if (!m_body.size())
+    {
+        m_sendFormat();
+        return;
+    }
+
+    auto fmt = m_statistic->getFormat();
+    auto enc = m_statistic->getEncoding();
+    auto frm = m_statistic->getFraming();
+
+    // Формат, кодирование и передачу можно указывать в любом порядке.
+    auto data = splitString(m_body, sep::dataSep);
+    for (auto it = data.begin(); it != data.end(); it++)
+    {
+        std::transform(it->begin(), it->end(), it->begin(),
+                       [](unsigned char c){ return std::tolower(c); });
+
+        if (format.find(*it) != format.end())
+        {
+            fmt = format[*it];
+        }
+        else if (encoding.find(*it) != encoding.end())
+        {
+            enc = encoding[*it];
+        }
+        else if (framing.find(*it) != framing.end())
+        {
+            frm = framing[*it];
+        }
+        else
+        {
+            m_sendBadCmd();
+            return;
+        }
+    }
+
+    m_statistic->setFormat(fmt, enc, frm);
+    m_sendFormat();
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_handleSeq()
+{
+    auto data = splitString(m_body, sep::dataSep);
+    sequence::steps_t steps;
+
+    // Проверить правильность команды SEQ.
+    if (!m_seqJob(data, steps) || !m_sequencer->isValid(steps))
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    // Проверить наличие всех регистров в дереве устройств.
+    for (auto it = steps.begin(); it != steps.end(); it++)
+    {
+        if (it->type == sequence::step_t::WAIT)
+            continue;
+
+        dev::devInfo_t devInfo {it->addr, 1};
+        if (!m_checkDev(devInfo))
+        {
+            jobData_t tmp;
+            tmp.device = true;
+            tmp.addr = it->addr;
+            m_sendNotExist(tmp);
+            return;
+        }
+    }
+
+    // Выполнить последовательность (результаты отправляются и при прерывании).
+    sequence::results_t results;
+    if (!m_sequencer->run(steps, results))
+        LOGGER_WARNING("Sequence was interrupted");
+
+    m_sendSequence(steps, results);
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_handleQueue()
+{
+    // Команда QUEUE не имеет параметров.
+    if (m_body.size())
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    std::stringstream pkg;
+    m_statistic->getQueueInfo(pkg);
+
+    m_response = status["QUEUE"];
+    m_response += pkg.str();
+    m_sendResponse();
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_handleSched()
+{
+    // Команда SCHED не имеет параметров.
+    if (m_body.size())
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    std::stringstream pkg;
+    m_statistic->getSchedInfo(pkg);
+
+    m_response = status["SCHED"];
+    m_response += pkg.str();
+    m_sendResponse();
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_handleTrig()
+{
+    // Если запрос TRIG без параметров - отправить список триггеров.
+    if (!m_body.size())
+    {
+        std::stringstream pkg;
+        m_statistic->getTriggers(pkg);
+
+        m_response = status["TRIGGER"];
+        m_response += pkg.str();
+        m_sendResponse();
+        return;
+    }
+
+    auto data = splitString(m_body, sep::dataSep);
+
+    // Удалить триггеры по идентификаторам.
+    if (data[0] == "del")
+    {
+        if (data.size() < 2)
+        {
+            m_sendBadCmd();
+            return;
+        }
+
+        for (size_t i = 1; i < data.size(); i++)
+        {
+            if (!data[i].size() || data[i].size() > 9 ||
+                !std::all_of(data[i].begin(), data[i].end(), ::isdigit))
+            {
+                m_sendBadCmd();
+                continue;
+            }
+
+            auto deleted = m_statistic->delTrigger(std::stoul(data[i]));
+            m_response = status[deleted ? "DELETED" : "NOT_ACTIVE"];
+            m_response += data[i];
+            m_sendResponse();
+        }
+        return;
+    }
+
+    // Запрос состоит из пар: регистр/API и условие триггера.
+    if (data.size() % 2)
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    for (size_t i = 0; i < data.size(); i += 2)
+    {
+        auto tmp = m_delJob(data[i]);
+        trig::params_t params;
+        if (m_jobError || !m_getTrigger(data[i + 1], params))
+        {
+            m_sendBadCmd();
+            continue;
+        }
+
+        // Триггер добавляется только на считываемые регистры и файлы API.
+        unsigned int id;
+        bool added;
+        if (tmp.device)
+        {
+            added = m_statistic->addTrigger(tmp.addr, params, id);
+        }
+        else
+        {
+            auto apiName = std::string(tmp.dtbDev) + "/" + tmp.apiName;
+            auto fullPath = m_devTree.getApiPath(apiName);
+            dev::file_t fileInfo {fullPath, apiName};
+            added = m_statistic->addTrigger(fileInfo, params, id);
+        }
+
+        if (!added)
+        {
+            m_sendNotActive(tmp);
+            continue;
+        }
+
+        m_response = status["TRIGGER"];
+        m_response += std::to_string(id) + sep::dataSep + data[i] +
+                      sep::dataSep + data[i + 1];
+        m_sendResponse();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_handleHistory()
+{
+    auto data = splitString(m_body, sep::dataSep);
+    // Устройство и, возможно, диапазон.
+    if (!m_body.size() || data.size() > 2)
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    jobData_t tmp = m_delJob(data[0]);
+    if (m_jobError || !tmp.device)
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    // Без диапазона - состояние истории.
+    if (data.size() == 1)
+    {
+        std::stringstream pkg;
+        if (!m_statistic->getHistoryInfo(tmp.addr, pkg))
+        {
+            m_sendNotActive(tmp);
+            return;
+        }
+
+        m_response = status["HISTORY"];
+        m_response += pkg.str();
+        m_sendResponse();
+        return;
+    }
+
+    // Диапазон номеров отсчетов (seq=от/до) или меток времени (t=от/до),
+    // верхняя граница может быть не указана.
+    auto range = splitString(data[1], sep::valSep);
+    std::vector<std::string> bounds;
+    if (range.size() == 2)
+        bounds = splitString(range[1], sep::baseSep);
+
+    bool correct = (range.size() == 2) && (range[0] == "seq" || range[0] == "t") &&
+                   bounds.size() >= 1 && bounds.size() <= 2;
+    for (auto it = bounds.begin(); correct && it != bounds.end(); it++)
+    {
+        correct = it->size() && it->size() < 20 &&
+                  std::all_of(it->begin(), it->end(), ::isdigit);
+    }
+
+    if (!correct)
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    uint64_t from = std::stoull(bounds[0]);
+    uint64_t to = bounds.size() == 2 ? std::stoull(bounds[1]) : UINT64_MAX;
+    std::vector<std::string> chunks;
+    if (!m_statistic->getHistory(tmp.addr, range[0] == "t", from, to, chunks))
+    {
+        m_sendNotActive(tmp);
+        return;
+    }
+
+    for (auto it = chunks.begin(); it != chunks.end(); it++)
+    {
+        m_response = status["HISTORY"];
+        m_response += *it;
+        m_sendResponse();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_handleRecord()
+{
+    // Если запрос RECORD без параметров - отправить список записей.
+    if (!m_body.size())
+    {
+        std::stringstream pkg;
+        m_statistic->getRecords(pkg);
+
+        m_response = status["RECORD"];
+        m_response += pkg.str();
+        m_sendResponse();
+        return;
+    }
+
+    auto data = splitString(m_body, sep::dataSep);
+    auto & action = data[0];
+
+    // Начало записи: имя и, возможно, формат (packets или columns).
+    if (action == "start" && (data.size() == 2 || data.size() == 3))
+    {
+        bool columnar = data.size() == 3 && data[2] == "columns";
+        if (!rec::Recorder::isValidName(data[1]) ||
+            (data.size() == 3 && !columnar && data[2] != "packets"))
+        {
+            m_sendBadCmd();
+            return;
+        }
+
+        if (!m_statistic->startRecord(data[1], columnar))
+        {
+            m_response = status["ERROR"];
+            m_response += m_body;
+            m_sendResponse();
+            return;
+        }
+
+        m_response = status["RECORD"];
+        m_response += "STARTED" + std::string(1, sep::dataSep) + data[1];
+        m_sendResponse();
+    }
+    else if (action == "stop" && data.size() == 1)
+    {
+        std::stringstream info;
+        if (!m_statistic->stopRecord(info))
+        {
+            m_response = status["NOT_ACTIVE"];
+            m_response += m_body;
+            m_sendResponse();
+            return;
+        }
+
+        m_response = status["RECORD"];
+        m_response += "STOPPED" + std::string(1, sep::dataSep) + info.str();
+        m_sendResponse();
+    }
+    // Воспроизведение: имя записи, скорость (1 - исходные интервалы, max -
+    // максимальная) и, возможно, метка времени начала.
+    else if (action == "replay" && (data.size() == 3 || data.size() == 4))
+    {
+        auto & from = data.size() == 4 ? data[3] : data[2];
+        bool correct = rec::Recorder::isValidName(data[1]) &&
+                       (data[2] == "1" || data[2] == "max") &&
+                       (data.size() == 3 || (from.size() && from.size() < 20 &&
+                        std::all_of(from.begin(), from.end(), ::isdigit)));
+        if (!correct)
+        {
+            m_sendBadCmd();
+            return;
+        }
+
+        auto stamp = data.size() == 4 ? std::stoull(from) : 0;
+        if (!m_statistic->replayRecord(data[1], data[2] == "1", stamp))
+        {
+            m_response = status["ERROR"];
+            m_response += m_body;
+            m_sendResponse();
+            return;
+        }
+
+        m_response = status["RECORD"];
+        m_response += "REPLAY" + std::string(1, sep::dataSep) + data[1];
+        m_sendResponse();
+    }
+    // Обзор записи: имя, регистр, диапазон меток времени и количество точек.
+    else if (action == "lod" && data.size() == 6)
+    {
+        jobData_t tmp = m_delJob(data[2]);
+        bool correct = !m_jobError && tmp.device &&
+                       rec::Recorder::isValidName(data[1]);
+        for (size_t i = 3; correct && i < data.size(); i++)
+        {
+            correct = data[i].size() && data[i].size() < 20 &&
+                      std::all_of(data[i].begin(), data[i].end(), ::isdigit);
+        }
+
+        if (!correct)
+        {
+            m_sendBadCmd();
+            return;
+        }
+
+        auto points = std::stoull(data[5]);
+        if (!points || points > s_maxLodPoints)
+        {
+            m_sendBadCmd();
+            return;
+        }
+
+        std::vector<std::string> chunks;
+        if (!m_statistic->getRecordLod(data[1], tmp.addr, std::stoull(data[3]),
+                                       std::stoull(data[4]), points, chunks))
+        {
+            m_response = status["NOT_EXIST"];
+            m_response += data[1];
+            m_sendResponse();
+            return;
+        }
+
+        for (auto it = chunks.begin(); it != chunks.end(); it++)
+        {
+            m_response = status["RECORD"];
+            m_response += *it;
+            m_sendResponse();
+        }
+    }
+    else if (action == "cancel" && data.size() == 1)
+    {
+        if (!m_statistic->stopReplay())
+        {
+            m_response = status["NOT_ACTIVE"];
+            m_response += m_body;
+            m_sendResponse();
+            return;
+        }
+
+        m_response = status["RECORD"];
+        m_response += "CANCELED";
+        m_sendResponse();
+    }
+    else
+    {
+        m_sendBadCmd();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_handleDerive()
+{
+    // Если запрос DERIVE без параметров - отправить список каналов.
+    if (!m_body.size())
+    {
+        std::stringstream pkg;
+        m_statistic->getDerived(pkg);
+
+        m_response = status["DERIVE"];
+        m_response += pkg.str();
+        m_sendResponse();
+        return;
+    }
+
+    auto data = splitString(m_body, sep::dataSep);
+    if (data.size() != 2)
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    // Удалить канал по имени.
+    if (data[0] == "del")
+    {
+        auto deleted = m_statistic->delDerived(data[1]);
+        m_response = status[deleted ? "DELETED" : "NOT_ACTIVE"];
+        m_response += data[1];
+        m_sendResponse();
+        return;
+    }
+
+    // Добавить канал: имя и выражение.
+    std::string error;
+    if (!m_statistic->addDerived(data[0], data[1], error))
+    {
+        std::stringstream msg;
+        msg << "Derived channel \"" << data[0] << "\" isn't added: " << error;
+        LOGGER_ERROR(msg.str());
+        m_sendBadCmd();
+        return;
+    }
+
+    m_response = status["DERIVE"];
+    m_response += data[0] + sep::dataSep + data[1];
+    m_sendResponse();
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_handleBurst()
+{
+    // Устройство с количеством регистров и количество считываний.
+    auto data = splitString(m_body, sep::dataSep);
+    if (data.size() != 2 || data[0].find('@') != std::string::npos ||
+        !data[1].size() || data[1].size() > 9 ||
+        !std::all_of(data[1].begin(), data[1].end(), ::isdigit))
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    auto tmp = jobData_t();
+    auto base = splitString(data[0], sep::baseSep);
+    if (base.size() == 2)
+    {
+        tmp.device = true;
+        tmp.addr = m_getDevAddr(base[0]);
+        if (!m_jobError)
+            tmp.regCnt = m_getRegCnt(base[1]);
+    }
+
+    // Отсчеты пачки хранятся в памяти целиком, поэтому их размер ограничен.
+    auto count = (unsigned int)std::stoul(data[1]);
+    auto sampleSize = sizeof(uint64_t) + tmp.regCnt * sizeof(uint32_t);
+    if (m_jobError || base.size() != 2 || !tmp.regCnt || !count ||
+        count > s_maxBurstBytes / sampleSize)
+    {
+        m_sendBadCmd();
+        return;
+    }
+
+    dev::devInfo_t devInfo {tmp.addr, tmp.regCnt};
+    if (!m_checkDev(devInfo))
+    {
+        m_sendNotExist(tmp);
+        return;
+    }
+
+    if (!m_statistic->readBurst(devInfo, count, m_burstReply, m_burstEnds))
+    {
+        m_sendError(tmp);
+        return;
+    }
+
+    size_t begin = 0;
+    for (auto it = m_burstEnds.begin(); it != m_burstEnds.end(); it++)
+    {
+        m_response = status["BURST"];
+        m_response.append(m_burstReply.data() + begin, *it - begin);
+        m_sendResponse();
+        begin = *it;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
 void TpoProtocol::m_handleKA()
 {
     LOGGER_INFO("Keep-Alive");
@@ -260,11 +957,27 @@ void TpoProtocol::m_parseCmd()
     {
         m_handleDel();
     }
+    // Изменить частоту сбора статистики для устройств(a)/API.
+    if (m_cmd == "mod")
+    {
+        m_handleMod();
+    }
     // Записать значение в устройство(a)/API.
     if (m_cmd == "set")
     {
         m_handleSet();
     }
+    // Записать массив значений в последовательные регистры.
+    if (m_cmd == "setblk")
+    {
+        m_handleSetBlk();
+    }
+    // Записать значения по маске в регистры.
+    if (m_cmd == "setm")
+    {
+        auto data = splitString(m_body, sep::dataSep);
+        m_handleSetMask(data);
+    }
     // Получить устройства в дереве устройств.
     if (m_cmd == "dtb")
     {
@@ -275,6 +988,51 @@ void TpoProtocol::m_parseCmd()
     {
         m_handleStop();
     }
+    // Выбрать формат записи данных устройств.
+    if (m_cmd == "fmt")
+    {
+        m_handleFmt();
+    }
+    // Выполнить последовательность команд на блоке.
+    if (m_cmd == "seq")
+    {
+        m_handleSeq();
+    }
+    // Получить состояние очереди пакетов со статистикой.
+    if (m_cmd == "queue")
+    {
+        m_handleQueue();
+    }
+    // Получить точность пробуждений планировщика.
+    if (m_cmd == "sched")
+    {
+        m_handleSched();
+    }
+    // Добавить/удалить триггеры или получить их список.
+    if (m_cmd == "trig")
+    {
+        m_handleTrig();
+    }
+    // Получить отсчеты из истории устройства.
+    if (m_cmd == "history")
+    {
+        m_handleHistory();
+    }
+    // Запись пакетов на накопитель и воспроизведение.
+    if (m_cmd == "record")
+    {
+        m_handleRecord();
+    }
+    // Добавить/удалить производные каналы или получить их список.
+    if (m_cmd == "derive")
+    {
+        m_handleDerive();
+    }
+    // Прочитать устройство пачкой считываний без пауз.
+    if (m_cmd == "burst")
+    {
+        m_handleBurst();
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -300,6 +1058,70 @@ void TpoProtocol::m_sendActive()
 
 //-----------------------------------------------------------------------------
 
+void TpoProtocol::m_sendFormat()
+{
+    m_response = status["FORMAT"];
+
+    auto fmt = m_statistic->getFormat();
+    for (auto it = format.begin(); it != format.end(); it++)
+    {
+        if (it->second == fmt)
+            m_response += it->first;
+    }
+
+    m_response += sep::dataSep;
+
+    auto enc = m_statistic->getEncoding();
+    for (auto it = encoding.begin(); it != encoding.end(); it++)
+    {
+        if (it->second == enc)
+            m_response += it->first;
+    }
+
+    m_response += sep::dataSep;
+
+    auto frm = m_statistic->getFraming();
+    for (auto it = framing.begin(); it != framing.end(); it++)
+    {
+        if (it->second == frm)
+            m_response += it->first;
+    }
+
+    m_sendResponse();
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_sendSequence(sequence::steps_t & steps,
+                                 sequence::results_t & results)
+{
+    std::stringstream pkg;
+
+    // Количество выполненных шагов из общего количества.
+    pkg << std::dec << results.size() << sep::baseSep << steps.size();
+
+    for (auto it = results.begin(); it != results.end(); it++)
+    {
+        for (auto name = step.begin(); name != step.end(); name++)
+        {
+            if (name->second.first == it->type)
+                pkg << sep::dataSep << name->first;
+        }
+
+        pkg << sep::dataSep << "0x" << std::setfill('0') << std::setw(8)
+            << std::hex << it->addr;
+        pkg << sep::dataSep << "0x" << std::setfill('0') << std::setw(8)
+            << std::hex << it->value;
+        pkg << sep::dataSep << std::dec << it->us;
+    }
+
+    m_response = status["SEQUENCE"];
+    m_response += pkg.str();
+    m_sendResponse();
+}
+
+//-----------------------------------------------------------------------------
+
 void TpoProtocol::m_sendResponse()
 {
     auto msgLen = m_response.length();
@@ -321,7 +1143,27 @@ void TpoProtocol::m_sendSuccess(jobData & data)
 bool TpoProtocol::m_writeDevVal(dev::devInfo_t & devInfo, uint32_t & val)
 {
     dev::Device dev {devInfo};
-    return dev.write(val);
+    return dev.write(val);
+}
+
+//-----------------------------------------------------------------------------
+
+bool TpoProtocol::m_writeDevMasked(dev::devInfo_t & devInfo, uint32_t & val,
+                                   uint32_t & mask)
+{
+    // Чтение-изменение-запись выполняется внутри устройства под блокировкой.
+    dev::Device dev {devInfo};
+    return dev.modify(val, mask);
+}
+
+//-----------------------------------------------------------------------------
+
+bool TpoProtocol::m_writeDevVals(dev::devInfo_t & devInfo,
+                                 std::vector<uint32_t> & vals)
+{
+    // Все значения записываются через одно отображение.
+    dev::Device dev {devInfo};
+    return dev.write(vals);
 }
 
 //-----------------------------------------------------------------------------
@@ -379,7 +1221,7 @@ void TpoProtocol::m_addDev(jobData_t & data)
     else    // Если пользователь хочет добавить устройство в пул.
     {
         // Добавить устройство к пулу сбора статистики.
-        if (!m_statistic->addDev(devInfo, data.hz))
+        if (!m_statistic->addDev(devInfo, data.hz, data.opts))
             m_sendError(data);
     }
 }
@@ -441,6 +1283,32 @@ void TpoProtocol::m_delFile(jobData_t & data)
 
 //-----------------------------------------------------------------------------
 
+void TpoProtocol::m_modDev(jobData_t & data)
+{
+    // Перенести устройство в пул с новой частотой считывания.
+    if (!m_statistic->modDev(data.addr, data.hz))
+        m_sendNotActive(data);
+    else
+        m_sendSuccess(data);
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_modFile(jobData_t & data)
+{
+    auto apiName = std::string(data.dtbDev) + "/" + data.apiName;
+    auto fullPath = m_devTree.getApiPath(apiName);
+    dev::file_t fileInfo {fullPath, apiName};
+
+    // Перенести файл API в пул с новой частотой считывания.
+    if (!m_statistic->modFile(fileInfo, data.hz))
+        m_sendNotActive(data);
+    else
+        m_sendSuccess(data);
+}
+
+//-----------------------------------------------------------------------------
+
 void TpoProtocol::m_setDev(jobData_t & data)
 {
     // Запись производится в один регистр.
@@ -462,6 +1330,48 @@ void TpoProtocol::m_setDev(jobData_t & data)
 
 //-----------------------------------------------------------------------------
 
+void TpoProtocol::m_setDevMask(jobData_t & data)
+{
+    // Запись производится в один регистр.
+    dev::devInfo_t devInfo {data.addr, 1};
+
+    // Проверить наличие устройства в дереве устройств.
+    if (!m_checkDev(devInfo))
+    {
+        m_sendNotExist(data);
+        return;
+    }
+
+    // Изменить биты регистра по маске.
+    if (!m_writeDevMasked(devInfo, data.regVal, data.regMask))
+        m_sendError(data);
+    else
+        m_sendSuccess(data);
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_setDevBlk(jobData_t & data)
+{
+    // Запись производится в последовательные регистры.
+    dev::devInfo_t devInfo {data.addr, (unsigned int) data.regVals.size()};
+
+    // Проверить наличие всего региона в дереве устройств.
+    if (!m_checkDev(devInfo))
+    {
+        m_sendNotExist(data);
+        return;
+    }
+
+    // Записать значения начиная с адреса.
+    if (!m_writeDevVals(devInfo, data.regVals))
+        m_sendError(data);
+    else
+        m_sendSuccess(data);
+}
+
+//-----------------------------------------------------------------------------
+
 void TpoProtocol::m_setFile(jobData_t & data)
 {
     auto apiName = std::string(data.dtbDev) + "/" + data.apiName;
@@ -541,11 +1451,272 @@ timers::hz_t TpoProtocol::m_getUpdateHz(std::string & data)
 
 //-----------------------------------------------------------------------------
 
+bool TpoProtocol::m_getSubOpts(std::vector<std::string> & params,
+                               dev::subOpts_t & opts)
+{
+    opts = dev::subOpts_t();
+    opts.hgramSub = hgram::s_defSubBits;
+    // Заданы параметры интервалов гистограмм (линейные или лог-линейные).
+    bool linear = false;
+    bool logLin = false;
+
+    // Первый параметр - частота.
+    for (size_t i = 1; i < params.size(); i++)
+    {
+        auto opt = splitString(params[i], sep::valSep);
+        if (opt.size() != 2 || !opt[1].size() ||
+            !std::all_of(opt[1].begin(), opt[1].end(), [](char i)
+                { return (std::isdigit(i) || i == '.'); }) ||
+            !std::any_of(opt[1].begin(), opt[1].end(), [](char i)
+                { return std::isdigit(i); }))
+        {
+            return false;
+        }
+
+        // Окно агрегации в секундах.
+        if (opt[0] == "agg")
+        {
+            opts.aggSec = std::stod(opt[1]);
+            continue;
+        }
+
+        // Размер истории в секундах или в МБ.
+        if (opt[0] == "hist" || opt[0] == "histmb")
+        {
+            auto size = std::stod(opt[1]);
+            if (size <= 0)
+                return false;
+
+            if (opt[0] == "hist")
+                opts.histSec = size;
+            else
+                opts.histMb = size;
+            continue;
+        }
+
+        // Количество отсчетов захвата до и после срабатывания триггера.
+        if (opt[0] == "pre" || opt[0] == "post")
+        {
+            if (opt[1].find('.') != std::string::npos || opt[1].size() > 9)
+                return false;
+
+            auto samples = (unsigned int)std::stoul(opt[1]);
+            if (opt[0] == "pre")
+                opts.capPre = samples;
+            else
+                opts.capPost = samples;
+            continue;
+        }
+
+        // Период передачи гистограмм в секундах.
+        if (opt[0] == "hgram")
+        {
+            opts.hgramSec = std::stod(opt[1]);
+            if (opts.hgramSec <= 0)
+                return false;
+            continue;
+        }
+
+        // Линейные интервалы гистограмм: количество и границы диапазона.
+        if (opt[0] == "bins" || opt[0] == "lo" || opt[0] == "hi")
+        {
+            auto value = std::stod(opt[1]);
+            if (opt[0] == "bins")
+            {
+                if (opt[1].find('.') != std::string::npos || value < 1 ||
+                    value > hgram::s_maxBins)
+                {
+                    return false;
+                }
+                opts.hgramBins = (unsigned int)value;
+            }
+            else if (opt[0] == "lo")
+            {
+                opts.hgramLo = value;
+            }
+            else
+            {
+                opts.hgramHi = value;
+            }
+
+            linear = true;
+            continue;
+        }
+
+        // Лог-линейные интервалы гистограмм: бит деления степени двойки.
+        if (opt[0] == "sub")
+        {
+            if (opt[1].find('.') != std::string::npos || opt[1].size() > 1 ||
+                std::stoul(opt[1]) > hgram::s_maxSubBits)
+            {
+                return false;
+            }
+
+            opts.hgramSub = (unsigned int)std::stoul(opt[1]);
+            logLin = true;
+            continue;
+        }
+
+        // Данные не передаются, устройство считывается только для триггеров.
+        if (opt[0] == "quiet")
+        {
+            if (opt[1] != "0" && opt[1] != "1")
+                return false;
+
+            opts.quiet = opt[1] == "1";
+            continue;
+        }
+
+        // Ступени фильтров применяются в порядке перечисления.
+        if (opts.filters.size() == s_maxFilters)
+            return false;
+
+        auto value = std::stod(opt[1]);
+        if (opt[0] == "box" || opt[0] == "cic")
+        {
+            // Коэффициент прореживания - целое число.
+            if (opt[1].find('.') != std::string::npos ||
+                value < s_minDecim || value > s_maxDecim)
+            {
+                return false;
+            }
+
+            auto type = opt[0] == "box" ? dev::filter_t::BOX : dev::filter_t::CIC;
+            opts.filters.push_back({type, (unsigned int)value, 0});
+        }
+        else if (opt[0] == "ema")
+        {
+            if (value <= 0 || value > 1)
+                return false;
+
+            opts.filters.push_back({dev::filter_t::EMA, 1, value});
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // Интервалы задаются только вместе с периодом гистограмм, линейные -
+    // количеством и непустым диапазоном.
+    if (!opts.hgramSec)
+        return !(linear || logLin);
+    if (linear && (logLin || !opts.hgramBins || opts.hgramHi <= opts.hgramLo))
+        return false;
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool TpoProtocol::m_getTrigger(std::string & def, trig::params_t & params)
+{
+    params = {trig::cond_t::GT, 0, 0, 0, trig::edge_t::RISE, 0, 1};
+
+    auto opts = splitString(def, sep::optSep);
+    if (!opts.size())
+        return false;
+
+    for (size_t i = 0; i < opts.size(); i++)
+    {
+        auto opt = splitString(opts[i], sep::valSep);
+        if (opt.size() != 2 || !opt[1].size())
+            return false;
+
+        // Первый параметр - условие.
+        if (!i)
+        {
+            if (opt[0] == "gt" || opt[0] == "lt")
+            {
+                if (!m_getNumber(opt[1], params.level))
+                    return false;
+                params.cond = opt[0] == "gt" ? trig::cond_t::GT : trig::cond_t::LT;
+            }
+            else if (opt[0] == "mask")
+            {
+                // Маска и образец через "/".
+                auto maskData = splitString(opt[1], sep::baseSep);
+                if (maskData.size() != 2)
+                    return false;
+
+                params.mask = m_getValue(maskData[0]);
+                if (m_jobError)
+                    return false;
+                params.pattern = m_getValue(maskData[1]);
+                if (m_jobError || (params.pattern & ~params.mask))
+                    return false;
+                params.cond = trig::cond_t::MASK;
+            }
+            else
+            {
+                return false;
+            }
+            continue;
+        }
+
+        if (opt[0] == "hyst")
+        {
+            // Гистерезис применим только к порогам.
+            if (!m_getNumber(opt[1], params.hyst) || params.hyst < 0 ||
+                params.cond == trig::cond_t::MASK)
+            {
+                return false;
+            }
+        }
+        else if (opt[0] == "deb")
+        {
+            auto debounce = m_getValue(opt[1]);
+            if (m_jobError || !debounce || debounce > s_maxDebounce)
+                return false;
+            params.debounce = debounce;
+        }
+        else if (opt[0] == "edge")
+        {
+            if (opt[1] == "rise")
+                params.edge = trig::edge_t::RISE;
+            else if (opt[1] == "fall")
+                params.edge = trig::edge_t::FALL;
+            else if (opt[1] == "both")
+                params.edge = trig::edge_t::BOTH;
+            else
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool TpoProtocol::m_getNumber(std::string & data, double & number)
+{
+    if (!data.size())
+        return false;
+
+    char * end;
+    number = strtod(data.c_str(), &end);
+    return *end == '\0' && std::isfinite(number);
+}
+
+//-----------------------------------------------------------------------------
+
 uint32_t TpoProtocol::m_getValue(std::string & data)
 {
     m_jobError = false;
-    std::string prefix = std::string (data.begin(), data.begin() + 2);
-    if (prefix == "0x" && std::all_of(data.begin() + 2, data.end(), [](char i)
+    // Пустое значение не является числом.
+    if (!data.size())
+    {
+        m_jobError = true;
+        return 0;
+    }
+
+    // Короткие значения (например, "1") не должны выходить за пределы строки.
+    std::string prefix = data.substr(0, 2);
+    if (prefix == "0x" && data.size() > 2 && std::all_of(data.begin() + 2, data.end(), [](char i)
             { return std::isxdigit(i); }))
     {
         return strtoul(data.c_str(), NULL, 16);
@@ -656,6 +1827,8 @@ void TpoProtocol::m_clearPkg()
     m_body.clear();
     // Входящее сообщение, полученное из пакета.
     m_msg.clear();
+    // Бинарные данные, полученные из пакета.
+    m_payload.clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -696,9 +1869,13 @@ bool TpoProtocol::m_isGetRequestCorrect(std::vector<std::string> & request)
         if (request[i].find(sep::baseSep) == std::string::npos)
             return false;
 
-        // Проверить является ли cледующий параметр числом.
-        if (!std::all_of(request[i+1].begin(), request[i+1].end(),
-                         [](char i) { return (std::isdigit(i) || i == '.'); }))
+        // Проверить является ли cледующий параметр числом (параметры
+        // подписки после частоты проверяются при разборе запроса).
+        auto hz = request[i+1].substr(0, request[i+1].find(sep::optSep));
+        if (!std::any_of(hz.begin(), hz.end(), [](char i)
+                { return std::isdigit(i); }) ||
+            !std::all_of(hz.begin(), hz.end(), [](char i)
+                { return (std::isdigit(i) || i == '.'); }))
         {
             return false;
         }
@@ -724,6 +1901,17 @@ bool TpoProtocol::m_isSetRequestCorrect(std::vector<std::string> & request)
 
 //-----------------------------------------------------------------------------
 
+bool TpoProtocol::m_isSetMaskRequest(std::vector<std::string> & request)
+{
+    // Запись по маске - ровно три параметра, и первый из них - адрес регистра.
+    if (request.size() != 3)
+        return false;
+
+    return request[0].find('@') == std::string::npos;
+}
+
+//-----------------------------------------------------------------------------
+
 TpoProtocol::jobData_t TpoProtocol::m_getJob(std::string & base,
                                              std::string & hz)
 {
@@ -750,7 +1938,31 @@ TpoProtocol::jobData_t TpoProtocol::m_getJob(std::string & base,
         jobData.regCnt = m_getRegCnt(data[1]);
     }
 
-    jobData.hz = m_getUpdateHz(hz);
+    // Частота и параметры подписки.
+    auto params = splitString(hz, sep::optSep);
+    jobData.hz = m_getUpdateHz(params[0]);
+    if (!m_getSubOpts(params, jobData.opts))
+    {
+        m_jobError = true;
+        return jobData;
+    }
+
+    // Параметры подписки поддерживаются только для устройств, считываемых
+    // периодически.
+    if (params.size() > 1 && (!jobData.device || !jobData.hz))
+        m_jobError = true;
+
+    // Буферы захвата выделяются заранее, поэтому их размер ограничен.
+    auto & opts = jobData.opts;
+    if (opts.capPre || opts.capPost)
+    {
+        auto sampleSize = sizeof(uint64_t) + jobData.regCnt * sizeof(uint32_t);
+        if ((opts.capPre * 2 + opts.capPost + 1) * sampleSize > s_maxCaptureBytes)
+            m_jobError = true;
+        // Захват заменяет передачу данных устройства.
+        opts.quiet = true;
+    }
+
     return jobData;
 }
 
@@ -784,6 +1996,33 @@ TpoProtocol::jobData_t TpoProtocol::m_delJob(std::string & base)
 
 //-----------------------------------------------------------------------------
 
+TpoProtocol::jobData_t TpoProtocol::m_modJob(std::string & base,
+                                             std::string & hz)
+{
+    // Устройство/API указываются так же, как в запросе DEL.
+    auto jobData = m_delJob(base);
+    if (m_jobError)
+        return jobData;
+
+    // Частота должна быть положительным числом.
+    if (!std::any_of(hz.begin(), hz.end(), [](char i)
+            { return std::isdigit(i); }) ||
+        !std::all_of(hz.begin(), hz.end(), [](char i)
+            { return (std::isdigit(i) || i == '.'); }))
+    {
+        m_jobError = true;
+        return jobData;
+    }
+
+    jobData.hz = m_getUpdateHz(hz);
+    if (jobData.hz <= 0)
+        m_jobError = true;
+
+    return jobData;
+}
+
+//-----------------------------------------------------------------------------
+
 TpoProtocol::jobData_t TpoProtocol::m_setJob(std::string & base,
                                              std::string & value)
 {
@@ -816,6 +2055,77 @@ TpoProtocol::jobData_t TpoProtocol::m_setJob(std::string & base,
 
 //-----------------------------------------------------------------------------
 
+TpoProtocol::jobData_t TpoProtocol::m_setMaskJob(std::string & base,
+                                                 std::string & value,
+                                                 std::string & mask)
+{
+    jobData_t jobData;
+
+    // Адрес может быть указан как с количеством регистров, так и без него.
+    auto data = splitString(base, sep::baseSep);
+    if (!data.size() || data[0].find('@') != std::string::npos)
+    {
+        m_jobError = true;
+        return jobData;
+    }
+
+    jobData.device = true;
+    jobData.addr = m_getDevAddr(data[0]);
+    if (m_jobError)
+        return jobData;
+    jobData.regVal = m_getDevValue(value);
+    if (m_jobError)
+        return jobData;
+    jobData.regMask = m_getDevValue(mask);
+
+    return jobData;
+}
+
+//-----------------------------------------------------------------------------
+
+TpoProtocol::jobData_t TpoProtocol::m_setBlkJob(std::vector<std::string> & request)
+{
+    jobData_t jobData;
+
+    jobData.device = true;
+    jobData.addr = m_getDevAddr(request[0]);
+    if (m_jobError)
+        return jobData;
+
+    // Значения переданы в бинарном виде (32-битные слова little-endian).
+    if (request.size() == 2 && request[1] == m_binTag)
+    {
+        if (!m_payload.size() || m_payload.size() % sizeof(uint32_t))
+        {
+            m_jobError = true;
+            return jobData;
+        }
+
+        auto bytes = reinterpret_cast<const uint8_t *>(m_payload.data());
+        for (size_t i = 0; i < m_payload.size(); i += sizeof(uint32_t))
+        {
+            jobData.regVals.push_back(uint32_t(bytes[i])            |
+                                      uint32_t(bytes[i + 1]) << 8   |
+                                      uint32_t(bytes[i + 2]) << 16  |
+                                      uint32_t(bytes[i + 3]) << 24);
+        }
+
+        return jobData;
+    }
+
+    // Значения переданы в текстовом виде.
+    for (auto it = request.begin() + 1; it != request.end(); it++)
+    {
+        jobData.regVals.push_back(m_getDevValue(*it));
+        if (m_jobError)
+            return jobData;
+    }
+
+    return jobData;
+}
+
+//-----------------------------------------------------------------------------
+
 TpoProtocol::jobData_t TpoProtocol::m_dtb(std::string & base)
 {
     jobData_t jobData
@@ -829,10 +2139,69 @@ TpoProtocol::jobData_t TpoProtocol::m_dtb(std::string & base)
 
 //-----------------------------------------------------------------------------
 
-void TpoProtocol::m_sendPkg(char * msg)
+bool TpoProtocol::m_seqJob(std::vector<std::string> & request,
+                           sequence::steps_t & steps)
+{
+    for (unsigned long i = 0; i < request.size(); )
+    {
+        auto name = request[i];
+        std::transform(name.begin(), name.end(), name.begin(),
+                       [](unsigned char c){ return std::tolower(c); });
+
+        auto it = step.find(name);
+        if (it == step.end())
+            return false;
+
+        // Проверить, что для шага указаны все параметры.
+        auto argCnt = it->second.second;
+        if (i + argCnt >= request.size())
+            return false;
+
+        std::vector<uint32_t> args;
+        for (unsigned int arg = 1; arg <= argCnt; arg++)
+        {
+            args.push_back(m_getValue(request[i + arg]));
+            if (m_jobError)
+            {
+                m_jobError = false;
+                return false;
+            }
+        }
+
+        sequence::stepData_t stepData {it->second.first, 0, 0, 0, 0};
+        switch (stepData.type)
+        {
+        case sequence::step_t::WRITE:
+            stepData.addr = args[0];
+            stepData.value = args[1];
+            break;
+        case sequence::step_t::READ:
+            stepData.addr = args[0];
+            break;
+        case sequence::step_t::WAIT:
+            stepData.us = long(args[0]);
+            break;
+        case sequence::step_t::POLL:
+            stepData.addr = args[0];
+            stepData.mask = args[1];
+            stepData.value = args[2];
+            stepData.us = long(args[3]);
+            break;
+        }
+
+        steps.push_back(stepData);
+        i += argCnt + 1;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_sendPkg(const std::string & msg)
 {
-    // Поменять ?
-    m_udp.sendData(reinterpret_cast<byte_t *>(msg), strlen(msg));
+    // Длина берется из строки, так как бинарные данные могут содержать нули.
+    m_udp.sendData(reinterpret_cast<const byte_t *>(msg.data()), msg.size());
 }
 
 //-----------------------------------------------------------------------------
@@ -853,6 +2222,22 @@ void TpoProtocol::m_splitMsg()
     m_body = std::string(cmdEnd + 1, m_msg.end());
 }
 
+//-----------------------------------------------------------------------------
+
+void TpoProtocol::m_splitPayload()
+{
+    // Бинарные данные идут после метки ",bin," до конца пакета.
+    auto tag = sep::dataSep + m_binTag + sep::dataSep;
+
+    auto pos = m_msg.find(tag);
+    if (pos == std::string::npos)
+        return;
+
+    m_payload = m_msg.substr(pos + tag.size());
+    // Оставить метку в текстовой части, чтобы команда знала о бинарных данных.
+    m_msg.resize(pos + tag.size() - 1);
+}
+
 //=============================================================================
 
 } // namespace tpoprotocol
@@ -10,6 +10,7 @@
 #include "global-module/cbytearray.h"
 #include "udpserver.h"
 #include "statistic.h"
+#include "sequence.h"
 #include "devtree.h"
 #include "logger-library/logger.h"
 
@@ -31,13 +32,19 @@ public:
 
     // Базовая инициализация и запуск сервера.
     void init();
+    // Остановить сервер (прерывает ожидание команды).
+    void stop();
 
     //-------------------------------------------------------------------------
 
     // Отправить пакет со статистикой.
     void sendStatistic(std::stringstream & data);
+    // Отправить пакеты со статистикой из очереди пакетов.
+    void sendStatistic(ring::pkg_t ** pkgs, size_t count);
     // Установить указатель на внутреннюю переменную-класс, отвечающую за статистику.
     void setPointerToStatistic(statistic::Statistic * stat);
+    // Установить указатель на класс выполнения последовательностей команд.
+    void setPointerToSequencer(sequence::Sequencer * seq);
     // Ожидание пакета с командой от пользователя.
     bool waitForCommand();
 
@@ -53,9 +60,21 @@ private:
         "keep-alive",       // Для поддержания Keep-Alive.
         "get",              // Получить статистику устройства/устройств.
         "del",              // Удалить устройство/устройства из пула сбора статистики.
+        "mod",              // Изменить частоту сбора статистики для активных устройств/API.
         "set",              // Записать значение по адресу.
+        "setblk",           // Записать массив значений в последовательные регистры.
+        "setm",             // Записать значения по маске в регистры.
         "dtb",              // Получить дерево устройств.
-        "stop"              // Остановить сбор статистики для всех устройств и файлов.
+        "stop",             // Остановить сбор статистики для всех устройств и файлов.
+        "fmt",              // Выбрать формат записи данных устройств.
+        "seq",              // Выполнить последовательность команд на блоке.
+        "queue",            // Получить состояние очереди пакетов со статистикой.
+        "sched",            // Получить точность пробуждений планировщика.
+        "trig",             // Добавить/удалить триггеры или получить их список.
+        "history",          // Получить отсчеты из истории устройства.
+        "record",           // Запись пакетов на накопитель и воспроизведение.
+        "derive",           // Добавить/удалить производные каналы или получить их список.
+        "burst"             // Прочитать устройство пачкой считываний без пауз.
     };
 
     //-------------------------------------------------------------------------
@@ -73,7 +92,62 @@ private:
         {"ERROR", "ERROR,"},               // Заголовок для обозначения ошибки (не удалось выполнить какую-то команду)
         {"GET", "GET,"},                   // Заголовок для обозначения пакетов статистики.
         {"STOPPED", "STOPPED,"},           // Заголовок для обозначения остановки сбора статистики.
-        {"DELETED", "DELETED,"}            // Заголовок для обозначения удаления из пула устройства/API.
+        {"DELETED", "DELETED,"},           // Заголовок для обозначения удаления из пула устройства/API.
+        {"FORMAT", "FORMAT,"},             // Заголовок для текущего формата данных устройств.
+        {"SEQUENCE", "SEQUENCE,"},         // Заголовок для результатов последовательности команд.
+        {"MERGED", "MERGED,"},             // Заголовок для накопленных при переполнении очереди данных.
+        {"QUEUE", "QUEUE,"},               // Заголовок для состояния очереди пакетов.
+        {"SCHED", "SCHED,"},               // Заголовок для точности планировщика.
+        {"HIRATE", "HIRATE,"},             // Заголовок для пачки высокочастотных отсчетов.
+        {"AGG", "AGG,"},                   // Заголовок для агрегатов регистров за окно.
+        {"TRIGGER", "TRIGGER,"},           // Заголовок для добавленных триггеров и их списка.
+        {"EVENT", "EVENT,"},               // Заголовок для событий сработавших триггеров.
+        {"CAPTURE", "CAPTURE,"},           // Заголовок для части осциллографического захвата.
+        {"HISTORY", "HISTORY,"},           // Заголовок для истории устройства.
+        {"RECORD", "RECORD,"},             // Заголовок для записей и их воспроизведения.
+        {"HGRAM", "HGRAM,"},               // Заголовок для гистограмм значений регистров.
+        {"DERIVE", "DERIVE,"},             // Заголовок для добавленных производных каналов и их списка.
+        {"DERIVED", "DERIVED,"},           // Заголовок для значений производных каналов.
+        {"BURST", "BURST,"},               // Заголовок для части пачки считываний.
+        {"FRAME", "FRAME,"}                // Заголовок для пакета тика с данными устройств и файлов API.
+    };
+
+    //-------------------------------------------------------------------------
+
+    // Шаги последовательности команд и количество их параметров.
+    typedef std::map<std::string, std::pair<sequence::step_t, unsigned int>> steps_t;
+    steps_t step =
+    {
+        {"write", {sequence::step_t::WRITE, 2}},    // Адрес и значение.
+        {"read", {sequence::step_t::READ, 1}},      // Адрес.
+        {"wait", {sequence::step_t::WAIT, 1}},      // Время в микросекундах.
+        {"poll", {sequence::step_t::POLL, 4}}       // Адрес, маска, значение, таймаут.
+    };
+
+    //-------------------------------------------------------------------------
+
+    // Имена форматов записи данных устройств.
+    typedef std::map<std::string, statistic::format_t> formats_t;
+    formats_t format =
+    {
+        {"legacy", statistic::format_t::LEGACY},    // Адрес и значение для каждого регистра.
+        {"compact", statistic::format_t::COMPACT}   // База и количество, затем значения.
+    };
+
+    // Имена кодировок данных устройств.
+    typedef std::map<std::string, statistic::encoding_t> encodings_t;
+    encodings_t encoding =
+    {
+        {"text", statistic::encoding_t::TEXT},      // HEX-строки.
+        {"binary", statistic::encoding_t::BINARY}   // 32-битные слова little-endian.
+    };
+
+    // Имена способов передачи данных тика.
+    typedef std::map<std::string, statistic::framing_t> framings_t;
+    framings_t framing =
+    {
+        {"split", statistic::framing_t::SPLIT},     // Отдельные пакеты устройств и файлов API.
+        {"frame", statistic::framing_t::FRAME}      // Один пакет тика с разделами.
     };
 
     //-------------------------------------------------------------------------
@@ -86,12 +160,15 @@ private:
         uint32_t addr;          // Содержит адрес устройства.
         uint32_t regCnt;        // Количество регистров для считывания.
         uint32_t regVal;        // Значение для записи в регистр.
+        std::vector<uint32_t> regVals;  // Значения для записи в последовательные регистры.
+        uint32_t regMask;       // Маска изменяемых битов регистра.
 
         std::string dtbDev;     // Для именя IP-Core в DTB.
         std::string apiName;    // Имя файла API.
         std::string apiVal;     // Значение для записи в API.
 
         timers::hz_t hz;        // Частота обновления.
+        dev::subOpts_t opts;    // Параметры подписки.
     } jobData_t;
 
     //-------------------------------------------------------------------------
@@ -102,6 +179,10 @@ private:
     std::string m_cmd;
     // Тело сообщения (без команды), полученное из пакета.
     std::string m_body;
+    // Бинарные данные, переданные после метки "bin" (не обрабатываются как текст).
+    std::string m_payload;
+    // Метка начала бинарных данных в команде.
+    const std::string m_binTag = "bin";
 
     //-------------------------------------------------------------------------
 
@@ -113,11 +194,21 @@ private:
     const int m_pkgSize = 8192;
     // Ответный пакет.
     std::string m_response;
+    // Ответ на пачку считываний и смещения концов его частей (память
+    // сохраняется между командами).
+    buffer::Buffer m_burstReply;
+    std::vector<size_t> m_burstEnds;
+    // Части пакетов статистики для отправки (используется потоком отправки).
+    std::vector<udpserver::UdpServer::pkgParts_t> m_parts;
+    // Получить заголовок пакета статистики по его типу.
+    std::string & m_getHeader(ring::type_t type);
 
     //-------------------------------------------------------------------------
 
     // Для взаимодействия с классом сбора статистики.
     statistic::Statistic * m_statistic;
+    // Для выполнения последовательностей команд.
+    sequence::Sequencer * m_sequencer;
     // Для взаимодействия с деревом устройств.
     devtree::DevTree m_devTree;
 
@@ -129,6 +220,8 @@ private:
     bool m_isCmdExist();
     // Разбить сообщение на команду и тело сообщения.
     void m_splitMsg();
+    // Отделить бинарные данные от текстовой части сообщения.
+    void m_splitPayload();
     // Обработать команду.
     void m_parseCmd();
 
@@ -140,12 +233,36 @@ private:
     void m_handleGet();
     // Обработать команду DEL.
     void m_handleDel();
+    // Обработать команду MOD.
+    void m_handleMod();
     // Обработать команду SET.
     void m_handleSet();
+    // Обработать команду SETBLK.
+    void m_handleSetBlk();
+    // Обработать запись по маске (SET с маской и SETM).
+    void m_handleSetMask(std::vector<std::string> & request);
     // Обработать команду DTB.
     void m_handleDtb();
     // Обработать команду STOP.
     void m_handleStop();
+    // Обработать команду FMT.
+    void m_handleFmt();
+    // Обработать команду SEQ.
+    void m_handleSeq();
+    // Обработать команду QUEUE.
+    void m_handleQueue();
+    // Обработать команду SCHED.
+    void m_handleSched();
+    // Обработать команду TRIG.
+    void m_handleTrig();
+    // Обработать команду HISTORY.
+    void m_handleHistory();
+    // Обработать команду RECORD.
+    void m_handleRecord();
+    // Обработать команду DERIVE.
+    void m_handleDerive();
+    // Обработать команду BURST.
+    void m_handleBurst();
 
     //-------------------------------------------------------------------------
 
@@ -153,10 +270,19 @@ private:
     jobData_t m_getJob(std::string & base, std::string & hz);
     // Получить информацию из запроса DEL об устройствах/API.
     jobData_t m_delJob(std::string & base);
+    // Получить информацию из запроса MOD об устройствах/API.
+    jobData_t m_modJob(std::string & base, std::string & hz);
     // Получить информацию из запроса SET об устройствах/API.
     jobData_t m_setJob(std::string & base, std::string & value);
+    // Получить информацию из запроса на запись по маске.
+    jobData_t m_setMaskJob(std::string & base, std::string & value,
+                           std::string & mask);
+    // Получить информацию из запроса SETBLK об устройстве.
+    jobData_t m_setBlkJob(std::vector<std::string> & request);
     // Получить информацию из запроса DTB об устройстве.
     jobData_t m_dtb(std::string & base);
+    // Получить шаги последовательности из запроса SEQ.
+    bool m_seqJob(std::vector<std::string> & request, sequence::steps_t & steps);
 
     // Для обозначения ошибки в функциях обратоки работы (для избежания дублирующего кода)
     bool m_jobError;
@@ -167,6 +293,8 @@ private:
     bool m_isGetRequestCorrect(std::vector<std::string> & request);
     // Проверить правильность запроса SET.
     bool m_isSetRequestCorrect(std::vector<std::string> & request);
+    // Проверить является ли запрос SET записью по маске.
+    bool m_isSetMaskRequest(std::vector<std::string> & request);
     // Проверить существует ли устройство в дереве устройств.
     bool m_checkDev(dev::devInfo_t & dev);
 
@@ -174,6 +302,25 @@ private:
 
     // Получить частоту обновления для чтения устройств/API.
     timers::hz_t m_getUpdateHz(std::string & data);
+    // Получить параметры подписки из частоты ("100:box=10:agg=1").
+    bool m_getSubOpts(std::vector<std::string> & params, dev::subOpts_t & opts);
+    // Максимальное количество ступеней фильтров подписки.
+    static const size_t s_maxFilters = 4;
+    // Допустимые коэффициенты прореживания фильтров.
+    static constexpr double s_minDecim = 1;
+    static constexpr double s_maxDecim = 10000;
+    // Максимальный размер буферов захвата устройства в байтах.
+    static const size_t s_maxCaptureBytes = 4 * 1024 * 1024;
+    // Максимальный размер отсчетов пачки считываний в байтах.
+    static const size_t s_maxBurstBytes = 4 * 1024 * 1024;
+    // Максимальное количество интервалов в ответе на запрос уровня детализации.
+    static const size_t s_maxLodPoints = 10000;
+    // Получить параметры триггера из условия ("gt=100:hyst=5:deb=3").
+    bool m_getTrigger(std::string & def, trig::params_t & params);
+    // Максимальное количество проверок подряд для подавления дребезга.
+    static const unsigned int s_maxDebounce = 10000;
+    // Получить число (десятичное или HEX с префиксом 0x) из строки.
+    bool m_getNumber(std::string & data, double & number);
     // Получить число из строки.
     uint32_t m_getValue(std::string & data);
     // Получить количество регистров для чтения.
@@ -201,10 +348,14 @@ private:
     void m_sendBadCmd();
     // Отправить список активных устройств и API.
     void m_sendActive();
+    // Отправить текущий формат данных устройств.
+    void m_sendFormat();
+    // Отправить результаты выполнения последовательности.
+    void m_sendSequence(sequence::steps_t & steps, sequence::results_t & results);
     // Отправить сформированный пакет обратно пользователю.
     void m_sendResponse();
     // Отправить сырой пакет пользователю.
-    void m_sendPkg(char * msg);
+    void m_sendPkg(const std::string & msg);
 
     //-------------------------------------------------------------------------
 
@@ -216,14 +367,27 @@ private:
     void m_delDev(jobData_t & data);
     // Для удаления файла API из пула.
     void m_delFile(jobData_t & data);
+    // Для изменения частоты считывания устройства.
+    void m_modDev(jobData_t & data);
+    // Для изменения частоты считывания файла API.
+    void m_modFile(jobData_t & data);
     // Для записи значения в устройство.
     void m_setDev(jobData_t & data);
     // Для записи значения в файл API.
     void m_setFile(jobData_t & data);
+    // Для записи массива значений в последовательные регистры.
+    void m_setDevBlk(jobData_t & data);
+    // Для записи значения в устройство по маске.
+    void m_setDevMask(jobData_t & data);
     // Получить функционал API для устройства.
     void m_getDtbApi(jobData_t & devInfo);
     // Записать значение по адресу.
     bool m_writeDevVal(dev::devInfo_t & devInfo, uint32_t & val);
+    // Записать значение по адресу по маске.
+    bool m_writeDevMasked(dev::devInfo_t & devInfo, uint32_t & val,
+                          uint32_t & mask);
+    // Записать массив значений начиная с адреса.
+    bool m_writeDevVals(dev::devInfo_t & devInfo, std::vector<uint32_t> & vals);
     // Записать значение в файл API.
     bool m_writeApiVal(dev::file_t & fileInfo, std::string & val);
     // Прочитать устройство один раз.
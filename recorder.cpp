@@ -0,0 +1,919 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <filesystem>
+#include <algorithm>
+#include <iomanip>
+#include <fstream>
+
+#include "recorder.h"
+#include "timers.h"
+#include "common.h"
+#include "config-library/iiniparams.h"
+#include "config-library/ciniparser.h"
+
+//-----------------------------------------------------------------------------
+
+namespace rec
+{
+
+//=============================================================================
+
+Recorder::Recorder(int eventFd)
+    : m_cfg(m_readConfig()), m_recording(false),
+      m_columnar(false), m_seg {0, -1, -1, nullptr, 0, 0}, m_records(0),
+      m_bytes(0), m_chunkBuf(s_chunkBufSize),
+      m_samples(s_sampleSlots, s_sampleSlotSize, eventFd), m_sampleDrops(0),
+      m_ring(m_cfg.queuePackets, s_maxPkgSize, eventFd), m_replaying(false)
+{}
+
+//-----------------------------------------------------------------------------
+
+Recorder::~Recorder()
+{
+    stopReplay();
+
+    std::stringstream info;
+    stop(info);
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::start(const std::string & name, bool columnar)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_recording.load())
+    {
+        LOGGER_ERROR("Recording \"" + m_name + "\" is already active");
+        return false;
+    }
+
+    // Запись не дописывается: метки времени другой загрузки несравнимы.
+    std::error_code err;
+    auto path = m_getPath(name);
+    if (std::filesystem::exists(path, err) ||
+        !std::filesystem::create_directories(path, err))
+    {
+        LOGGER_ERROR("Can't create recording directory " + path);
+        return false;
+    }
+
+    // Формат записи хранится в каталоге записи.
+    std::ofstream format(path + "/" + s_formatFile);
+    format << (columnar ? "columns" : "packets") << std::endl;
+
+    // Значения, опубликованные после остановки предыдущей записи.
+    while (m_samples.front())
+        m_samples.release();
+
+    m_name = name;
+    m_columnar = columnar;
+    m_sampleDrops = 0;
+    m_closed.clear();
+    m_chunks.clear();
+    m_records = 0;
+    m_bytes = 0;
+
+    if (!m_openSegment(1))
+        return false;
+
+    if (!m_lod.open(path, uint64_t(m_cfg.lodMs) * 1000000ULL, m_seg.number))
+    {
+        m_closeSegment();
+        return false;
+    }
+
+    m_recording = true;
+    LOGGER_INFO("Recording \"" + name + "\" started");
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::stop(std::stringstream & info)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_recording.load())
+        return false;
+
+    m_drainSamples();
+
+    // Записать незавершенные блоки отсчетов.
+    for (auto it = m_chunks.begin(); it != m_chunks.end(); it++)
+        m_flushChunk(it->second);
+    m_chunks.clear();
+
+    m_recording = false;
+    m_closeSegment();
+    m_lod.close();
+
+    info << m_name << sep::dataSep << m_records << sep::dataSep << m_bytes;
+    if (m_sampleDrops.load())
+    {
+        std::stringstream msg;
+        msg << "Recording \"" << m_name << "\" lost samples of "
+            << m_sampleDrops.load() << " ticks";
+        LOGGER_WARNING(msg.str());
+    }
+    LOGGER_INFO("Recording \"" + m_name + "\" stopped");
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::isRecording()
+{
+    return m_recording.load();
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::list(std::stringstream & pkg)
+{
+    std::error_code err;
+    std::vector<std::string> names;
+    for (const auto & entry :
+         std::filesystem::directory_iterator(m_cfg.dir, err))
+    {
+        if (entry.is_directory(err))
+            names.push_back(entry.path().filename().string());
+    }
+    std::sort(names.begin(), names.end());
+
+    bool first = true;
+    for (auto it = names.begin(); it != names.end(); it++)
+    {
+        auto segments = m_getSegments(*it);
+        if (!segments.size())
+            continue;
+
+        uint64_t bytes = 0;
+        for (auto seg = segments.begin(); seg != segments.end(); seg++)
+            bytes += std::filesystem::file_size(m_getSegPath(*it, *seg, false), err);
+
+        // Метки времени берутся из индексов первого и последнего сегментов.
+        auto firstIndex = m_readIndex(*it, segments.front());
+        auto lastIndex = m_readIndex(*it, segments.back());
+
+        if (!first)
+            pkg << sep::dataSep;
+        first = false;
+
+        // Формат записи (записи без файла формата - пакетные).
+        std::string format;
+        std::ifstream formatFile(m_getPath(*it) + "/" + s_formatFile);
+        if (!(formatFile >> format))
+            format = "packets";
+
+        pkg << *it << sep::dataSep << format << sep::dataSep << segments.size()
+            << sep::dataSep << bytes << sep::dataSep
+            << (firstIndex.size() ? firstIndex.front().stamp : 0)
+            << sep::dataSep
+            << (lastIndex.size() ? lastIndex.back().stamp : 0);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::replay(const std::string & name, bool realtime, uint64_t from)
+{
+    {
+        // Воспроизводится только завершенная запись.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_recording.load() && m_name == name)
+        {
+            LOGGER_ERROR("Recording \"" + name + "\" is still active");
+            return false;
+        }
+    }
+
+    if (!m_getSegments(name).size())
+    {
+        LOGGER_ERROR("Recording \"" + name + "\" doesn't exist");
+        return false;
+    }
+
+    // Предыдущее воспроизведение прерывается.
+    stopReplay();
+
+    m_replaying = true;
+    m_replayThread = std::thread(m_doReplay, this, name, realtime, from);
+    if (!m_replayThread.joinable())
+    {
+        m_replaying = false;
+        LOGGER_ERROR("Can't start replay in thread");
+        return false;
+    }
+
+    LOGGER_INFO("Replay of \"" + name + "\" started in thread");
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::stopReplay()
+{
+    bool active = m_replaying.exchange(false);
+
+    // Поток мог завершиться сам в конце записи.
+    if (m_replayThread.joinable())
+        m_replayThread.join();
+
+    return active;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::isValidName(const std::string & name)
+{
+    if (!name.size() || name.size() > s_maxName)
+        return false;
+
+    return std::all_of(name.begin(), name.end(), [](unsigned char c)
+                       { return std::isalnum(c) || c == '-' || c == '_'; });
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::getLod(const std::string & name, uint32_t addr, uint64_t from,
+                      uint64_t to, size_t points, unsigned int & level,
+                      uint64_t & bucketNs, std::vector<lod::bucket_t> & buckets)
+{
+    return lod::Pyramid::query(m_getPath(name), addr, from, to, points, level,
+                               bucketNs, buckets);
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::append(ring::pkg_t ** pkgs, size_t count)
+{
+    if (!m_recording.load() || !count)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Запись могла быть остановлена после проверки.
+    if (!m_recording.load())
+        return;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // В колоночной записи данные устройств хранятся блоками отсчетов
+        // (пакет FRAME содержит те же данные устройств).
+        auto type = pkgs[i]->type;
+        if (m_columnar && (type == ring::type_t::STAT ||
+                           type == ring::type_t::MERGED ||
+                           type == ring::type_t::FRAME))
+            continue;
+
+        m_write(uint32_t(type), pkgs[i]->stamp, pkgs[i]->data.data(),
+                pkgs[i]->data.size());
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::addSamples(uint64_t stamp, const dev::devsRegion_t & region)
+{
+    if (!m_recording.load())
+        return;
+
+    // Запись на накопитель идет в потоке отправки, поэтому сбор статистики
+    // не ждет ее (если поток отправки не успевает, значения тика теряются).
+    auto slot = m_samples.acquire();
+    if (!slot)
+    {
+        m_sampleDrops++;
+        return;
+    }
+
+    slot->data.append(reinterpret_cast<const char *>(&stamp), sizeof(stamp));
+    for (auto reg = region.begin(); reg != region.end(); reg++)
+    {
+        auto count = uint32_t((*reg)->size());
+        slot->data.append(reinterpret_cast<const char *>(&count), sizeof(count));
+        slot->data.append(reinterpret_cast<const char *>((*reg)->data()),
+                          count * sizeof(dev::register_t));
+    }
+
+    m_samples.commit();
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::writeSamples()
+{
+    if (!m_samples.front())
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_drainSamples();
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Recorder::peek(ring::pkg_t ** pkgs, size_t max)
+{
+    return m_ring.peek(pkgs, max);
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::release(size_t count)
+{
+    m_ring.release(count);
+}
+
+//-----------------------------------------------------------------------------
+
+Recorder::recorderCfg_t Recorder::m_readConfig()
+{
+    recorderCfg_t cfg {s_dir, s_segmentMb << 20, s_maxMb << 20, s_indexMs,
+                       s_lodMs, s_chunkMs, s_queuePackets};
+
+    auto params = cfg::ini::parseConfig("/opt/control/conf", "tpoprotocol.ini",
+                                        "STATISTIC");
+    if (!params)
+        return cfg;
+
+    cfg.dir = params->get("record-dir", s_dir);
+
+    auto segmentMb = params->getInt("record-segment-mb", int(s_segmentMb));
+    if (segmentMb > 0)
+        cfg.segmentBytes = size_t(segmentMb) << 20;
+
+    auto maxMb = params->getInt("record-max-mb", int(s_maxMb));
+    if (maxMb > 0)
+        cfg.maxBytes = size_t(maxMb) << 20;
+
+    // В записи всегда остается хотя бы текущий сегмент.
+    cfg.maxBytes = std::max(cfg.maxBytes, cfg.segmentBytes);
+
+    auto indexMs = params->getInt("record-index-ms", int(s_indexMs));
+    if (indexMs > 0)
+        cfg.indexMs = (unsigned int)indexMs;
+
+    auto lodMs = params->getInt("record-lod-ms", int(s_lodMs));
+    if (lodMs > 0)
+        cfg.lodMs = (unsigned int)lodMs;
+
+    auto chunkMs = params->getInt("record-chunk-ms", int(s_chunkMs));
+    if (chunkMs > 0)
+        cfg.chunkMs = (unsigned int)chunkMs;
+
+    auto packets = params->getInt("record-queue-packets", int(s_queuePackets));
+    if (packets > 0)
+        cfg.queuePackets = size_t(packets);
+
+    return cfg;
+}
+
+//-----------------------------------------------------------------------------
+
+std::string Recorder::m_getPath(const std::string & name)
+{
+    return m_cfg.dir + "/" + name;
+}
+
+//-----------------------------------------------------------------------------
+
+std::string Recorder::m_getSegPath(const std::string & name,
+                                   unsigned int number, bool index)
+{
+    std::stringstream path;
+    path << m_getPath(name) << "/" << std::setfill('0') << std::setw(6)
+         << number << (index ? ".idx" : ".rec");
+    return path.str();
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::m_openSegment(unsigned int number)
+{
+    auto path = m_getSegPath(m_name, number, false);
+    auto indexPath = m_getSegPath(m_name, number, true);
+
+    // Файл сегмента сразу получает полный размер, чтобы отображение не
+    // менялось при записи. Незаписанный хвост заполнен нулями, поэтому
+    // после сбоя чтение останавливается на записи нулевого размера.
+    m_seg = {number, -1, -1, nullptr, 0, 0};
+    m_seg.fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (m_seg.fd != -1 && ftruncate(m_seg.fd, off_t(m_cfg.segmentBytes)) == 0)
+    {
+        auto base = mmap(nullptr, m_cfg.segmentBytes, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, m_seg.fd, 0);
+        if (base != MAP_FAILED)
+            m_seg.base = static_cast<char *>(base);
+    }
+
+    m_seg.indexFd = open(indexPath.c_str(),
+                         O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+    if (!m_seg.base || m_seg.indexFd == -1)
+    {
+        std::stringstream msg;
+        msg << "Can't create recording segment " << path << " (" << errno
+            << ") : " << strerror(errno);
+        LOGGER_ERROR(msg.str());
+
+        m_closeSegment();
+        unlink(path.c_str());
+        unlink(indexPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::m_closeSegment()
+{
+    if (m_seg.base)
+    {
+        munmap(m_seg.base, m_cfg.segmentBytes);
+        m_seg.base = nullptr;
+    }
+
+    if (m_seg.fd != -1)
+    {
+        // Урезать файл до записанных данных.
+        if (ftruncate(m_seg.fd, off_t(m_seg.used)) != 0)
+            LOGGER_WARNING("Can't truncate recording segment");
+        close(m_seg.fd);
+        m_seg.fd = -1;
+    }
+
+    if (m_seg.indexFd != -1)
+    {
+        close(m_seg.indexFd);
+        m_seg.indexFd = -1;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::m_nextSegment()
+{
+    auto number = m_seg.number;
+    m_closed.emplace_back(number, m_seg.used + m_lod.getBytes());
+    m_closeSegment();
+
+    if (!m_openSegment(number + 1) || !m_lod.rotate(number + 1))
+    {
+        // Без сегмента запись продолжать некуда.
+        m_closeSegment();
+        m_recording = false;
+        m_lod.close();
+        return false;
+    }
+
+    m_enforceCap();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::m_enforceCap()
+{
+    // Текущий сегмент учитывается полным размером вместе с текущей частью
+    // уровней детализации.
+    size_t total = m_cfg.segmentBytes + m_lod.getBytes();
+    for (auto it = m_closed.begin(); it != m_closed.end(); it++)
+        total += it->second;
+
+    while (total > m_cfg.maxBytes && m_closed.size())
+    {
+        auto & oldest = m_closed.front();
+        unlink(m_getSegPath(m_name, oldest.first, false).c_str());
+        unlink(m_getSegPath(m_name, oldest.first, true).c_str());
+        lod::Pyramid::remove(m_getPath(m_name), oldest.first);
+        total -= oldest.second;
+        m_closed.pop_front();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::m_write(uint32_t type, uint64_t stamp, const char * data,
+                       size_t size)
+{
+    auto aligned = (sizeof(recHeader_t) + size + s_align - 1) / s_align * s_align;
+    // После последней записи остается место под нулевой заголовок.
+    if (aligned + sizeof(recHeader_t) > m_cfg.segmentBytes)
+    {
+        LOGGER_WARNING("Record is too big for recording segment");
+        return;
+    }
+
+    // Сегмент заполнен - открыть следующий.
+    if (m_seg.used + aligned + sizeof(recHeader_t) > m_cfg.segmentBytes &&
+        !m_nextSegment())
+        return;
+
+    // Разреженный индекс: первая запись сегмента и далее не чаще indexMs.
+    if (!m_seg.used ||
+        stamp >= m_seg.indexStamp + uint64_t(m_cfg.indexMs) * 1000000ULL)
+    {
+        indexEntry_t entry {stamp, m_seg.used};
+        if (write(m_seg.indexFd, &entry, sizeof(entry)) != sizeof(entry))
+            LOGGER_WARNING("Can't write recording index");
+        m_seg.indexStamp = stamp;
+
+        // Сбросить записанные данные на накопитель в фоне.
+        msync(m_seg.base, m_seg.used, MS_ASYNC);
+    }
+
+    recHeader_t header {uint32_t(size), type, stamp};
+    memcpy(m_seg.base + m_seg.used, &header, sizeof(header));
+    memcpy(m_seg.base + m_seg.used + sizeof(header), data, size);
+
+    m_seg.used += aligned;
+    m_records++;
+    m_bytes += size;
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::m_addRow(const dev::region_t & reg, uint64_t stamp)
+{
+    auto base = reg.front().first;
+    auto regs = uint32_t(reg.size());
+
+    // Количество регистров устройства изменилось - начать новый блок.
+    auto chunk = m_chunks.find(base);
+    if (chunk != m_chunks.end() && chunk->second.getRegs() != regs)
+    {
+        m_flushChunk(chunk->second);
+        m_chunks.erase(chunk);
+        chunk = m_chunks.end();
+    }
+
+    if (chunk == m_chunks.end())
+        chunk = m_chunks.emplace(base, col::ChunkBuilder(base, regs, s_chunkRows)).first;
+
+    m_row.resize(regs);
+    for (uint32_t i = 0; i < regs; i++)
+        m_row[i] = reg[i].second;
+
+    chunk->second.add(stamp, m_row.data());
+    if (chunk->second.isFull())
+        m_flushChunk(chunk->second);
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::m_flushChunk(col::ChunkBuilder & chunk)
+{
+    if (!chunk.getRows() || !m_recording.load())
+        return;
+
+    auto stamp = chunk.getFirstStamp();
+    m_chunkBuf.clear();
+    chunk.encode(m_chunkBuf);
+    m_write(s_chunkType, stamp, m_chunkBuf.data(), m_chunkBuf.size());
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::m_drainSamples()
+{
+    ring::pkg_t * pkg;
+    while ((pkg = m_samples.front()))
+    {
+        // Значения, опубликованные до остановки записи, отбрасываются.
+        if (m_recording.load())
+            m_addSamples(*pkg);
+        m_samples.release();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::m_addSamples(const ring::pkg_t & pkg)
+{
+    auto data = pkg.data.data();
+    auto end = data + pkg.data.size();
+
+    uint64_t stamp;
+    memcpy(&stamp, data, sizeof(stamp));
+    data += sizeof(stamp);
+
+    while (data < end)
+    {
+        uint32_t count;
+        memcpy(&count, data, sizeof(count));
+        data += sizeof(count);
+
+        m_sampleRegion.resize(count);
+        memcpy(static_cast<void *>(m_sampleRegion.data()), data,
+               count * sizeof(dev::register_t));
+        data += count * sizeof(dev::register_t);
+
+        for (auto it = m_sampleRegion.begin(); it != m_sampleRegion.end(); it++)
+            m_lod.add(stamp, it->first, it->second);
+
+        if (m_columnar && count)
+            m_addRow(m_sampleRegion, stamp);
+    }
+
+    if (m_columnar)
+        m_flushOldChunks(stamp);
+
+    // Уровни детализации делятся на части вместе с сегментами, поэтому при
+    // медленном заполнении сегмента (например, колоночной записи) сегмент
+    // закрывается, когда часть уровней достигает размера сегмента.
+    if (m_recording.load() && m_lod.getBytes() >= m_cfg.segmentBytes)
+        m_nextSegment();
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::m_flushOldChunks(uint64_t stamp)
+{
+    auto maxAge = uint64_t(m_cfg.chunkMs) * 1000000ULL;
+    for (auto it = m_chunks.begin(); it != m_chunks.end(); it++)
+    {
+        if (it->second.getRows() && stamp - it->second.getFirstStamp() >= maxAge)
+            m_flushChunk(it->second);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+std::vector<unsigned int> Recorder::m_getSegments(const std::string & name)
+{
+    std::vector<unsigned int> segments;
+
+    std::error_code err;
+    for (const auto & entry :
+         std::filesystem::directory_iterator(m_getPath(name), err))
+    {
+        auto file = entry.path();
+        auto stem = file.stem().string();
+        if (file.extension() != ".rec" || !stem.size() ||
+            !std::all_of(stem.begin(), stem.end(), ::isdigit))
+            continue;
+
+        segments.push_back((unsigned int)std::stoul(stem));
+    }
+
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+//-----------------------------------------------------------------------------
+
+std::vector<indexEntry_t> Recorder::m_readIndex(const std::string & name,
+                                                unsigned int number)
+{
+    std::vector<indexEntry_t> index;
+
+    auto fd = open(m_getSegPath(name, number, true).c_str(),
+                   O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return index;
+
+    indexEntry_t entry;
+    while (read(fd, &entry, sizeof(entry)) == sizeof(entry))
+        index.push_back(entry);
+
+    close(fd);
+    return index;
+}
+
+//-----------------------------------------------------------------------------
+
+void Recorder::m_doReplay(Recorder * recorder, std::string name,
+                          bool realtime, uint64_t from)
+{
+    auto segments = recorder->m_getSegments(name);
+
+    // Найти по индексам сегмент и запись, с которых начинается воспроизведение:
+    // последний элемент индекса с меткой не больше from.
+    size_t firstSeg = 0;
+    uint64_t offset = 0;
+    for (size_t i = 0; from && i < segments.size(); i++)
+    {
+        auto index = recorder->m_readIndex(name, segments[i]);
+        if (!index.size() || index.front().stamp > from)
+            break;
+
+        firstSeg = i;
+        offset = 0;
+        for (auto it = index.begin(); it != index.end() && it->stamp <= from; it++)
+            offset = it->offset;
+    }
+
+    // first - метка первого воспроизведенного пакета, start - время его
+    // публикации (для сохранения исходных интервалов).
+    uint64_t first = 0;
+    uint64_t start = 0;
+    uint64_t count = 0;
+    bool completed = true;
+    for (size_t i = firstSeg; completed && i < segments.size(); i++)
+    {
+        completed = recorder->m_replaySegment(name, segments[i],
+                                              i == firstSeg ? offset : 0,
+                                              realtime, from, first, start,
+                                              count);
+    }
+
+    // Сообщить пользователю о завершении воспроизведения.
+    if (completed)
+    {
+        std::stringstream done;
+        done << "REPLAYED" << sep::dataSep << name << sep::dataSep << count;
+        auto str = done.str();
+        recorder->m_publish(ring::type_t::RECORD, str.data(), str.size());
+    }
+
+    recorder->m_replaying = false;
+    recorder->log.trace(__FILE__, EP7TRACE_LEVEL_INFO, (tUINT16)__LINE__,
+                        __FUNCTION__, "Replay thread stopped");
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::m_replaySegment(const std::string & name, unsigned int number,
+                               uint64_t offset, bool realtime, uint64_t from,
+                               uint64_t & first, uint64_t & start,
+                               uint64_t & count)
+{
+    auto fd = open(m_getSegPath(name, number, false).c_str(),
+                   O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return true;
+
+    struct stat st;
+    void * base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        base = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED)
+        return true;
+
+    auto data = static_cast<const char *>(base);
+    auto size = size_t(st.st_size);
+    bool active = true;
+
+    while (offset + sizeof(recHeader_t) <= size)
+    {
+        recHeader_t header;
+        memcpy(&header, data + offset, sizeof(header));
+        // Конец записей (хвост сегмента после сбоя заполнен нулями).
+        if (!header.size || offset + sizeof(header) + header.size > size)
+            break;
+
+        auto payload = data + offset + sizeof(header);
+        offset += (sizeof(header) + header.size + s_align - 1) / s_align * s_align;
+
+        // Блок отсчетов колоночной записи публикуется по отсчетам.
+        if (header.type == s_chunkType)
+        {
+            if (!m_replayChunk(payload, header.size, realtime, from, first,
+                               start, count))
+            {
+                active = false;
+                break;
+            }
+            continue;
+        }
+
+        if (header.stamp < from ||
+            header.type > uint32_t(ring::type_t::FRAME))
+            continue;
+
+        if (!m_pace(header.stamp, realtime, first, start, count) ||
+            !m_publish(ring::type_t(header.type), payload, header.size))
+        {
+            active = false;
+            break;
+        }
+        count++;
+    }
+
+    munmap(base, size);
+    return active;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::m_replayChunk(const char * data, size_t size, bool realtime,
+                             uint64_t from, uint64_t & first, uint64_t & start,
+                             uint64_t & count)
+{
+    col::ChunkReader reader;
+    if (!reader.open(data, size))
+    {
+        LOGGER_WARNING("Skipping corrupted chunk of recording");
+        return true;
+    }
+
+    auto & header = reader.getHeader();
+    m_replayColumns.resize(size_t(header.regs) + 1);
+    for (uint32_t i = 0; i <= header.regs; i++)
+    {
+        if (!reader.decode(i, m_replayColumns[i]) ||
+            m_replayColumns[i].size() != header.rows)
+        {
+            LOGGER_WARNING("Skipping corrupted chunk of recording");
+            return true;
+        }
+    }
+
+    // Каждый отсчет передается пакетом GET в формате compact (базовый адрес
+    // и количество регистров, затем значения), как при записи с fmt,compact.
+    auto & stamps = m_replayColumns.front();
+    for (uint32_t row = 0; row < header.rows; row++)
+    {
+        if (stamps[row] < from)
+            continue;
+
+        m_replayBuf.clear();
+        m_replayBuf.appendHex(header.base);
+        m_replayBuf.append(sep::baseSep);
+        m_replayBuf.appendDec(header.regs);
+        for (uint32_t i = 1; i <= header.regs; i++)
+        {
+            m_replayBuf.append(sep::dataSep);
+            m_replayBuf.appendHex(uint32_t(m_replayColumns[i][row]));
+        }
+
+        if (!m_pace(stamps[row], realtime, first, start, count) ||
+            !m_publish(ring::type_t::STAT, m_replayBuf.data(),
+                       m_replayBuf.size()))
+            return false;
+        count++;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::m_pace(uint64_t stamp, bool realtime, uint64_t & first,
+                      uint64_t & start, uint64_t count)
+{
+    if (!realtime)
+        return true;
+
+    if (!count)
+    {
+        first = stamp;
+        start = timers::now();
+        return true;
+    }
+
+    // Отсчеты блока могут быть старше уже переданных пакетов (блок
+    // записывается после своих отсчетов) - тогда они передаются сразу.
+    return m_sleepUntil(start + (stamp > first ? stamp - first : 0));
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::m_publish(ring::type_t type, const char * data, size_t size)
+{
+    ring::pkg_t * slot;
+    // Поток отправки не успевает - подождать, пакеты записи не теряются.
+    while (!(slot = m_ring.acquire()))
+    {
+        if (!m_replaying.load())
+            return false;
+        usleep(1000);
+    }
+
+    slot->data.append(data, size);
+    slot->type = type;
+    m_ring.commit();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Recorder::m_sleepUntil(uint64_t deadline)
+{
+    // Спать частями, чтобы быстро реагировать на остановку.
+    static const uint64_t sliceNs = 100000000ULL;
+
+    while (m_replaying.load())
+    {
+        auto now = timers::now();
+        if (now >= deadline)
+            return true;
+
+        auto wake = std::min(deadline, now + sliceNs);
+        timespec ts {time_t(wake / 1000000000ULL), long(wake % 1000000000ULL)};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+    }
+
+    return false;
+}
+
+//=============================================================================
+
+} // namespace rec
@@ -0,0 +1,279 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+//-----------------------------------------------------------------------------
+
+#include <list>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <sstream>
+
+#include "ring.h"
+#include "lod.h"
+#include "column.h"
+#include "device.h"
+#include "logger-library/logger.h"
+
+//-----------------------------------------------------------------------------
+
+namespace rec
+{
+
+//=============================================================================
+
+// Заголовок записи пакета в сегменте.
+typedef struct recHeader
+{
+    uint32_t size;      // Размер данных пакета (0 - записей в сегменте больше нет).
+    uint32_t type;      // Тип пакета (ring::type_t).
+    uint64_t stamp;     // Время публикации пакета (нс, CLOCK_MONOTONIC).
+} recHeader_t;
+
+// Элемент разреженного индекса времени сегмента.
+typedef struct indexEntry
+{
+    uint64_t stamp;     // Время публикации пакета записи.
+    uint64_t offset;    // Смещение записи в сегменте.
+} indexEntry_t;
+
+//-----------------------------------------------------------------------------
+
+// Запись пакетов статистики на накопитель платы без подключенного клиента.
+// Каждая запись - каталог с сегментами: пакеты дописываются в отображенный в
+// память файл сегмента, а в файл индекса сегмента периодически добавляется
+// метка времени и смещение записи. При заполнении сегмента открывается новый,
+// при превышении общего размера записи удаляются самые старые сегменты.
+// Одновременно по значениям регистров строится пирамида уровней детализации
+// для быстрого обзора записи.
+// Запись можно воспроизвести: пакеты публикуются в собственную очередь,
+// которую поток отправки читает вместе с очередями статистики.
+class Recorder
+{
+public:
+
+    // eventFd - дескриптор eventfd, в который оповещается поток отправки.
+    Recorder(int eventFd);
+    ~Recorder();
+
+    //-------------------------------------------------------------------------
+
+    // Начать запись (columnar - данные устройств хранятся колоночными блоками
+    // отсчетов вместо пакетов; false - запись уже идет или не удалось создать
+    // сегмент).
+    bool start(const std::string & name, bool columnar);
+    // Остановить запись (info - имя, количество записей и байт данных).
+    bool stop(std::stringstream & info);
+    // Проверить идет ли запись.
+    bool isRecording();
+    // Вернуть список записей (имя, формат, сегменты, байты, первая и
+    // последняя метки).
+    void list(std::stringstream & pkg);
+    // Начать воспроизведение записи с метки времени from (realtime - с
+    // исходными интервалами между пакетами, иначе с максимальной скоростью).
+    bool replay(const std::string & name, bool realtime, uint64_t from);
+    // Остановить воспроизведение (false - воспроизведение не шло).
+    bool stopReplay();
+    // Проверить допустимо ли имя записи.
+    static bool isValidName(const std::string & name);
+    // Получить интервалы уровня детализации записи для регистра addr в
+    // диапазоне [from, to] (не больше points интервалов).
+    bool getLod(const std::string & name, uint32_t addr, uint64_t from,
+                uint64_t to, size_t points, unsigned int & level,
+                uint64_t & bucketNs, std::vector<lod::bucket_t> & buckets);
+
+    //-------------------------------------------------------------------------
+
+    // Записать пакеты (вызывается потоком отправки).
+    void append(ring::pkg_t ** pkgs, size_t count);
+    // Передать значения регистров тика потоку отправки для уровней
+    // детализации и блоков отсчетов записи (вызывается потоком сбора
+    // статистики, не блокируется на накопителе).
+    void addSamples(uint64_t stamp, const dev::devsRegion_t & region);
+    // Добавить переданные значения регистров в запись (вызывается потоком
+    // отправки).
+    void writeSamples();
+    // Получить до max самых старых воспроизводимых пакетов (вызывается потоком
+    // отправки).
+    size_t peek(ring::pkg_t ** pkgs, size_t max);
+    // Освободить воспроизведенные пакеты после отправки (вызывается потоком
+    // отправки).
+    void release(size_t count);
+
+private:
+
+    // Класс логирования.
+    logger::Logger log;
+
+    //-------------------------------------------------------------------------
+
+    // Параметры записи.
+    typedef struct recorderCfg
+    {
+        std::string dir;        // Каталог записей.
+        size_t segmentBytes;    // Размер сегмента.
+        size_t maxBytes;        // Максимальный размер записи.
+        unsigned int indexMs;   // Интервал меток времени в индексе.
+        unsigned int lodMs;     // Интервал уровня детализации 0.
+        unsigned int chunkMs;   // Максимальное время накопления блока.
+        size_t queuePackets;    // Количество воспроизводимых пакетов в очереди.
+    } recorderCfg_t;
+
+    // Параметры по умолчанию.
+    static constexpr const char * s_dir = "/opt/control/records";
+    static const size_t s_segmentMb = 16;
+    static const size_t s_maxMb = 1024;
+    static const unsigned int s_indexMs = 1000;
+    static const unsigned int s_lodMs = 1000;
+    static const unsigned int s_chunkMs = 10000;
+    static const size_t s_queuePackets = 64;
+    // Выравнивание записей в сегменте.
+    static const size_t s_align = 8;
+    // Максимальный размер воспроизводимого пакета.
+    static const size_t s_maxPkgSize = 8192;
+    // Максимальная длина имени записи.
+    static const size_t s_maxName = 64;
+    // Файл формата записи в каталоге записи.
+    static constexpr const char * s_formatFile = "format";
+    // Тип записи сегмента для блока отсчетов (вне диапазона ring::type_t).
+    static const uint32_t s_chunkType = 0x100;
+    // Количество отсчетов в блоке.
+    static const uint32_t s_chunkRows = 1024;
+    // Начальный размер буфера кодирования блока.
+    static const size_t s_chunkBufSize = 65536;
+    // Количество слотов и начальный размер слота очереди значений регистров.
+    static const size_t s_sampleSlots = 512;
+    static const size_t s_sampleSlotSize = 1024;
+
+    // Прочитать параметры из конфигурационного файла.
+    recorderCfg_t m_readConfig();
+
+    // Параметры (читаются из конфигурационного файла).
+    recorderCfg_t m_cfg;
+
+    //-------------------------------------------------------------------------
+
+    // Открытый для записи сегмент.
+    typedef struct segment
+    {
+        unsigned int number;    // Номер сегмента в записи.
+        int fd;                 // Дескриптор файла сегмента.
+        int indexFd;            // Дескриптор файла индекса.
+        char * base;            // Отображенный в память файл.
+        size_t used;            // Количество записанных байт.
+        uint64_t indexStamp;    // Метка последнего элемента индекса.
+    } segment_t;
+
+    // Для работы с записью (поток отправки и поток команд; поток сбора
+    // статистики только публикует значения в m_samples).
+    std::mutex m_mutex;
+    // Переменная, обозначающая, что идет запись.
+    std::atomic<bool> m_recording;
+    // Имя текущей записи.
+    std::string m_name;
+    // Флаг колоночной записи данных устройств.
+    bool m_columnar;
+    // Текущий сегмент.
+    segment_t m_seg;
+    // Номера и размеры закрытых сегментов записи вместе с частями уровней
+    // детализации (от старых к новым).
+    std::list<std::pair<unsigned int, size_t>> m_closed;
+    // Количество записей (пакетов и блоков) и байт данных.
+    uint64_t m_records;
+    uint64_t m_bytes;
+    // Уровни детализации текущей записи.
+    lod::Pyramid m_lod;
+    // Накапливаемые блоки отсчетов по базовым адресам устройств.
+    std::map<uint32_t, col::ChunkBuilder> m_chunks;
+    // Значения регистров отсчета (используется повторно).
+    std::vector<uint32_t> m_row;
+    // Буфер кодирования блока (используется повторно).
+    buffer::Buffer m_chunkBuf;
+    // Очередь значений регистров тиков (поток сбора статистики -
+    // производитель, потребитель - поток отправки или поток команд под
+    // m_mutex). Слот - метка тика, затем для каждого устройства количество
+    // регистров и пары (адрес, значение).
+    ring::PkgRing m_samples;
+    // Количество тиков, не поместившихся в очередь.
+    std::atomic<uint64_t> m_sampleDrops;
+    // Значения устройства из слота (используются повторно).
+    dev::region_t m_sampleRegion;
+
+    // Получить путь к каталогу записи.
+    std::string m_getPath(const std::string & name);
+    // Получить путь к файлу сегмента или индекса.
+    std::string m_getSegPath(const std::string & name, unsigned int number,
+                             bool index);
+    // Открыть новый сегмент записи.
+    bool m_openSegment(unsigned int number);
+    // Закрыть текущий сегмент (файл урезается до записанных данных).
+    void m_closeSegment();
+    // Закрыть текущий сегмент и открыть следующий вместе с частью уровней
+    // детализации (false - запись остановлена).
+    bool m_nextSegment();
+    // Удалить самые старые сегменты вместе с их частями уровней детализации,
+    // пока запись превышает ограничение.
+    void m_enforceCap();
+    // Записать запись (пакет или блок) в текущий сегмент.
+    void m_write(uint32_t type, uint64_t stamp, const char * data, size_t size);
+    // Добавить отсчет устройства в блок (блок записывается при заполнении).
+    void m_addRow(const dev::region_t & reg, uint64_t stamp);
+    // Записать накопленный блок отсчетов.
+    void m_flushChunk(col::ChunkBuilder & chunk);
+    // Добавить в запись все значения из очереди (m_mutex захвачен).
+    void m_drainSamples();
+    // Добавить значения регистров тика из слота очереди.
+    void m_addSamples(const ring::pkg_t & pkg);
+    // Записать блоки, первый отсчет которых старше chunkMs (иначе отсчеты
+    // медленных устройств долго хранились бы только в памяти).
+    void m_flushOldChunks(uint64_t stamp);
+
+    //-------------------------------------------------------------------------
+
+    // Получить номера сегментов записи в порядке возрастания.
+    std::vector<unsigned int> m_getSegments(const std::string & name);
+    // Прочитать индекс сегмента.
+    std::vector<indexEntry_t> m_readIndex(const std::string & name,
+                                          unsigned int number);
+
+    //-------------------------------------------------------------------------
+
+    // Очередь воспроизводимых пакетов (поток воспроизведения - производитель,
+    // поток отправки - потребитель).
+    ring::PkgRing m_ring;
+    // Поток воспроизведения.
+    std::thread m_replayThread;
+    // Переменная, обозначающая, что идет воспроизведение.
+    std::atomic<bool> m_replaying;
+    // Распакованные колонки блока и текст пакета отсчета (используются
+    // повторно потоком воспроизведения).
+    std::vector<std::vector<uint64_t>> m_replayColumns;
+    buffer::Buffer m_replayBuf;
+    // Функция воспроизведения.
+    static void m_doReplay(Recorder * recorder, std::string name,
+                           bool realtime, uint64_t from);
+    // Воспроизвести сегмент (false - воспроизведение прервано).
+    bool m_replaySegment(const std::string & name, unsigned int number,
+                         uint64_t offset, bool realtime, uint64_t from,
+                         uint64_t & first, uint64_t & start, uint64_t & count);
+    // Воспроизвести блок отсчетов пакетами GET (false - воспроизведение
+    // прервано).
+    bool m_replayChunk(const char * data, size_t size, bool realtime,
+                       uint64_t from, uint64_t & first, uint64_t & start,
+                       uint64_t & count);
+    // Выдержать исходный интервал перед публикацией записи с меткой stamp
+    // (false - воспроизведение прервано).
+    bool m_pace(uint64_t stamp, bool realtime, uint64_t & first,
+                uint64_t & start, uint64_t count);
+    // Опубликовать воспроизводимый пакет (ждет свободного слота).
+    bool m_publish(ring::type_t type, const char * data, size_t size);
+    // Ожидать наступления времени (false - воспроизведение прервано).
+    bool m_sleepUntil(uint64_t deadline);
+};
+
+//=============================================================================
+
+} // namespace rec
+
+#endif // RECORDER_H
@@ -0,0 +1,200 @@
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "ring.h"
+#include "timers.h"
+
+//-----------------------------------------------------------------------------
+
+namespace ring
+{
+
+//=============================================================================
+
+PkgRing::PkgRing(size_t slots, size_t slotCapacity, int eventFd)
+    : m_mask(m_roundSlots(slots) - 1), m_head(0), m_tail(0), m_bytes(0),
+      m_eventFd(eventFd), m_ownEventFd(eventFd == -1)
+{
+    // Выделить память под все слоты заранее.
+    m_slots.reserve(m_mask + 1);
+    for (size_t i = 0; i <= m_mask; i++)
+        m_slots.emplace_back(slotCapacity);
+
+    // Оповещения пишутся в eventfd другой очереди.
+    if (!m_ownEventFd)
+        return;
+
+    m_eventFd = eventfd(0, EFD_CLOEXEC);
+    if (m_eventFd == -1)
+    {
+        std::stringstream msg;
+        msg << "Error creating eventfd (" << errno << ") : " << strerror(errno);
+        LOGGER_ERROR(msg.str());
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+PkgRing::~PkgRing()
+{
+    if (m_ownEventFd && m_eventFd != -1)
+        close(m_eventFd);
+}
+
+//-----------------------------------------------------------------------------
+
+pkg_t * PkgRing::acquire()
+{
+    auto head = m_head.load(std::memory_order_relaxed);
+    auto tail = m_tail.load(std::memory_order_acquire);
+
+    // Очередь заполнена.
+    if (head - tail >= m_slots.size())
+        return nullptr;
+
+    auto slot = &m_slots[head & m_mask];
+    slot->data.clear();
+    slot->type = type_t::STAT;
+    slot->subs.clear();
+    return slot;
+}
+
+//-----------------------------------------------------------------------------
+
+void PkgRing::commit()
+{
+    auto head = m_head.load(std::memory_order_relaxed);
+    m_bytes.fetch_add(m_slots[head & m_mask].data.size(),
+                      std::memory_order_relaxed);
+    // Время публикации для измерения задержки до отправки.
+    m_slots[head & m_mask].stamp = timers::now();
+    // Опубликовать слот (данные слота видны потребителю после этой записи).
+    m_head.store(head + 1, std::memory_order_release);
+
+    // Оповестить потребителя.
+    m_notify();
+}
+
+//-----------------------------------------------------------------------------
+
+pkg_t * PkgRing::front()
+{
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    auto head = m_head.load(std::memory_order_acquire);
+
+    // Очередь пуста.
+    if (tail == head)
+        return nullptr;
+
+    return &m_slots[tail & m_mask];
+}
+
+//-----------------------------------------------------------------------------
+
+size_t PkgRing::peek(pkg_t ** pkgs, size_t max)
+{
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    auto head = m_head.load(std::memory_order_acquire);
+
+    size_t count = 0;
+    for (; tail != head && count < max; tail++, count++)
+        pkgs[count] = &m_slots[tail & m_mask];
+
+    return count;
+}
+
+//-----------------------------------------------------------------------------
+
+void PkgRing::release(size_t count)
+{
+    auto tail = m_tail.load(std::memory_order_relaxed);
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; i++)
+        bytes += m_slots[(tail + i) & m_mask].data.size();
+
+    m_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    // Вернуть слоты производителю.
+    m_tail.store(tail + count, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+
+bool PkgRing::wait()
+{
+    uint64_t events;
+
+    // Чтение сбрасывает счетчик оповещений.
+    auto ret = read(m_eventFd, &events, sizeof(events));
+    if (ret != sizeof(events))
+    {
+        if (errno != EINTR)
+            LOGGER_ERROR("Can't wait for packets");
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void PkgRing::wake()
+{
+    m_notify();
+}
+
+//-----------------------------------------------------------------------------
+
+size_t PkgRing::size()
+{
+    // Сначала читается хвост, чтобы разность не стала отрицательной.
+    auto tail = m_tail.load(std::memory_order_acquire);
+    return m_head.load(std::memory_order_acquire) - tail;
+}
+
+//-----------------------------------------------------------------------------
+
+size_t PkgRing::bytes()
+{
+    return m_bytes.load(std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+
+size_t PkgRing::slots()
+{
+    return m_slots.size();
+}
+
+//-----------------------------------------------------------------------------
+
+int PkgRing::eventFd()
+{
+    return m_eventFd;
+}
+
+//-----------------------------------------------------------------------------
+
+size_t PkgRing::m_roundSlots(size_t slots)
+{
+    size_t rounded = 1;
+    while (rounded < slots)
+        rounded <<= 1;
+
+    return rounded;
+}
+
+//-----------------------------------------------------------------------------
+
+void PkgRing::m_notify()
+{
+    uint64_t event = 1;
+    if (write(m_eventFd, &event, sizeof(event)) != sizeof(event))
+        LOGGER_ERROR("Can't notify packet consumer");
+}
+
+//=============================================================================
+
+} // namespace ring
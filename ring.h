@@ -0,0 +1,139 @@
+#ifndef RING_H
+#define RING_H
+
+//-----------------------------------------------------------------------------
+
+#include <atomic>
+#include <vector>
+
+#include "buffer.h"
+#include "logger-library/logger.h"
+
+//-----------------------------------------------------------------------------
+
+namespace ring
+{
+
+//=============================================================================
+
+// Тип пакета в очереди (определяет заголовок пакета для пользователя).
+enum class type_t
+{
+    STAT,       // Данные статистики.
+    MERGED,     // Накопленные при переполнении очереди данные.
+    HIRATE,     // Пачка отсчетов высокочастотного считывания.
+    AGG,        // Агрегаты регистров за окно.
+    EVENT,      // События сработавших триггеров.
+    CAPTURE,    // Часть осциллографического захвата.
+    RECORD,     // Состояние воспроизведения записи.
+    HGRAM,      // Гистограммы значений регистров за период.
+    DERIVED,    // Значения производных каналов.
+    FRAME       // Данные устройств и файлов API одного тика.
+};
+
+// Пакет в очереди.
+struct pkg_t
+{
+    buffer::Buffer data;                // Данные пакета.
+    type_t type;                        // Тип пакета.
+    std::vector<unsigned int> subs;     // Идентификаторы подписок, данные которых есть в пакете.
+    uint64_t stamp;                     // Время публикации (нс, CLOCK_MONOTONIC).
+
+    pkg_t(size_t capacity) : data(capacity), type(type_t::STAT), stamp(0) {}
+};
+
+//-----------------------------------------------------------------------------
+
+// Кольцевая очередь пакетов для одного производителя и одного потребителя.
+// Слоты (буферы) выделяются один раз при создании и используются повторно,
+// поэтому передача пакета не требует ни блокировок, ни выделения памяти.
+// Потребитель ожидает пакеты на eventfd, в который производитель пишет после
+// публикации пакета (счетчик eventfd не теряет оповещения). Несколько очередей
+// могут использовать eventfd одной из них, чтобы потребитель ожидал их вместе.
+class PkgRing
+{
+public:
+
+    // Количество слотов округляется вверх до степени двойки.
+    PkgRing(size_t slots, size_t slotCapacity, int eventFd = -1);
+    ~PkgRing();
+
+    //-------------------------------------------------------------------------
+
+    // Получить свободный слот для заполнения (nullptr - очередь заполнена).
+    // Вызывается только производителем.
+    pkg_t * acquire();
+    // Опубликовать заполненный слот и оповестить потребителя.
+    // Вызывается только производителем.
+    void commit();
+
+    //-------------------------------------------------------------------------
+
+    // Получить самый старый пакет (nullptr - очередь пуста).
+    // Вызывается только потребителем.
+    pkg_t * front();
+    // Получить до max самых старых пакетов (возвращает количество).
+    // Вызывается только потребителем.
+    size_t peek(pkg_t ** pkgs, size_t max);
+    // Освободить слоты самых старых пакетов.
+    // Вызывается только потребителем.
+    void release(size_t count = 1);
+    // Ожидать оповещения о новых пакетах (блокирующая функция).
+    // Вызывается только потребителем.
+    bool wait();
+    // Прервать ожидание потребителя без публикации пакета.
+    void wake();
+
+    //-------------------------------------------------------------------------
+
+    // Получить количество пакетов в очереди.
+    size_t size();
+    // Получить количество байт данных в очереди.
+    size_t bytes();
+    // Получить количество слотов.
+    size_t slots();
+    // Получить дескриптор eventfd для ожидания пакетов.
+    int eventFd();
+
+private:
+
+    // Класс логирования.
+    logger::Logger log;
+
+    //-------------------------------------------------------------------------
+
+    // Размер строки кэша (для разнесения индексов производителя и потребителя).
+    static const size_t s_cacheLine = 64;
+
+    //-------------------------------------------------------------------------
+
+    // Слоты очереди.
+    std::vector<pkg_t> m_slots;
+    // Маска номера слота. Количество слотов - степень двойки, поэтому номер
+    // слота не сбивается при переполнении индексов (size_t на целевой
+    // платформе 32-битный).
+    size_t m_mask;
+    // Индекс следующего слота для записи (изменяется только производителем).
+    alignas(s_cacheLine) std::atomic<size_t> m_head;
+    // Индекс следующего слота для чтения (изменяется только потребителем).
+    alignas(s_cacheLine) std::atomic<size_t> m_tail;
+    // Количество байт данных в опубликованных пакетах.
+    alignas(s_cacheLine) std::atomic<size_t> m_bytes;
+    // Дескриптор eventfd для оповещения потребителя.
+    int m_eventFd;
+    // Флаг, что eventfd создан этой очередью (и закрывается ею).
+    bool m_ownEventFd;
+
+    //-------------------------------------------------------------------------
+
+    // Записать событие в eventfd.
+    void m_notify();
+    // Округлить количество слотов вверх до степени двойки.
+    static size_t m_roundSlots(size_t slots);
+};
+
+//=============================================================================
+
+} // namespace ring
+
+#endif // RING_H
@@ -0,0 +1,281 @@
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <string.h>
+
+#include "sequence.h"
+#include "timers.h"
+
+//-----------------------------------------------------------------------------
+
+namespace sequence
+{
+
+//=============================================================================
+
+Sequencer::Sequencer()
+    : m_activated(true), m_pending(false), m_steps(nullptr),
+      m_results(nullptr), m_ret(false)
+{
+    m_thread = std::thread(m_loop, this);
+    if (!m_thread.joinable())
+    {
+        LOGGER_ERROR("Can't start sequencer thread");
+        return;
+    }
+
+    // Установить приоритет реального времени.
+    m_setRealTime();
+    LOGGER_INFO("Sequencer started in thread");
+}
+
+//-----------------------------------------------------------------------------
+
+Sequencer::~Sequencer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_activated = false;
+    }
+    m_cv.notify_all();
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+//-----------------------------------------------------------------------------
+
+bool Sequencer::run(steps_t & steps, results_t & results)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // Передать последовательность потоку реального времени.
+    m_steps = &steps;
+    m_results = &results;
+    m_pending = true;
+    m_cv.notify_all();
+
+    // Дождаться завершения выполнения.
+    m_cv.wait(lock, [this] { return !m_pending || !m_activated; });
+
+    return m_ret && !m_pending;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Sequencer::isValid(steps_t & steps)
+{
+    if (!steps.size() || steps.size() > m_maxSteps)
+        return false;
+
+    // Поток реального времени не должен быть занят слишком долго. Каждый
+    // шаг проверяется до суммирования, а сумма ведется в 64 битах, чтобы
+    // большие времена (long - 32 бита на ARM) не переполнили ее.
+    int64_t duration = 0;
+    for (auto it = steps.begin(); it != steps.end(); it++)
+    {
+        if (it->us < 0 || it->us > m_maxDurationUs)
+            return false;
+
+        if (it->type == step_t::WAIT || it->type == step_t::POLL)
+            duration += it->us;
+    }
+
+    return duration <= m_maxDurationUs;
+}
+
+//-----------------------------------------------------------------------------
+
+void Sequencer::m_loop(Sequencer * seq)
+{
+    std::unique_lock<std::mutex> lock(seq->m_mutex);
+
+    while (true)
+    {
+        seq->m_cv.wait(lock, [seq] { return seq->m_pending || !seq->m_activated; });
+        if (!seq->m_activated)
+            break;
+
+        // Выполнить последовательность.
+        seq->m_ret = seq->m_execute(*seq->m_steps, *seq->m_results);
+
+        // Оповестить ждущий поток о завершении.
+        seq->m_pending = false;
+        seq->m_cv.notify_all();
+    }
+
+    seq->log.trace(__FILE__, EP7TRACE_LEVEL_INFO, (tUINT16)__LINE__,
+                   __FUNCTION__, "Sequencer thread stopped");
+}
+
+//-----------------------------------------------------------------------------
+
+void Sequencer::m_setRealTime()
+{
+    struct sched_param param;
+    param.sched_priority = m_rtPriority;
+
+    auto ret = pthread_setschedparam(m_thread.native_handle(), SCHED_FIFO,
+                                     &param);
+    if (ret != 0)
+    {
+        std::stringstream msg;
+        msg << "Can't set real-time priority for sequencer (" << ret
+            << ") : " << strerror(ret);
+        LOGGER_WARNING(msg.str());
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Sequencer::m_mapDevs(steps_t & steps, devs_t & devs)
+{
+    for (auto it = steps.begin(); it != steps.end(); it++)
+    {
+        if (it->type == step_t::WAIT)
+            continue;
+
+        // Регистр уже отображен.
+        if (devs.find(it->addr) != devs.end())
+            continue;
+
+        dev::devInfo_t devInfo {it->addr, 1};
+        devs[it->addr] = std::make_unique<dev::Device>(devInfo);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool Sequencer::m_execute(steps_t & steps, results_t & results)
+{
+    devs_t devs;
+    dev::region_t region(1);
+
+    results.resize(0);
+    results.reserve(steps.size());
+
+    // Отображение выполняется заранее, чтобы не влиять на время шагов.
+    m_mapDevs(steps, devs);
+
+    auto start = m_now();
+    for (auto it = steps.begin(); it != steps.end(); it++)
+    {
+        result_t result {it->type, it->addr, it->value, 0};
+
+        switch (it->type)
+        {
+        case step_t::WRITE:
+            if (!devs[it->addr]->write(it->value))
+                return false;
+            break;
+
+        case step_t::READ:
+            if (!devs[it->addr]->read(region))
+                return false;
+            result.value = region[0].second;
+            break;
+
+        case step_t::WAIT:
+        {
+            // Ожидание отсчитывается от окончания предыдущего шага.
+            auto deadline = m_addUs(m_now(), it->us);
+            m_sleepUntil(deadline);
+            result.value = uint32_t(it->us);
+            break;
+        }
+
+        case step_t::POLL:
+        {
+            auto ret = m_poll(*devs[it->addr], *it, result.value);
+            auto now = m_now();
+            result.us = m_diffUs(start, now);
+            results.push_back(result);
+            // Условие не выполнилось до таймаута - прервать последовательность.
+            if (!ret)
+                return false;
+            continue;
+        }
+        }
+
+        auto now = m_now();
+        result.us = m_diffUs(start, now);
+        results.push_back(result);
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Sequencer::m_poll(dev::Device & dev, stepData_t & step, uint32_t & value)
+{
+    dev::region_t region(1);
+    auto deadline = m_addUs(m_now(), step.us);
+    auto next = m_now();
+
+    while (true)
+    {
+        if (!dev.read(region))
+            return false;
+
+        value = region[0].second;
+        if ((value & step.mask) == step.value)
+            return true;
+
+        auto now = m_now();
+        if (m_diffUs(deadline, now) >= 0)
+            return false;
+
+        // Следующее чтение через фиксированный период (без накопления ошибки).
+        next = m_addUs(next, m_pollPeriodUs);
+        m_sleepUntil(next);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+struct timespec Sequencer::m_now()
+{
+    auto ns = timers::now();
+    struct timespec ts;
+    ts.tv_sec = time_t(ns / 1000000000ULL);
+    ts.tv_nsec = long(ns % 1000000000ULL);
+    return ts;
+}
+
+//-----------------------------------------------------------------------------
+
+struct timespec Sequencer::m_addUs(struct timespec ts, long us)
+{
+    ts.tv_sec += us / 1000000;
+    ts.tv_nsec += (us % 1000000) * 1000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    return ts;
+}
+
+//-----------------------------------------------------------------------------
+
+long long Sequencer::m_diffUs(struct timespec & from, struct timespec & to)
+{
+    return (long long)(to.tv_sec - from.tv_sec) * 1000000 +
+           (to.tv_nsec - from.tv_nsec) / 1000;
+}
+
+//-----------------------------------------------------------------------------
+
+void Sequencer::m_sleepUntil(struct timespec & deadline)
+{
+    // Повторить сон, если он был прерван сигналом.
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr)
+           == EINTR)
+    {}
+}
+
+//=============================================================================
+
+} // namespace sequence
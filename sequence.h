@@ -0,0 +1,142 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+//-----------------------------------------------------------------------------
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <time.h>
+
+#include "device.h"
+#include "logger-library/logger.h"
+
+//-----------------------------------------------------------------------------
+
+namespace sequence
+{
+
+//=============================================================================
+
+// Тип шага последовательности.
+enum class step_t
+{
+    WRITE,      // Записать значение в регистр.
+    READ,       // Прочитать регистр.
+    WAIT,       // Подождать заданное количество микросекунд.
+    POLL        // Ждать, пока (значение & маска) == ожидаемое, или таймаута.
+};
+
+// Шаг последовательности.
+typedef struct stepData
+{
+    step_t type;        // Тип шага.
+    uint32_t addr;      // Адрес регистра (WRITE, READ, POLL).
+    uint32_t value;     // Значение для записи или ожидаемое значение (WRITE, POLL).
+    uint32_t mask;      // Маска проверяемых битов (POLL).
+    long us;            // Время ожидания или таймаут в микросекундах (WAIT, POLL).
+} stepData_t;
+// Последовательность шагов.
+typedef std::vector<stepData_t> steps_t;
+
+// Результат выполнения шага.
+typedef struct result
+{
+    step_t type;        // Тип шага.
+    uint32_t addr;      // Адрес регистра.
+    uint32_t value;     // Записанное или прочитанное значение (для WAIT - время ожидания).
+    long long us;       // Время завершения шага от начала последовательности в микросекундах.
+} result_t;
+// Результаты выполнения последовательности.
+typedef std::vector<result_t> results_t;
+
+//-----------------------------------------------------------------------------
+
+class Sequencer
+{
+public:
+
+    Sequencer();
+    ~Sequencer();
+
+    //-------------------------------------------------------------------------
+
+    // Выполнить последовательность в потоке реального времени (блокирующая функция).
+    // Возвращает false, если последовательность прервана (ошибка или таймаут POLL).
+    bool run(steps_t & steps, results_t & results);
+    // Проверить допустима ли последовательность (количество шагов и длительность).
+    bool isValid(steps_t & steps);
+
+private:
+
+    // Класс логирования.
+    logger::Logger log;
+
+    //-------------------------------------------------------------------------
+
+    // Максимальное количество шагов в последовательности.
+    const size_t m_maxSteps = 256;
+    // Максимальная суммарная длительность ожиданий и таймаутов (мкс).
+    const long m_maxDurationUs = 1000000;
+    // Период опроса регистра в шаге POLL (мкс).
+    const long m_pollPeriodUs = 10;
+    // Приоритет потока реального времени (SCHED_FIFO).
+    const int m_rtPriority = 50;
+
+    //-------------------------------------------------------------------------
+
+    // Поток выполнения последовательностей.
+    std::thread m_thread;
+    // Для блокировки при передаче последовательности потоку.
+    std::mutex m_mutex;
+    // Для оповещения о новой последовательности и о завершении выполнения.
+    std::condition_variable m_cv;
+    // Флаг работы потока.
+    bool m_activated;
+    // Флаг наличия последовательности для выполнения.
+    bool m_pending;
+    // Последовательность для выполнения.
+    steps_t * m_steps;
+    // Результаты выполнения.
+    results_t * m_results;
+    // Результат выполнения (false - последовательность прервана).
+    bool m_ret;
+
+    //-------------------------------------------------------------------------
+
+    // Отображенные устройства по адресам регистров.
+    typedef std::map<uint32_t, std::unique_ptr<dev::Device>> devs_t;
+
+    //-------------------------------------------------------------------------
+
+    // Функция потока выполнения последовательностей.
+    static void m_loop(Sequencer * seq);
+    // Установить приоритет реального времени для потока.
+    void m_setRealTime();
+    // Отобразить все регистры последовательности до начала выполнения.
+    void m_mapDevs(steps_t & steps, devs_t & devs);
+    // Выполнить последовательность.
+    bool m_execute(steps_t & steps, results_t & results);
+    // Выполнить шаг POLL.
+    bool m_poll(dev::Device & dev, stepData_t & step, uint32_t & value);
+
+    //-------------------------------------------------------------------------
+
+    // Получить текущее время CLOCK_MONOTONIC.
+    static struct timespec m_now();
+    // Добавить микросекунды ко времени.
+    static struct timespec m_addUs(struct timespec ts, long us);
+    // Разница между временами в микросекундах.
+    static long long m_diffUs(struct timespec & from, struct timespec & to);
+    // Заснуть до абсолютного времени CLOCK_MONOTONIC.
+    static void m_sleepUntil(struct timespec & deadline);
+};
+
+//=============================================================================
+
+} // namespace sequence
+
+#endif // SEQUENCE_H
@@ -1,9 +1,13 @@
 #include <iostream>
 #include <algorithm>
 #include <iomanip>
+#include <math.h>
+#include <string.h>
 
 #include "statistic.h"
 #include "common.h"
+#include "config-library/iiniparams.h"
+#include "config-library/ciniparser.h"
 
 //-----------------------------------------------------------------------------
 
@@ -12,16 +16,48 @@ namespace statistic
 
 //=============================================================================
 
-Statistic::Statistic(std::condition_variable * notify)
-    : m_pkg(notify), m_activated(false)
-{}
+const std::map<std::string, overflow_t> Statistic::s_overflows =
+{
+    {"drop-oldest", overflow_t::DROP_OLDEST},
+    {"drop-newest", overflow_t::DROP_NEWEST},
+    {"merge", overflow_t::MERGE}
+};
+
+//-----------------------------------------------------------------------------
+
+Statistic::Statistic()
+    : m_queueCfg(m_readQueueConfig()),
+      // Запас слотов нужен для DROP_OLDEST: старые пакеты отбрасывает поток
+      // отправки, а поток сбора статистики при этом не ждет.
+      m_dataQ(m_queueCfg.packets * 2, s_slotCapacity),
+      m_hirate(m_dataQ.eventFd()), m_recorder(m_dataQ.eventFd()),
+      m_readCnt(0), m_hirateCnt(0),
+      m_usedIds(s_maxSubs, false),
+      m_drops(new std::atomic<uint64_t>[s_maxSubs]), m_dropsTotal(0),
+      m_merged(false), m_sentCnt(0), m_latencySum(0), m_latencyMax(0),
+      m_workersCfg(m_readWorkersConfig()),
+      m_pool(m_workersCfg.threads, m_workersCfg.cpus), m_jobsCnt(0),
+      m_format(format_t::LEGACY), m_encoding(encoding_t::TEXT),
+      m_framing(framing_t::SPLIT),
+      m_nextTrigger(1), m_nextCapture(1), m_loadWakes(0), m_loadPeriods(0),
+      m_loadPeriodsMax(0), m_loadBusy(0), m_loadBusyMax(0), m_activated(false),
+      m_tick(0), m_tickStamp(0)
+{
+    for (unsigned int i = 0; i < s_maxSubs; i++)
+        m_drops[i] = 0;
+
+    m_readDerivedConfig();
+}
 
 //-----------------------------------------------------------------------------
 
 Statistic::~Statistic()
 {
     m_activated = false;
-    m_statThread.join();
+    m_timer.wake();
+    // Поток мог быть уже остановлен командой STOP или удалением устройств.
+    if (m_statThread.joinable())
+        m_statThread.join();
 
     // Очистить память класса устройств.
     std::lock_guard<std::mutex> lock(m_dataMutex);
@@ -37,12 +73,24 @@ Statistic::~Statistic()
 
 //-----------------------------------------------------------------------------
 
-bool Statistic::addDev(dev::devInfo_t & dev, timers::hz_t hz)
+bool Statistic::addDev(dev::devInfo_t & dev, timers::hz_t hz,
+                       const dev::subOpts_t & opts)
 {
-    // Преобразовать Гц в тики.
-    auto ticks = m_timer.hzToTicks(hz);
-    // Нельзя добавить устройство с таким количеством тиков.
-    if (!ticks)
+    // Частоты выше 100 Гц обслуживаются высокочастотным считыванием.
+    if (m_hirate.isHighRate(hz))
+    {
+        if (m_hasSubOpts(opts))
+        {
+            LOGGER_ERROR("Subscription options aren't supported for high-rate sampling");
+            return false;
+        }
+        return m_addHighRate(dev, hz);
+    }
+
+    // Преобразовать Гц в период.
+    auto period = m_timer.hzToPeriod(hz);
+    // Нельзя добавить устройство с таким периодом.
+    if (!period)
         return false;
 
     std::lock_guard<std::mutex> lock(m_dataMutex);
@@ -55,8 +103,27 @@ bool Statistic::addDev(dev::devInfo_t & dev, timers::hz_t hz)
         return false;
     }
 
+    // Окно агрегации, период гистограмм и история задаются в секундах и
+    // пересчитываются в считывания.
+    auto subOpts = opts;
+    subOpts.aggWindow = m_getWindow(opts.aggSec, opts, period);
+    subOpts.hgramWindow = m_getWindow(opts.hgramSec, opts, period);
+    if (!m_getHistSamples(subOpts, dev.second, period) ||
+        !m_checkSubsBytes(subOpts, dev.second))
+    {
+        return false;
+    }
+
+    // Выделить идентификатор подписки для учета потерь.
+    auto id = m_allocId();
+    if (id == s_maxSubs)
+    {
+        LOGGER_ERROR("Too many subscriptions");
+        return false;
+    }
+
     // Добавить устройство в пул.
-    m_addDev(dev, ticks);
+    m_addDev(dev, period, id, subOpts);
 
     // Запустить поток сбора статистики, если еще не запущен.
     return m_startStat();
@@ -66,10 +133,10 @@ bool Statistic::addDev(dev::devInfo_t & dev, timers::hz_t hz)
 
 bool Statistic::addFile(dev::file_t & file, timers::hz_t hz)
 {
-    // Преобразовать Гц в тики.
-    auto ticks = m_timer.hzToTicks(hz);
-    // Нельзя добавить файл с таким количеством тиков.
-    if (!ticks)
+    // Преобразовать Гц в период.
+    auto period = m_timer.hzToPeriod(hz);
+    // Нельзя добавить файл с таким периодом.
+    if (!period)
         return false;
 
     std::lock_guard<std::mutex> lock(m_dataMutex);
@@ -82,8 +149,16 @@ bool Statistic::addFile(dev::file_t & file, timers::hz_t hz)
         return false;
     }
 
+    // Выделить идентификатор подписки для учета потерь.
+    auto id = m_allocId();
+    if (id == s_maxSubs)
+    {
+        LOGGER_ERROR("Too many subscriptions");
+        return false;
+    }
+
     // Добавить файл API в пул.
-    m_addFile(file, ticks);
+    m_addFile(file, period, id);
 
     // Запустить поток сбора статистики, если еще не запущен.
     return  m_startStat();
@@ -96,6 +171,15 @@ bool Statistic::delDev(uint32_t & addr)
     // Заблокировать мьютекс для работы с устройствами. (Разблокируется в m_stopStat).
     m_dataMutex.lock();
 
+    // Устройство считывается высокочастотно.
+    hirate::Sampler::channelInfo_t info;
+    if (m_hirate.remove(addr, info))
+    {
+        m_freeId(info.id);
+        m_dataMutex.unlock();
+        return true;
+    }
+
     // Вернуть false, если нет такого устройства в списке активных.
     if (!m_isDevExist(addr))
     {
@@ -129,18 +213,121 @@ bool Statistic::delFile(dev::file_t & file)
 
 //-----------------------------------------------------------------------------
 
+bool Statistic::modDev(uint32_t & addr, timers::hz_t hz)
+{
+    std::unique_lock<std::mutex> lock(m_dataMutex);
+    if (m_hirate.isHighRate(hz) || m_hirate.isExist(addr))
+    {
+        auto ret = m_modHighRate(addr, hz);
+        // Остановить поток сбора статистики, если последнее устройство
+        // перешло в высокочастотное считывание (мьютекс освобождается в
+        // m_stopStat).
+        lock.release();
+        m_stopStat();
+        return ret;
+    }
+
+    // Преобразовать Гц в период.
+    auto period = m_timer.hzToPeriod(hz);
+    // Нельзя перенести устройство в пул с таким периодом.
+    if (!period)
+        return false;
+
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        if (!it->second->isExist(addr))
+            continue;
+
+        // Частота считывания не изменилась.
+        if (it->first == period)
+            return true;
+
+        // История с новой частотой должна поместиться в память.
+        auto & entries = it->second->getEntries();
+        auto found = std::find_if(entries.begin(), entries.end(),
+            [&addr](dev::Devices::devEntry_t * e) { return e->devInfo.first == addr; });
+        auto opts = (*found)->opts;
+        if (!m_getHistSamples(opts, (*found)->devInfo.second, period) ||
+            !m_checkSubsBytes(opts, (*found)->devInfo.second, *found))
+        {
+            return false;
+        }
+
+        // Извлечь устройство вместе с отображением и состоянием.
+        auto entry = it->second->extract(addr);
+        // Удалить пул для этого периода, если устройство было в нем последним.
+        if (!it->second->isActive())
+        {
+            m_deleteDevsMem(it->second);
+            m_timer.remove(it->first);
+            m_devs.erase(it);
+        }
+
+        // Добавить устройство в пул с новой частотой считывания.
+        entry->opts.aggWindow = m_getWindow(entry->opts.aggSec, entry->opts, period);
+        entry->opts.hgramWindow = m_getWindow(entry->opts.hgramSec, entry->opts,
+                                              period);
+        entry->opts.histSamples = opts.histSamples;
+        m_insertDev(entry, period);
+        return true;
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::modFile(dev::file_t & file, timers::hz_t hz)
+{
+    // Преобразовать Гц в период.
+    auto period = m_timer.hzToPeriod(hz);
+    // Нельзя перенести файл API в пул с таким периодом.
+    if (!period)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_dataMutex);
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        if (!it->second->isExist(file))
+            continue;
+
+        // Частота считывания не изменилась.
+        if (it->first == period)
+            return true;
+
+        // Извлечь файл API вместе с открытым файлом и состоянием.
+        auto entry = it->second->extract(file);
+        // Удалить пул для этого периода, если файл был в нем последним.
+        if (!it->second->isActive())
+        {
+            m_deleteFilesMem(it->second);
+            m_timer.remove(it->first);
+            m_apis.erase(it);
+        }
+
+        // Добавить файл API в пул с новой частотой считывания.
+        m_insertFile(entry, period);
+        return true;
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
 void Statistic::getActiveDevs(std::stringstream & pkg)
 {
-    std::lock_guard<std::mutex> lock(m_dataQMutex);
+    std::lock_guard<std::mutex> lock(m_dataMutex);
     for (auto it = m_devs.begin(); it != m_devs.end(); )
     {
-        auto devs = it->second->getActive();
+        auto & devs = it->second->getEntries();
         for (auto dev = devs.begin(); dev != devs.end(); )
         {
-            pkg << m_getHexAddr(dev->first);
-            pkg << sep::dataSep << std::dec << dev->second << sep::dataSep;
-            // Добавить частоту считывания в пакет.
-            pkg << m_getFreq(it->first);
+            pkg << m_getHexAddr((*dev)->devInfo.first);
+            pkg << sep::dataSep << std::dec << (*dev)->devInfo.second
+                << sep::dataSep;
+            // Добавить частоту считывания и параметры подписки в пакет.
+            pkg << m_getFreq(it->first) << m_getOpts((*dev)->opts);
 
             if (++dev != devs.end())
                 pkg << sep::dataSep;
@@ -149,13 +336,26 @@ void Statistic::getActiveDevs(std::stringstream & pkg)
         if (++it != m_devs.end())
             pkg << sep::dataSep;
     }
+
+    // Устройства высокочастотного считывания.
+    std::vector<hirate::Sampler::channelInfo_t> channels;
+    m_hirate.getChannels(channels);
+    for (auto it = channels.begin(); it != channels.end(); it++)
+    {
+        if (pkg.tellp() > 0)
+            pkg << sep::dataSep;
+
+        pkg << m_getHexAddr(it->devInfo.first);
+        pkg << sep::dataSep << std::dec << it->devInfo.second;
+        pkg << sep::dataSep << it->hz;
+    }
 }
 
 //-----------------------------------------------------------------------------
 
 void Statistic::getActiveFiles(std::stringstream & pkg)
 {
-    std::lock_guard<std::mutex> lock(m_dataQMutex);
+    std::lock_guard<std::mutex> lock(m_dataMutex);
     for (auto it = m_apis.begin(); it != m_apis.end(); )
     {
         auto files = it->second->getActive();
@@ -190,8 +390,91 @@ bool Statistic::readDevOnce(dev::devInfo_t & devInfo, std::stringstream & data)
     if (!dev.read(region))
         return false;
 
+    auto encoding = m_encoding.load();
+    buffer::Buffer pkg;
+    // Пометить начало бинарных данных.
+    if (encoding == encoding_t::BINARY)
+    {
+        pkg.append(m_binTag);
+        pkg.append(sep::dataSep);
+    }
+
     // Сформировать пакет.
-    m_addReg(region, data);
+    m_addReg(region, pkg, m_format.load(), encoding);
+    data.write(pkg.data(), std::streamsize(pkg.size()));
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::readBurst(dev::devInfo_t & devInfo, unsigned int count,
+                          buffer::Buffer & data, std::vector<size_t> & ends)
+{
+    std::lock_guard<std::mutex> lock(m_burstMutex);
+
+    data.clear();
+    ends.clear();
+
+    // Устройство отображается заново только при смене адреса или количества
+    // регистров.
+    if (!m_burstDev || m_burstInfo != devInfo)
+    {
+        m_burstDev.reset(new dev::Device(devInfo));
+        m_burstInfo = devInfo;
+    }
+
+    if (!m_burstDev->burst(count, m_burstStamps, m_burstData))
+    {
+        m_burstDev.reset();
+        return false;
+    }
+
+    auto & stamps = m_burstStamps;
+    auto & values = m_burstData;
+    auto regs = devInfo.second;
+
+    // Части содержат целое количество отсчетов.
+    auto sampleSize = sizeof(uint64_t) + regs * sizeof(uint32_t);
+    auto perChunk = std::max(size_t(1), s_chunkSize / sampleSize);
+    auto total = (count + perChunk - 1) / perChunk;
+
+    for (size_t chunk = 0; chunk < total; chunk++)
+    {
+        auto first = chunk * perChunk;
+        auto last = std::min(size_t(count), first + perChunk);
+
+        // Заголовок части: устройство, количество считываний, номер части и
+        // количество частей, номер первого отсчета части и количество
+        // отсчетов в части.
+        data.appendHex(devInfo.first);
+        data.append(sep::baseSep);
+        data.appendDec(regs);
+        data.append(sep::dataSep);
+        data.appendDec(count);
+        data.append(sep::dataSep);
+        data.appendDec(chunk);
+        data.append(sep::baseSep);
+        data.appendDec(total);
+        data.append(sep::dataSep);
+        data.appendDec(first);
+        data.append(sep::dataSep);
+        data.appendDec(last - first);
+        data.append(sep::dataSep);
+        data.append(m_binTag);
+        data.append(sep::dataSep);
+
+        // Отсчеты: метка времени (64 бита) и значения регистров.
+        for (auto i = first; i < last; i++)
+        {
+            data.appendWord(uint32_t(stamps[i]));
+            data.appendWord(uint32_t(stamps[i] >> 32));
+            for (unsigned int reg = 0; reg < regs; reg++)
+                data.appendWord(values[i * regs + reg]);
+        }
+
+        ends.push_back(data.size());
+    }
+
     return true;
 }
 
@@ -213,20 +496,105 @@ bool Statistic::readApiOnce(dev::file_t & fileInfo, std::stringstream & data)
 
 //-----------------------------------------------------------------------------
 
-bool Statistic::readStatistic(std::stringstream & pkg)
+void Statistic::setFormat(format_t format, encoding_t encoding,
+                          framing_t framing)
 {
-    std::lock_guard<std::mutex> lock(m_dataQMutex);
+    m_format = format;
+    m_encoding = encoding;
+    m_framing = framing;
+}
 
-    // Вернуться, если очередь пуста.
-    if (m_dataQ.size() == 0)
-        return false;
+//-----------------------------------------------------------------------------
 
-    // Передать пакет читающему потоку.
-    pkg = std::move(m_dataQ.front());
-    // Удалить пакет из очереди пакетов.
-    m_dataQ.pop();
+format_t Statistic::getFormat()
+{
+    return m_format.load();
+}
 
-    return true;
+//-----------------------------------------------------------------------------
+
+encoding_t Statistic::getEncoding()
+{
+    return m_encoding.load();
+}
+
+//-----------------------------------------------------------------------------
+
+framing_t Statistic::getFraming()
+{
+    return m_framing.load();
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::waitStatistic()
+{
+    return m_dataQ.wait();
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::wakeStatistic()
+{
+    m_dataQ.wake();
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Statistic::readStatistic(ring::pkg_t ** pkgs, size_t max)
+{
+    // Значения регистров для записи сохраняются на накопитель здесь, а не в
+    // потоке сбора статистики.
+    m_recorder.writeSamples();
+
+    // Отбросить самые старые пакеты, пока очередь превышает ограничения.
+    if (m_queueCfg.overflow == overflow_t::DROP_OLDEST)
+    {
+        while (m_isQueueOver())
+        {
+            auto pkg = m_dataQ.front();
+            m_countDrops(pkg->subs);
+            m_dataQ.release();
+        }
+    }
+
+    // Пакеты остаются в очередях до вызова releaseStatistic. Сначала
+    // берутся пакеты статистики, затем пакеты высокочастотного считывания,
+    // затем воспроизводимые пакеты записи.
+    m_readCnt = m_dataQ.peek(pkgs, max);
+    m_hirateCnt = m_hirate.peek(pkgs + m_readCnt, max - m_readCnt);
+
+    auto count = m_readCnt + m_hirateCnt;
+    return count + m_recorder.peek(pkgs + count, max - count);
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::releaseStatistic(ring::pkg_t ** pkgs, size_t count)
+{
+    auto now = timers::now();
+    auto sum = m_latencySum.load(std::memory_order_relaxed);
+    auto max = m_latencyMax.load(std::memory_order_relaxed);
+
+    // Учесть задержку от публикации до отправки для каждого пакета.
+    for (size_t i = 0; i < count; i++)
+    {
+        auto latency = now - pkgs[i]->stamp;
+        sum += latency;
+        max = std::max(max, latency);
+    }
+
+    m_latencySum.store(sum, std::memory_order_relaxed);
+    m_latencyMax.store(max, std::memory_order_relaxed);
+    m_sentCnt.fetch_add(count, std::memory_order_relaxed);
+
+    // Записываются только полученные в этом запуске пакеты (без
+    // воспроизводимых).
+    m_recorder.append(pkgs, m_readCnt + m_hirateCnt);
+
+    m_dataQ.release(m_readCnt);
+    m_hirate.release(m_hirateCnt);
+    m_recorder.release(count - m_readCnt - m_hirateCnt);
 }
 
 //-----------------------------------------------------------------------------
@@ -234,6 +602,13 @@ bool Statistic::readStatistic(std::stringstream & pkg)
 void Statistic::stopStatistic()
 {
     m_dataMutex.lock();
+
+    // Остановить высокочастотное считывание.
+    std::vector<unsigned int> ids;
+    m_hirate.removeAll(ids);
+    for (auto it = ids.begin(); it != ids.end(); it++)
+        m_freeId(*it);
+
     // Если поток уже остановлен.
     if (!m_activated)
     {
@@ -248,17 +623,23 @@ void Statistic::stopStatistic()
 
     m_activated = false;
     m_dataMutex.unlock();
+    m_timer.wake();
     m_statThread.join();
 }
 
 //-----------------------------------------------------------------------------
 
-bool Statistic::m_isDevExist(uint32_t & addr)
+bool Statistic::addTrigger(uint32_t & addr, const trig::params_t & params,
+                           unsigned int & id)
 {
+    std::lock_guard<std::mutex> lock(m_dataMutex);
     for (auto it = m_devs.begin(); it != m_devs.end(); it++)
     {
-        if (it->second->isExist(addr))
+        if (it->second->addTrigger(addr, trig::Trigger(m_nextTrigger, params)))
+        {
+            id = m_nextTrigger++;
             return true;
+        }
     }
 
     return false;
@@ -266,12 +647,17 @@ bool Statistic::m_isDevExist(uint32_t & addr)
 
 //-----------------------------------------------------------------------------
 
-bool Statistic::m_isFileExist(dev::file_t & fileName)
+bool Statistic::addTrigger(dev::file_t & file, const trig::params_t & params,
+                           unsigned int & id)
 {
+    std::lock_guard<std::mutex> lock(m_dataMutex);
     for (auto it = m_apis.begin(); it != m_apis.end(); it++)
     {
-        if (it->second->isExist(fileName))
+        if (it->second->addTrigger(file, trig::Trigger(m_nextTrigger, params)))
+        {
+            id = m_nextTrigger++;
             return true;
+        }
     }
 
     return false;
@@ -279,351 +665,2178 @@ bool Statistic::m_isFileExist(dev::file_t & fileName)
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_addRegs(std::stringstream & data, dev::devsRegion_t * region)
+bool Statistic::delTrigger(unsigned int id)
 {
-    for (unsigned int i = 0; i < region->size(); i++)
+    std::lock_guard<std::mutex> lock(m_dataMutex);
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
     {
-        // Добавить разделитель для устройства.
-        if (data.str().size())
-            data << sep::dataSep;
+        if (it->second->removeTrigger(id))
+            return true;
+    }
 
-        // Добавить регион устройства в пакет.
-        m_addReg((*region)[i], data);
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        if (it->second->removeTrigger(id))
+            return true;
     }
+
+    return false;
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_doStat(Statistic * stat)
+void Statistic::getTriggers(std::stringstream & pkg)
 {
-    while (stat->m_activated.load())
+    std::lock_guard<std::mutex> replyLock(m_replyMutex);
+    m_replyTrigs.clear();
+
     {
-        // Заснуть на определенный срок.
-        stat->m_timer.sleep();
-        // Проверить список работ и сформировать данные, если есть.
-        stat->m_parseData();
-        // Увеличить количество пройденных тиков.
-        ++stat->m_timer;
+        std::lock_guard<std::mutex> lock(m_dataMutex);
+        for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+        {
+            auto & entries = it->second->getEntries();
+            for (auto dev = entries.begin(); dev != entries.end(); dev++)
+            {
+                auto & triggers = (*dev)->triggers;
+                for (auto trig = triggers.begin(); trig != triggers.end(); trig++)
+                {
+                    uint32_t addr = (*dev)->devInfo.first + trig->first * sizeof(uint32_t);
+                    m_replyTrigs.push_back({trig->second.getId(), addr, "",
+                                            trig->second.getParams()});
+                }
+            }
+        }
+
+        for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+        {
+            auto & entries = it->second->getEntries();
+            for (auto api = entries.begin(); api != entries.end(); api++)
+            {
+                auto & triggers = (*api)->triggers;
+                for (auto trig = triggers.begin(); trig != triggers.end(); trig++)
+                {
+                    m_replyTrigs.push_back({trig->getId(), 0,
+                                            (*api)->file.second,
+                                            trig->getParams()});
+                }
+            }
+        }
+    }
+
+    for (auto it = m_replyTrigs.begin(); it != m_replyTrigs.end(); it++)
+    {
+        if (pkg.tellp() > 0)
+            pkg << sep::dataSep;
+
+        pkg << std::dec << it->id << sep::dataSep
+            << (it->file.size() ? it->file : m_getHexAddr(it->addr))
+            << sep::dataSep << m_getTrigDef(it->params);
     }
-    stat->log.trace(__FILE__, EP7TRACE_LEVEL_INFO, (tUINT16)__LINE__,
-                    __FUNCTION__, "Statistics parsing thread stopped");
 }
 
 //-----------------------------------------------------------------------------
 
-bool Statistic::m_startStat()
+bool Statistic::getHistoryInfo(uint32_t & addr, std::stringstream & pkg)
 {
-    // Поток уже запущен.
-    if (m_activated.load())
-        return true;
+    std::lock_guard<std::mutex> lock(m_dataMutex);
+    dev::Devices * devs;
+    auto entry = m_findDev(addr, &devs);
+    if (!entry || !entry->opts.histSamples)
+        return false;
 
-    m_activated = true;
-    m_statThread = std::thread(m_doStat, this);
-    if (!m_statThread.joinable())
+    auto & hist = entry->history;
+    auto first = devs->getHistoryFirst(entry);
+    uint64_t firstStamp = 0, lastStamp = 0;
+    if (hist.filled)
     {
-        LOGGER_ERROR("Can't start statistic parsing in thread");
-        return false;
+        auto record = devs->getHistoryRecord(entry, first);
+        firstStamp = uint64_t(record[0]) | (uint64_t(record[1]) << 32);
+        record = devs->getHistoryRecord(entry, hist.total - 1);
+        lastStamp = uint64_t(record[0]) | (uint64_t(record[1]) << 32);
     }
 
-    LOGGER_INFO("Statistic parsing started in thread");
+    // Устройство, номер самого старого отсчета, количество отсчетов, метки
+    // времени первого и последнего отсчета и текущее время платы.
+    pkg << m_getHexAddr(addr) << sep::baseSep << std::dec << entry->devInfo.second
+        << sep::dataSep << first << sep::dataSep << hist.filled
+        << sep::dataSep << firstStamp << sep::dataSep << lastStamp
+        << sep::dataSep << timers::now();
     return true;
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_stopStat()
+bool Statistic::getHistory(uint32_t & addr, bool byTime, uint64_t from,
+                           uint64_t to, std::vector<std::string> & chunks)
 {
-    if ((m_devs.size() != 0) || (m_apis.size() != 0))
+    std::lock_guard<std::mutex> replyLock(m_replyMutex);
+    uint32_t regs;
+    uint64_t first;
+    uint64_t count;
+
     {
-        m_dataMutex.unlock();
-        return;
+        std::lock_guard<std::mutex> lock(m_dataMutex);
+        dev::Devices * devs;
+        auto entry = m_findDev(addr, &devs);
+        if (!entry || !entry->opts.histSamples)
+            return false;
+
+        regs = entry->devInfo.second;
+        first = devs->getHistoryFirst(entry);
+        auto end = entry->history.total;
+
+        // Перевести диапазон в номера отсчетов [first, end).
+        if (byTime)
+        {
+            first = devs->findHistory(entry, from);
+            if (to != UINT64_MAX)
+                end = devs->findHistory(entry, to + 1);
+        }
+        else
+        {
+            first = std::max(first, from);
+            if (to < end)
+                end = to + 1;
+        }
+
+        auto recordSize = (dev::Devices::s_stampWords + regs) * sizeof(uint32_t);
+        count = end > first ? end - first : 0;
+        // Остаток диапазона пользователь запрашивает следующим запросом.
+        count = std::min(count, uint64_t(s_maxHistoryReply / recordSize));
+
+        // Записи копируются как есть (метка времени, затем регистры), ответ
+        // формируется после освобождения m_dataMutex.
+        m_replyWords.clear();
+        for (auto seq = first; seq < first + count; seq++)
+        {
+            auto record = devs->getHistoryRecord(entry, seq);
+            m_replyWords.insert(m_replyWords.end(), record,
+                                record + dev::Devices::s_stampWords + regs);
+        }
     }
 
-    // Если нет актиных задач, то завершить цикл сбора статистики.
-    m_activated = false;
-    m_dataMutex.unlock();
-    m_statThread.join();
+    auto recordWords = dev::Devices::s_stampWords + regs;
+    auto perChunk = std::max(size_t(1), s_chunkSize / (recordWords * sizeof(uint32_t)));
+    auto chunksCnt = std::max(uint64_t(1), (count + perChunk - 1) / perChunk);
+
+    for (uint64_t chunk = 0; chunk < chunksCnt; chunk++)
+    {
+        auto chunkFirst = chunk * perChunk;
+        auto chunkCnt = std::min(uint64_t(perChunk), count - chunkFirst);
+
+        // Заголовок части: устройство, номер части и количество частей, номер
+        // первого отсчета и количество отсчетов в части.
+        m_replyBuf.clear();
+        m_replyBuf.appendHex(addr);
+        m_replyBuf.append(sep::baseSep);
+        m_replyBuf.appendDec(regs);
+        m_replyBuf.append(sep::dataSep);
+        m_replyBuf.appendDec(chunk);
+        m_replyBuf.append(sep::baseSep);
+        m_replyBuf.appendDec(chunksCnt);
+        m_replyBuf.append(sep::dataSep);
+        m_replyBuf.appendDec(first + chunkFirst);
+        m_replyBuf.append(sep::dataSep);
+        m_replyBuf.appendDec(chunkCnt);
+        m_replyBuf.append(sep::dataSep);
+        m_replyBuf.append(m_binTag);
+        m_replyBuf.append(sep::dataSep);
+
+        auto word = m_replyWords.begin() + chunkFirst * recordWords;
+        for (auto end = word + chunkCnt * recordWords; word != end; word++)
+            m_replyBuf.appendWord(*word);
+
+        chunks.emplace_back(m_replyBuf.data(), m_replyBuf.size());
+    }
+
+    return true;
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_deleteDevsMem(dev::Devices * devs)
+bool Statistic::startRecord(const std::string & name, bool columnar)
 {
-    delete devs;
+    return m_recorder.start(name, columnar);
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_deleteFilesMem(dev::DevsApi * apis)
+bool Statistic::stopRecord(std::stringstream & info)
 {
-    delete apis;
+    return m_recorder.stop(info);
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_delDevFromPool(uint32_t & addr)
+bool Statistic::isRecording()
 {
-    // Удалить устройство из списка активных задач.
-    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
-    {
-        // Удалить устройство из пула, если оно там присутсвует.
-        if (!it->second->remove(addr))
-            continue;
-        // Если это последнее устройство - удалить пул для этого тика.
-        if (!it->second->isActive())
-        {
-            // Удалить память, выделенную под класс устройства.
-            m_deleteDevsMem(it->second);
-            // Уменьшить список активных задач.
-            m_devs.erase(it);
+    return m_recorder.isRecording();
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::getRecords(std::stringstream & pkg)
+{
+    m_recorder.list(pkg);
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::replayRecord(const std::string & name, bool realtime,
+                             uint64_t from)
+{
+    return m_recorder.replay(name, realtime, from);
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::stopReplay()
+{
+    return m_recorder.stopReplay();
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::getRecordLod(const std::string & name, uint32_t & addr,
+                             uint64_t from, uint64_t to, size_t points,
+                             std::vector<std::string> & chunks)
+{
+    unsigned int level;
+    uint64_t bucketNs;
+    std::vector<lod::bucket_t> buckets;
+    if (!m_recorder.getLod(name, addr, from, to, points, level, bucketNs,
+                           buckets))
+        return false;
+
+    // Начало интервала (64 бита), количество значений, минимум, максимум и
+    // среднее (float) в порядке little-endian.
+    static const size_t pointSize = 6 * sizeof(uint32_t);
+    auto perChunk = s_chunkSize / pointSize;
+    auto chunksCnt = std::max(size_t(1), (buckets.size() + perChunk - 1) / perChunk);
+
+    std::lock_guard<std::mutex> replyLock(m_replyMutex);
+    for (size_t chunk = 0; chunk < chunksCnt; chunk++)
+    {
+        auto first = chunk * perChunk;
+        auto count = std::min(perChunk, buckets.size() - first);
+
+        // Заголовок части: запись, регистр, уровень и длительность интервала,
+        // номер части и количество частей, количество интервалов в части.
+        m_replyBuf.clear();
+        m_replyBuf.append("LOD");
+        m_replyBuf.append(sep::dataSep);
+        m_replyBuf.append(name);
+        m_replyBuf.append(sep::dataSep);
+        m_replyBuf.appendHex(addr);
+        m_replyBuf.append(sep::dataSep);
+        m_replyBuf.appendDec(level);
+        m_replyBuf.append(sep::dataSep);
+        m_replyBuf.appendDec(bucketNs);
+        m_replyBuf.append(sep::dataSep);
+        m_replyBuf.appendDec(chunk);
+        m_replyBuf.append(sep::baseSep);
+        m_replyBuf.appendDec(chunksCnt);
+        m_replyBuf.append(sep::dataSep);
+        m_replyBuf.appendDec(count);
+        m_replyBuf.append(sep::dataSep);
+        m_replyBuf.append(m_binTag);
+        m_replyBuf.append(sep::dataSep);
+
+        for (auto it = buckets.begin() + first;
+             it != buckets.begin() + first + count; it++)
+        {
+            float mean = float(it->mean);
+            uint32_t meanWord;
+            memcpy(&meanWord, &mean, sizeof(meanWord));
+
+            m_replyBuf.appendWord(uint32_t(it->start));
+            m_replyBuf.appendWord(uint32_t(it->start >> 32));
+            m_replyBuf.appendWord(it->count);
+            m_replyBuf.appendWord(it->min);
+            m_replyBuf.appendWord(it->max);
+            m_replyBuf.appendWord(meanWord);
+        }
+
+        chunks.emplace_back(m_replyBuf.data(), m_replyBuf.size());
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::addDerived(const std::string & name, const std::string & def,
+                           std::string & error)
+{
+    if (!name.size() || name.size() > s_maxDerivedName || name == "del" ||
+        !std::all_of(name.begin(), name.end(), [](unsigned char c)
+            { return std::isalnum(c) || c == '-' || c == '_'; }))
+    {
+        error = "invalid name";
+        return false;
+    }
+
+    // Выражение компилируется один раз при добавлении канала.
+    derived_t channel;
+    if (!channel.program.compile(def, error))
+        return false;
+
+    auto sources = channel.program.getSources().size();
+    channel.name = name;
+    channel.def = def;
+    channel.values.assign(sources, 0);
+    channel.seen.assign(sources, false);
+    channel.missing = sources;
+    channel.updated = false;
+
+    std::lock_guard<std::mutex> lock(m_dataMutex);
+    auto found = std::find_if(m_derived.begin(), m_derived.end(),
+        [&name](const derived_t & d) { return d.name == name; });
+    if (found != m_derived.end())
+    {
+        *found = channel;
+    }
+    else if (m_derived.size() == s_maxDerived)
+    {
+        error = "too many channels";
+        return false;
+    }
+    else
+    {
+        m_derived.push_back(channel);
+    }
+
+    m_indexDerived();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::delDerived(const std::string & name)
+{
+    std::lock_guard<std::mutex> lock(m_dataMutex);
+    auto found = std::find_if(m_derived.begin(), m_derived.end(),
+        [&name](const derived_t & d) { return d.name == name; });
+    if (found == m_derived.end())
+        return false;
+
+    m_derived.erase(found);
+    m_indexDerived();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::getDerived(std::stringstream & pkg)
+{
+    std::lock_guard<std::mutex> lock(m_dataMutex);
+    for (auto it = m_derived.begin(); it != m_derived.end(); it++)
+    {
+        if (pkg.tellp() > 0)
+            pkg << sep::dataSep;
+        pkg << it->name << sep::dataSep << it->def;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::getQueueInfo(std::stringstream & pkg)
+{
+    // Заполненность очереди в пакетах и байтах.
+    pkg << std::dec << m_dataQ.size() << sep::baseSep << m_queueCfg.packets;
+    pkg << sep::dataSep << m_dataQ.bytes() << sep::baseSep << m_queueCfg.bytes;
+
+    for (auto it = s_overflows.begin(); it != s_overflows.end(); it++)
+    {
+        if (it->second == m_queueCfg.overflow)
+            pkg << sep::dataSep << it->first;
+    }
+
+    pkg << sep::dataSep << m_dropsTotal.load() + m_hirate.getDrops();
+
+    // Средняя и максимальная задержка до отправки в микросекундах.
+    auto sent = m_sentCnt.load();
+    pkg << sep::dataSep << (sent ? m_latencySum.load() / sent / 1000 : 0);
+    pkg << sep::baseSep << m_latencyMax.load() / 1000;
+
+    // Количество потерянных считываний по подпискам.
+    std::lock_guard<std::mutex> lock(m_dataMutex);
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        auto & entries = it->second->getEntries();
+        for (auto dev = entries.begin(); dev != entries.end(); dev++)
+        {
+            pkg << sep::dataSep << m_getHexAddr((*dev)->devInfo.first);
+            pkg << sep::dataSep << std::dec << m_drops[(*dev)->id].load();
+        }
+    }
+
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        auto & entries = it->second->getEntries();
+        for (auto api = entries.begin(); api != entries.end(); api++)
+        {
+            pkg << sep::dataSep << (*api)->file.second;
+            pkg << sep::dataSep << std::dec << m_drops[(*api)->id].load();
+        }
+    }
+    // Потерянные отсчеты высокочастотного считывания.
+    std::vector<hirate::Sampler::channelInfo_t> channels;
+    m_hirate.getChannels(channels);
+    for (auto it = channels.begin(); it != channels.end(); it++)
+    {
+        pkg << sep::dataSep << m_getHexAddr(it->devInfo.first);
+        pkg << sep::dataSep << std::dec << it->drops;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::getSchedInfo(std::stringstream & pkg)
+{
+    auto stat = m_timer.getStat();
+
+    // Количество пробуждений, среднее опоздание (дрейф), среднее изменение
+    // опоздания (джиттер) и максимальное опоздание в микросекундах.
+    pkg << std::dec << stat.wakeups;
+    pkg << sep::dataSep << stat.drift / 1000;
+    pkg << sep::dataSep << stat.jitter / 1000;
+    pkg << sep::dataSep << stat.maxLateness / 1000;
+    pkg << sep::dataSep << stat.missed;
+
+    // Нагрузка на пробуждение: среднее и максимальное количество периодов,
+    // сроки которых совпали, среднее и максимальное время обработки в мкс.
+    auto wakes = m_loadWakes.load();
+    auto periods = wakes ? double(m_loadPeriods.load()) / double(wakes) : 0;
+    pkg << sep::dataSep << "LOAD";
+    pkg << sep::dataSep << std::fixed << std::setprecision(2) << periods;
+    pkg << std::defaultfloat;
+    pkg << sep::baseSep << m_loadPeriodsMax.load();
+    pkg << sep::dataSep << (wakes ? m_loadBusy.load() / wakes / 1000 : 0);
+    pkg << sep::baseSep << m_loadBusyMax.load() / 1000;
+
+    // Точность пробуждений высокочастотного считывания.
+    stat = m_hirate.getSchedStat();
+    pkg << sep::dataSep << "HIRATE";
+    pkg << sep::dataSep << stat.wakeups;
+    pkg << sep::dataSep << stat.drift / 1000;
+    pkg << sep::dataSep << stat.jitter / 1000;
+    pkg << sep::dataSep << stat.maxLateness / 1000;
+    pkg << sep::dataSep << stat.missed;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::m_isDevExist(uint32_t & addr)
+{
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        if (it->second->isExist(addr))
+            return true;
+    }
+
+    return m_hirate.isExist(addr);
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::m_addHighRate(dev::devInfo_t & dev, timers::hz_t hz)
+{
+    std::lock_guard<std::mutex> lock(m_dataMutex);
+    if (m_isDevExist(dev.first))
+    {
+        std::stringstream msg;
+        msg << "Device " << m_getHexAddr(dev.first) << " is already exist";
+        LOGGER_DEBUG(msg.str());
+        return false;
+    }
+
+    // Выделить идентификатор подписки для учета потерь.
+    auto id = m_allocId();
+    if (id == s_maxSubs)
+    {
+        LOGGER_ERROR("Too many subscriptions");
+        return false;
+    }
+
+    if (!m_hirate.add(dev, hz, id))
+    {
+        m_freeId(id);
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::m_modHighRate(uint32_t & addr, timers::hz_t hz)
+{
+    // Устройство уже считывается высокочастотно.
+    if (m_hirate.isExist(addr))
+    {
+        if (m_hirate.isHighRate(hz))
+            return m_hirate.mod(addr, hz);
+
+        // Перенести устройство в пул обычного считывания.
+        auto period = m_timer.hzToPeriod(hz);
+        if (!period)
+            return false;
+
+        // Отображение переходит из канала в пул вместе с устройством.
+        hirate::Sampler::channelInfo_t info;
+        dev::Device * mapped;
+        if (!m_hirate.remove(addr, info, &mapped))
+            return false;
+
+        m_addDev(info.devInfo, period, info.id, dev::subOpts_t(), mapped);
+        return m_startStat();
+    }
+
+    // Перенести устройство из пула обычного считывания.
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        auto & entries = it->second->getEntries();
+        auto entry = std::find_if(entries.begin(), entries.end(),
+            [&addr](dev::Devices::devEntry_t * e) { return e->devInfo.first == addr; });
+        if (entry == entries.end())
+            continue;
+
+        // Устройство остается в прежнем пуле, если его нельзя считывать
+        // высокочастотно (агрегация, фильтры, захваты и триггеры при
+        // высокочастотном считывании не поддерживаются).
+        if (m_hasSubOpts((*entry)->opts) || (*entry)->triggers.size())
+            return false;
+
+        // Отображение переходит из пула в канал вместе с устройством (при
+        // ошибке устройство возвращается в пул с тем же отображением).
+        auto devInfo = (*entry)->devInfo;
+        auto id = (*entry)->id;
+        auto mapped = it->second->release(addr);
+        if (!m_hirate.add(devInfo, hz, id, mapped))
+        {
+            it->second->add(devInfo, id, dev::subOpts_t(), mapped);
+            return false;
+        }
+
+        if (!it->second->isActive())
+        {
+            m_deleteDevsMem(it->second);
+            m_timer.remove(it->first);
+            m_devs.erase(it);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::m_isFileExist(dev::file_t & fileName)
+{
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        if (it->second->isExist(fileName))
+            return true;
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addRegs(buffer::Buffer & data, dev::devsRegion_t * region,
+                          format_t format, encoding_t encoding)
+{
+    for (unsigned int i = 0; i < region->size(); i++)
+    {
+        // Добавить разделитель для устройства (в бинарном виде разделители
+        // не нужны, метка BIN добавляется при объединении данных групп).
+        if (encoding == encoding_t::TEXT && data.size())
+            data.append(sep::dataSep);
+
+        // Добавить регион устройства в пакет.
+        m_addReg(*(*region)[i], data, format, encoding);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_doStat(Statistic * stat)
+{
+    while (stat->m_activated.load())
+    {
+        // Заснуть до ближайшего срока считывания.
+        stat->m_timer.sleep();
+        // Получить периоды, сроки которых наступили.
+        stat->m_timer.popDue(stat->m_due);
+        // Сон прерван изменением расписания или остановкой.
+        if (!stat->m_due.size())
+            continue;
+        // Проверить список работ и сформировать данные, если есть.
+        auto start = timers::now();
+        stat->m_parseData();
+        stat->m_countLoad(stat->m_due.size(), timers::now() - start);
+    }
+    stat->log.trace(__FILE__, EP7TRACE_LEVEL_INFO, (tUINT16)__LINE__,
+                    __FUNCTION__, "Statistics parsing thread stopped");
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::m_isDue(const timers::period_t & period)
+{
+    return std::find(m_due.begin(), m_due.end(), period) != m_due.end();
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_countLoad(size_t periods, uint64_t busy)
+{
+    m_loadWakes.fetch_add(1, std::memory_order_relaxed);
+    m_loadPeriods.fetch_add(periods, std::memory_order_relaxed);
+    m_loadBusy.fetch_add(busy, std::memory_order_relaxed);
+
+    if (periods > m_loadPeriodsMax.load(std::memory_order_relaxed))
+        m_loadPeriodsMax.store(periods, std::memory_order_relaxed);
+    if (busy > m_loadBusyMax.load(std::memory_order_relaxed))
+        m_loadBusyMax.store(busy, std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::m_startStat()
+{
+    // Поток уже запущен.
+    if (m_activated.load())
+        return true;
+
+    m_activated = true;
+    m_statThread = std::thread(m_doStat, this);
+    if (!m_statThread.joinable())
+    {
+        LOGGER_ERROR("Can't start statistic parsing in thread");
+        return false;
+    }
+
+    LOGGER_INFO("Statistic parsing started in thread");
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_stopStat()
+{
+    // Поток не запущен (например, при MOD только высокочастотных устройств).
+    if ((m_devs.size() != 0) || (m_apis.size() != 0) || !m_activated.load())
+    {
+        m_dataMutex.unlock();
+        return;
+    }
+
+    // Если нет актиных задач, то завершить цикл сбора статистики.
+    m_activated = false;
+    m_dataMutex.unlock();
+    m_timer.wake();
+    m_statThread.join();
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_deleteDevsMem(dev::Devices * devs)
+{
+    delete devs;
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_deleteFilesMem(dev::DevsApi * apis)
+{
+    delete apis;
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_delDevFromPool(uint32_t & addr)
+{
+    // Удалить устройство из списка активных задач.
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        // Освободить идентификатор подписки устройства.
+        auto & entries = it->second->getEntries();
+        for (auto dev = entries.begin(); dev != entries.end(); dev++)
+        {
+            if ((*dev)->devInfo.first == addr)
+                m_freeId((*dev)->id);
+        }
+
+        // Удалить устройство из пула, если оно там присутсвует.
+        if (!it->second->remove(addr))
+            continue;
+        // Если это последнее устройство - удалить пул для этого периода.
+        if (!it->second->isActive())
+        {
+            // Удалить память, выделенную под класс устройства.
+            m_deleteDevsMem(it->second);
+            m_timer.remove(it->first);
+            // Уменьшить список активных задач.
+            m_devs.erase(it);
+            break;
+        }
+    }
+    // Остановить сбор статистики, если это последнее устройство в пуле.
+    m_stopStat();
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_delFileFromPool(dev::file_t & file)
+{
+    // Удалить файл API из списка активных задач.
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        // Освободить идентификатор подписки файла API.
+        auto & entries = it->second->getEntries();
+        for (auto api = entries.begin(); api != entries.end(); api++)
+        {
+            if ((*api)->file == file)
+                m_freeId((*api)->id);
+        }
+
+        // Удалить файл API из пула чтения.
+        if (!it->second->remove(file))
+            continue;
+        // Если это последний файл - удалить пул для этого периода.
+        if (!it->second->isActive())
+        {
+            // Удалить память, выделенную под класс файлов API.
+            m_deleteFilesMem(it->second);
+            m_timer.remove(it->first);
+            // Уменьшить список активных файлов чтения.
+            m_apis.erase(it);
             break;
         }
     }
-    // Остановить сбор статистики, если это последнее устройство в пуле.
-    m_stopStat();
+    // Остановить сбор статистики, если это последний файл API в пуле.
+    m_stopStat();
+}
+
+//-----------------------------------------------------------------------------
+
+std::list<Statistic::devJob_t>::const_iterator
+Statistic::m_isDevPeriodExist(timers::period_t & period)
+{
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        if (period == it->first)
+            return it;
+    }
+
+    return m_devs.end();
+}
+
+//-----------------------------------------------------------------------------
+
+std::list<Statistic::apiJob_t>::const_iterator
+Statistic::m_isFilePeriodExist(timers::period_t & period)
+{
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        if (period == it->first)
+            return it;
+    }
+
+    return m_apis.end();
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addDev(dev::devInfo_t & dev, timers::period_t & period,
+                         unsigned int id, const dev::subOpts_t & opts,
+                         dev::Device * mapped)
+{
+    auto it = m_isDevPeriodExist(period);
+    // Добавить устройство, если такая частота считывания уже есть.
+    if (it != m_devs.end())
+    {
+        LOGGER_DEBUG("Dev read frequency exists");
+        it->second->add(dev, id, opts, mapped);
+        return;
+    }
+    LOGGER_DEBUG("Dev read frequency isn't exist");
+
+    // Создать класс, который будет обслуживать устройства с такой частотой считывания.
+    dev::Devices * devs = new dev::Devices(dev, id, opts, mapped);
+    devJob_t pair{period, devs};
+    m_devs.push_back(pair);
+    // Добавить период группы в расписание.
+    m_timer.add(period);
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addFile(dev::file_t & file, timers::period_t & period,
+                          unsigned int id)
+{
+    auto it = m_isFilePeriodExist(period);
+    // Добавить файл API, если такая частота считывания уже есть.
+    if (it != m_apis.end())
+    {
+        LOGGER_DEBUG("Api read frequency exists");
+        it->second->add(file, id);
+        return;
+    }
+    LOGGER_DEBUG("Api read frequency isn't exist");
+
+    // Создать класс, который будет обслуживать файлы API с такой частотой считывания.
+    dev::DevsApi * apis = new dev::DevsApi(file, id);
+    apiJob_t pair{period, apis};
+    m_apis.push_back(pair);
+    // Добавить период группы в расписание.
+    m_timer.add(period);
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_insertDev(dev::Devices::devEntry_t * entry,
+                            timers::period_t & period)
+{
+    auto it = m_isDevPeriodExist(period);
+    // Добавить устройство, если такая частота считывания уже есть.
+    if (it != m_devs.end())
+    {
+        it->second->insert(entry);
+        return;
+    }
+
+    // Создать класс, который будет обслуживать устройства с такой частотой считывания.
+    dev::Devices * devs = new dev::Devices(entry);
+    devJob_t pair{period, devs};
+    m_devs.push_back(pair);
+    // Добавить период группы в расписание.
+    m_timer.add(period);
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_insertFile(dev::DevsApi::apiEntry_t * entry,
+                             timers::period_t & period)
+{
+    auto it = m_isFilePeriodExist(period);
+    // Добавить файл API, если такая частота считывания уже есть.
+    if (it != m_apis.end())
+    {
+        it->second->insert(entry);
+        return;
+    }
+
+    // Создать класс, который будет обслуживать файлы API с такой частотой считывания.
+    dev::DevsApi * apis = new dev::DevsApi(entry);
+    apiJob_t pair{period, apis};
+    m_apis.push_back(pair);
+    // Добавить период группы в расписание.
+    m_timer.add(period);
+}
+
+//-----------------------------------------------------------------------------
+
+std::string Statistic::m_getFreq(timers::period_t & period)
+{
+    std::stringstream pkg;
+    pkg << m_timer.periodToHz(period);
+
+    return pkg.str();
+}
+
+//-----------------------------------------------------------------------------
+
+std::string Statistic::m_getHexAddr(const uint32_t & addr)
+{
+    std::stringstream pkg;
+    pkg << "0x" << std::setfill('0') << std::setw(8) << std::hex << addr;
+
+    return pkg.str();
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_delAllDevs()
+{
+    // Удалить все устройства из списка активных задач.
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        // Освободить идентификаторы подписок.
+        auto & entries = it->second->getEntries();
+        for (auto dev = entries.begin(); dev != entries.end(); dev++)
+            m_freeId((*dev)->id);
+
+        // Удалить все устройства из пула.
+        it->second->removeAll();
+        // Удалить пул для этого периода.
+        m_timer.remove(it->first);
+        m_deleteDevsMem(it->second);
+    }
+    m_devs.resize(0);
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_delAllApis()
+{
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        // Освободить идентификаторы подписок.
+        auto & entries = it->second->getEntries();
+        for (auto api = entries.begin(); api != entries.end(); api++)
+            m_freeId((*api)->id);
+
+        // Удалить все файлы API из пула чтения.
+        it->second->removeAll();
+        // Удалить пул для этого периода.
+        m_timer.remove(it->first);
+        m_deleteFilesMem(it->second);
+    }
+    m_apis.resize(0);
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addData(buffer::Buffer & devsData, buffer::Buffer & apisData,
+                          buffer::Buffer & aggData, buffer::Buffer & eventData,
+                          buffer::Buffer & derivedData)
+{
+    std::lock_guard<std::mutex> lock(m_dataMutex);
+
+    auto format = m_format.load();
+    auto encoding = m_encoding.load();
+
+    // Общее время считывания для всех данных тика.
+    m_tickStamp = timers::now();
+    // Собрать группы, время считывания которых наступило.
+    m_collectJobs();
+    // Прочитать группы параллельно.
+    m_pool.run(m_jobsCnt, [this, format, encoding](size_t i) {
+        m_readGroup(m_jobs[i], format, encoding);
+    });
+    // Объединить данные групп в порядке списков устройств и файлов API.
+    m_mergeJobs(devsData, apisData, aggData, eventData, encoding);
+
+    // Вычислить производные каналы по прочитанным значениям.
+    if (m_derived.size())
+    {
+        for (size_t i = 0; i < m_jobsCnt; i++)
+            m_updateDerived(m_jobs[i]);
+        m_addDerived(derivedData);
+    }
+
+    // Добавить значения регистров в уровни детализации записи.
+    if (!m_recorder.isRecording())
+        return;
+
+    for (size_t i = 0; i < m_jobsCnt; i++)
+    {
+        if (m_jobs[i].region)
+            m_recorder.addSamples(m_tickStamp, *m_jobs[i].region);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_collectJobs()
+{
+    m_jobsCnt = 0;
+
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        // Пропустить, если время считывания данных не настало.
+        if (!m_isDue(it->first))
+            continue;
+
+        if (m_jobsCnt == m_jobs.size())
+            m_jobs.emplace_back();
+
+        m_jobs[m_jobsCnt].devs = it->second;
+        m_jobs[m_jobsCnt].apis = nullptr;
+        m_jobsCnt++;
+    }
+
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        // Пропустить, если время считывания данных не настало.
+        if (!m_isDue(it->first))
+            continue;
+
+        if (m_jobsCnt == m_jobs.size())
+            m_jobs.emplace_back();
+
+        m_jobs[m_jobsCnt].devs = nullptr;
+        m_jobs[m_jobsCnt].apis = it->second;
+        m_jobsCnt++;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_readGroup(groupJob_t & job, format_t format,
+                            encoding_t encoding)
+{
+    // Буферы задачи используются повторно.
+    job.data.clear();
+    job.subs.clear();
+    job.aggData.clear();
+    job.aggSubs.clear();
+    job.eventData.clear();
+    job.region = nullptr;
+
+    if (job.devs)
+    {
+        dev::devsRegion_t * region;
+
+        // Прочитать данные из устройств.
+        if (!job.devs->read(&region))
+            return;
+        job.region = region;
+        // Добавить события триггеров (в том числе накопленные при
+        // переполнении очереди).
+        m_addEvents(job.devs->getEvents(), job.eventData);
+        job.devs->clearEvents();
+        // Добавить данные в пакет группы.
+        m_addRegs(job.data, region, format, encoding);
+        m_addDevsSubs(job.devs, job.subs, false);
+        // Добавить агрегаты, окно которых завершилось.
+        m_addAggs(job.devs, job.aggData, job.aggSubs);
+        return;
+    }
+
+    // Прочитать данные из файлов API.
+    job.apis->read(job.data);
+    m_addApisSubs(job.apis, job.subs);
+    m_addEvents(job.apis->getEvents(), job.eventData);
+    job.apis->clearEvents();
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_mergeJobs(buffer::Buffer & devsData,
+                            buffer::Buffer & apisData,
+                            buffer::Buffer & aggData,
+                            buffer::Buffer & eventData, encoding_t encoding)
+{
+    m_devsSubs.clear();
+    m_apisSubs.clear();
+    m_aggSubs.clear();
+
+    for (size_t i = 0; i < m_jobsCnt; i++)
+    {
+        auto & job = m_jobs[i];
+
+        // Агрегаты передаются отдельным пакетом в текстовом виде.
+        if (job.aggData.size())
+        {
+            if (aggData.size())
+                aggData.append(sep::dataSep);
+            aggData.append(job.aggData.data(), job.aggData.size());
+            m_aggSubs.insert(m_aggSubs.end(), job.aggSubs.begin(),
+                             job.aggSubs.end());
+        }
+
+        // События передаются отдельным пакетом.
+        if (job.eventData.size())
+        {
+            if (eventData.size())
+                eventData.append(sep::dataSep);
+            eventData.append(job.eventData.data(), job.eventData.size());
+        }
+
+        if (!job.data.size())
+            continue;
+
+        auto & data = job.devs ? devsData : apisData;
+        auto & subs = job.devs ? m_devsSubs : m_apisSubs;
+
+        // Пометить начало бинарных данных устройств.
+        if (job.devs && encoding == encoding_t::BINARY)
+        {
+            if (!data.size())
+            {
+                data.append(m_binTag);
+                data.append(sep::dataSep);
+            }
+        }
+        // Добавить разделитель между группами.
+        else if (data.size())
+        {
+            data.append(sep::dataSep);
+        }
+
+        data.append(job.data.data(), job.data.size());
+        subs.insert(subs.end(), job.subs.begin(), job.subs.end());
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addPkgToQueue(buffer::Buffer & devsData,
+                                buffer::Buffer & apisData)
+{
+    if (m_framing.load() == framing_t::SPLIT)
+    {
+        // Добавить пакет с данными от устройств (если есть).
+        if (devsData.size())
+            m_pushToQueue(devsData, m_devsSubs);
+        // Добавить пакет с данными от файлов API (если есть).
+        if (apisData.size())
+            m_pushToQueue(apisData, m_apisSubs);
+        return;
+    }
+
+    // Один пакет тика: номер и время считывания, затем разделы с данными.
+    auto & frame = m_pkgData;
+    frame.clear();
+    frame.appendDec(m_tick++);
+    frame.append(sep::dataSep);
+    frame.appendDec(m_tickStamp);
+    m_addSection(s_devSection, devsData, frame);
+    m_addSection(s_apiSection, apisData, frame);
+
+    m_devsSubs.insert(m_devsSubs.end(), m_apisSubs.begin(), m_apisSubs.end());
+    m_pushToQueue(frame, m_devsSubs, ring::type_t::FRAME);
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addSection(const char * name, buffer::Buffer & data,
+                             buffer::Buffer & frame)
+{
+    if (!data.size())
+        return;
+
+    // Размер раздела позволяет пропустить его без разбора (данные устройств
+    // могут быть бинарными).
+    frame.append(sep::dataSep);
+    frame.append(name);
+    frame.append(sep::dataSep);
+    frame.appendDec(data.size());
+    frame.append(sep::dataSep);
+    frame.append(data.data(), data.size());
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_pushToQueue(buffer::Buffer & data,
+                              std::vector<unsigned int> & subs,
+                              ring::type_t type)
+{
+    auto slot = m_dataQ.acquire();
+    // Все слоты очереди заняты - поток отправки не успевает.
+    if (!slot)
+    {
+        LOGGER_WARNING("Statistic queue is full, packet dropped");
+        m_countDrops(subs);
+        return;
+    }
+
+    // Скопировать данные в слот без промежуточной строки.
+    slot->data.clear();
+    slot->data.append(data.data(), data.size());
+    slot->type = type;
+    slot->subs.assign(subs.begin(), subs.end());
+
+    m_dataQ.commit();
+}
+
+//-----------------------------------------------------------------------------
+
+Statistic::queueCfg_t Statistic::m_readQueueConfig()
+{
+    queueCfg_t queueCfg {s_queuePackets, s_queueBytes, overflow_t::DROP_OLDEST};
+
+    auto params = cfg::ini::parseConfig("/opt/control/conf", "tpoprotocol.ini",
+                                        "STATISTIC");
+    if (!params)
+    {
+        LOGGER_WARNING("Can't find parameters for statistic queue, "
+                       "default values are used");
+        return queueCfg;
+    }
+
+    // Чтение ограничений очереди.
+    auto packets = params->getInt("queue-packets", int(s_queuePackets));
+    if (packets > 0)
+        queueCfg.packets = size_t(packets);
+
+    auto bytes = params->getInt("queue-bytes", int(s_queueBytes));
+    if (bytes > 0)
+        queueCfg.bytes = size_t(bytes);
+
+    // Чтение политики переполнения.
+    auto overflow = params->get("overflow", "drop-oldest");
+    auto it = s_overflows.find(overflow);
+    if (it != s_overflows.end())
+        queueCfg.overflow = it->second;
+    else
+        LOGGER_WARNING("Unknown overflow policy \"" + overflow +
+                       "\", drop-oldest is used");
+
+    return queueCfg;
+}
+
+//-----------------------------------------------------------------------------
+
+Statistic::workersCfg_t Statistic::m_readWorkersConfig()
+{
+    // По умолчанию - один поток на ядро без закрепления.
+    workersCfg_t workersCfg {std::thread::hardware_concurrency(), {}};
+
+    auto params = cfg::ini::parseConfig("/opt/control/conf", "tpoprotocol.ini",
+                                        "STATISTIC");
+    if (!params)
+        return workersCfg;
+
+    auto threads = params->getInt("workers", -1);
+    if (threads >= 0)
+        workersCfg.threads = (unsigned int)threads;
+
+    // Ядра для закрепления потоков через запятую.
+    auto cpus = splitString(params->get("workers-cpus", ""), sep::dataSep);
+    for (auto it = cpus.begin(); it != cpus.end(); it++)
+    {
+        if (!it->size() || !std::all_of(it->begin(), it->end(), ::isdigit))
+        {
+            LOGGER_WARNING("Wrong CPU \"" + *it + "\" in workers-cpus");
+            continue;
+        }
+        workersCfg.cpus.push_back(std::stoi(*it));
+    }
+
+    return workersCfg;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::m_isQueueFull()
+{
+    return m_dataQ.size() >= m_queueCfg.packets ||
+           m_dataQ.bytes() >= m_queueCfg.bytes;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::m_isQueueOver()
+{
+    // Последний пакет не отбрасывается, даже если он больше ограничения в байтах.
+    if (m_dataQ.size() <= 1)
+        return false;
+
+    return m_dataQ.size() > m_queueCfg.packets ||
+           m_dataQ.bytes() > m_queueCfg.bytes;
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned int Statistic::m_allocId()
+{
+    for (unsigned int id = 0; id < s_maxSubs; id++)
+    {
+        if (m_usedIds[id])
+            continue;
+
+        m_usedIds[id] = true;
+        // Счетчик потерь ведется заново для новой подписки.
+        m_drops[id] = 0;
+        return id;
+    }
+
+    return s_maxSubs;
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_freeId(unsigned int id)
+{
+    if (id < s_maxSubs)
+        m_usedIds[id] = false;
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_countDrops(std::vector<unsigned int> & subs)
+{
+    for (auto it = subs.begin(); it != subs.end(); it++)
+        m_drops[*it].fetch_add(1, std::memory_order_relaxed);
+
+    m_dropsTotal.fetch_add(subs.size(), std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_dropData()
+{
+    std::lock_guard<std::mutex> lock(m_dataMutex);
+
+    // Устройства и файлы API считываются, чтобы история, триггеры и захваты
+    // не теряли отсчеты, пока очередь заполнена (события и захваты
+    // передаются после освобождения очереди); отбрасываются только данные
+    // тика.
+    m_devsSubs.clear();
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        if (!m_isDue(it->first))
+            continue;
+
+        it->second->sample();
+        // Агрегаты и гистограммы не теряются, их окна продлеваются.
+        m_addDevsSubs(it->second, m_devsSubs, false);
+    }
+
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        if (!m_isDue(it->first))
+            continue;
+
+        it->second->sample();
+        m_addApisSubs(it->second, m_devsSubs);
+    }
+
+    m_countDrops(m_devsSubs);
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_mergeData()
+{
+    std::lock_guard<std::mutex> lock(m_dataMutex);
+
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        if (m_isDue(it->first) && it->second->merge())
+            m_merged = true;
+    }
+
+    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    {
+        if (m_isDue(it->first) && it->second->merge())
+            m_merged = true;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addMergedToQueue()
+{
+    auto & data = m_pkgData;
+    data.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(m_dataMutex);
+        m_devsSubs.clear();
+
+        for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+        {
+            auto & entries = it->second->getEntries();
+            for (auto dev = entries.begin(); dev != entries.end(); dev++)
+            {
+                if (!(*dev)->mergedCnt)
+                    continue;
+
+                if (data.size())
+                    data.append(sep::dataSep);
+
+                m_addMergedReg(*dev, data);
+                m_devsSubs.push_back((*dev)->id);
+                (*dev)->mergedCnt = 0;
+            }
+        }
+
+        for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+        {
+            auto & entries = it->second->getEntries();
+            for (auto api = entries.begin(); api != entries.end(); api++)
+            {
+                if (!(*api)->mergedCnt)
+                    continue;
+
+                if (data.size())
+                    data.append(sep::dataSep);
+
+                // Для файлов API - количество и последнее значение.
+                data.append((*api)->file.second);
+                data.append(sep::dataSep);
+                data.appendDec((*api)->mergedCnt);
+                data.append(sep::dataSep);
+                data.append((*api)->merged);
+                m_devsSubs.push_back((*api)->id);
+                (*api)->mergedCnt = 0;
+                (*api)->merged.clear();
+            }
+        }
+
+        m_merged = false;
+    }
+
+    if (data.size())
+        m_pushToQueue(data, m_devsSubs, ring::type_t::MERGED);
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_delFileFromPool(dev::file_t & file)
+void Statistic::m_addMergedReg(dev::Devices::devEntry_t * entry,
+                               buffer::Buffer & data)
 {
-    // Удалить файл API из списка активных задач.
-    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    // База и количество регистров, количество накопленных считываний.
+    data.appendHex(entry->devInfo.first);
+    data.append(sep::baseSep);
+    data.appendDec(entry->merged.size());
+    data.append(sep::dataSep);
+    data.appendDec(entry->mergedCnt);
+
+    // Минимум, максимум и последнее значение для каждого регистра.
+    for (auto it = entry->merged.begin(); it != entry->merged.end(); it++)
     {
-        // Удалить файл API из пула чтения.
-        if (!it->second->remove(file))
-            continue;
-        // Если это последний файл - удалить пул для этого тика.
-        if (!it->second->isActive())
+        data.append(sep::dataSep);
+        data.appendHex(it->min);
+        data.append(sep::dataSep);
+        data.appendHex(it->max);
+        data.append(sep::dataSep);
+        data.appendHex(it->last);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addDevsSubs(dev::Devices * devs,
+                              std::vector<unsigned int> & subs, bool withAgg)
+{
+    auto & entries = devs->getEntries();
+    for (auto it = entries.begin(); it != entries.end(); it++)
+    {
+        if (withAgg || !((*it)->opts.aggWindow || (*it)->opts.hgramWindow ||
+                         (*it)->opts.quiet))
+            subs.push_back((*it)->id);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addAggs(dev::Devices * devs, buffer::Buffer & data,
+                          std::vector<unsigned int> & subs)
+{
+    auto & ready = devs->getAggReady();
+    for (auto it = ready.begin(); it != ready.end(); it++)
+    {
+        auto entry = *it;
+        auto aggs = devs->getAggregates(entry);
+        auto count = entry->aggCnt;
+
+        if (data.size())
+            data.append(sep::dataSep);
+
+        // Базовый адрес/количество регистров и количество считываний в окне.
+        data.appendHex(entry->devInfo.first);
+        data.append(sep::baseSep);
+        data.appendDec(entry->devInfo.second);
+        data.append(sep::dataSep);
+        data.appendDec(count);
+
+        // Минимум, максимум, среднее, СКО и последнее значение регистров.
+        for (unsigned int i = 0; i < entry->devInfo.second; i++)
         {
-            // Удалить память, выделенную под класс файлов API.
-            m_deleteFilesMem(it->second);
-            // Уменьшить список активных файлов чтения.
-            m_apis.erase(it);
-            break;
+            auto & agg = aggs[i];
+            data.append(sep::dataSep);
+            data.appendHex(agg.min);
+            data.append(sep::dataSep);
+            data.appendHex(agg.max);
+            data.append(sep::dataSep);
+            data.appendDouble(agg.mean, 3, true);
+            data.append(sep::dataSep);
+            data.appendDouble(sqrt(agg.m2 / count), 3, true);
+            data.append(sep::dataSep);
+            data.appendHex(agg.last);
         }
+
+        subs.push_back(entry->id);
     }
-    // Остановить сбор статистики, если это последний файл API в пуле.
-    m_stopStat();
 }
 
 //-----------------------------------------------------------------------------
 
-std::list<Statistic::devJob_t>::const_iterator
-Statistic::m_isDevTickExist(timers::ticks_t & ticks)
+unsigned int Statistic::m_getWindow(double sec, const dev::subOpts_t & opts,
+                                    timers::period_t & period)
+{
+    if (sec <= 0)
+        return 0;
+
+    // Окно содержит хотя бы одно значение.
+    auto window = llround(sec * 1e9 / (double(period) * m_getDecim(opts)));
+    return (unsigned int)std::max(1LL, window);
+}
+
+//-----------------------------------------------------------------------------
+
+dev::Devices::devEntry_t * Statistic::m_findDev(uint32_t & addr,
+                                                dev::Devices ** devs)
 {
     for (auto it = m_devs.begin(); it != m_devs.end(); it++)
     {
-        if (ticks == it->first)
-            return it;
+        auto & entries = it->second->getEntries();
+        for (auto entry = entries.begin(); entry != entries.end(); entry++)
+        {
+            if ((*entry)->devInfo.first == addr)
+            {
+                *devs = it->second;
+                return *entry;
+            }
+        }
     }
 
-    return m_devs.end();
+    return nullptr;
 }
 
 //-----------------------------------------------------------------------------
 
-std::list<Statistic::apiJob_t>::const_iterator
-Statistic::m_isFileTickExist(timers::ticks_t & ticks)
+double Statistic::m_getDecim(const dev::subOpts_t & opts)
 {
-    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    // Фильтры с прореживанием выдают одно значение на N считываний.
+    double decim = 1;
+    for (auto it = opts.filters.begin(); it != opts.filters.end(); it++)
     {
-        if (ticks == it->first)
-            return it;
+        if (it->type != dev::filter_t::EMA)
+            decim *= it->n;
     }
 
-    return m_apis.end();
+    return decim;
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_addDev(dev::devInfo_t & dev, timers::ticks_t & ticks)
+bool Statistic::m_getHistSamples(dev::subOpts_t & opts, unsigned int regs,
+                                 timers::period_t & period)
 {
-    auto it = m_isDevTickExist(ticks);
-    // Добавить устройство, если такая частота считывания уже есть.
-    if (it != m_devs.end())
+    opts.histSamples = 0;
+    if (opts.histSec <= 0 && opts.histMb <= 0)
+        return true;
+
+    auto recordSize = (dev::Devices::s_stampWords + regs) * sizeof(uint32_t);
+    double samples;
+    if (opts.histMb > 0)
+        samples = opts.histMb * 1024 * 1024 / recordSize;
+    else
+        samples = opts.histSec * 1e9 / (double(period) * m_getDecim(opts));
+
+    // Память истории выделяется сразу, поэтому ее размер ограничен.
+    samples = std::max(1.0, floor(samples));
+    if (samples * recordSize > s_maxHistoryBytes)
     {
-        LOGGER_DEBUG("Dev read frequency exists");
-        it->second->add(dev);
-        return;
+        LOGGER_ERROR("History is too large");
+        return false;
     }
-    LOGGER_DEBUG("Dev read frequency isn't exist");
 
-    // Создать класс, который будет обслуживать устройства с такой частотой считывания.
-    dev::Devices * devs = new dev::Devices(dev);
-    devJob_t pair{ticks, devs};
-    m_devs.push_back(pair);
+    opts.histSamples = (unsigned int)samples;
+    return true;
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_addFile(dev::file_t & file, timers::ticks_t & ticks)
+size_t Statistic::m_getSubBytes(const dev::subOpts_t & opts, unsigned int regs)
 {
-    auto it = m_isFileTickExist(ticks);
-    // Добавить файл API, если такая частота считывания уже есть.
-    if (it != m_apis.end())
+    // Запись истории и отсчет захвата - метка времени и значения регистров.
+    auto sampleSize = sizeof(uint64_t) + size_t(regs) * sizeof(uint32_t);
+    auto bytes = size_t(opts.histSamples) * sampleSize;
+
+    // Буфер последних отсчетов и сам захват.
+    if (opts.capPre || opts.capPost)
+        bytes += (size_t(opts.capPre) * 2 + opts.capPost + 1) * sampleSize;
+
+    return bytes;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Statistic::m_checkSubsBytes(const dev::subOpts_t & opts, unsigned int regs,
+                                 dev::Devices::devEntry_t * skip)
+{
+    auto total = m_getSubBytes(opts, regs);
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
     {
-        LOGGER_DEBUG("Api read frequency exists");
-        it->second->add(file);
-        return;
+        auto & entries = it->second->getEntries();
+        for (auto dev = entries.begin(); dev != entries.end(); dev++)
+        {
+            if (*dev != skip)
+                total += m_getSubBytes((*dev)->opts, (*dev)->devInfo.second);
+        }
     }
-    LOGGER_DEBUG("Api read frequency isn't exist");
 
-    // Создать класс, который будет обслуживать файлы API с такой частотой считывания.
-    dev::DevsApi * apis = new dev::DevsApi(file);
-    apiJob_t pair{ticks, apis};
-    m_apis.push_back(pair);
+    if (total > s_maxSubsBytes)
+    {
+        LOGGER_ERROR("Subscription buffers exceed the total memory limit");
+        return false;
+    }
+
+    return true;
 }
 
 //-----------------------------------------------------------------------------
 
-std::string Statistic::m_getFreq(timers::ticks_t & ticks)
+bool Statistic::m_hasSubOpts(const dev::subOpts_t & opts)
+{
+    return opts.aggSec || opts.filters.size() || opts.quiet ||
+           opts.histSec || opts.histMb || opts.hgramSec || opts.capPre ||
+           opts.capPost;
+}
+
+//-----------------------------------------------------------------------------
+
+std::string Statistic::m_getOpts(const dev::subOpts_t & opts)
 {
     std::stringstream pkg;
-    pkg << m_timer.ticksToHz(ticks);
+    for (auto it = opts.filters.begin(); it != opts.filters.end(); it++)
+    {
+        switch (it->type)
+        {
+        case dev::filter_t::BOX: pkg << ":box=" << it->n; break;
+        case dev::filter_t::EMA: pkg << ":ema=" << it->alpha; break;
+        case dev::filter_t::CIC: pkg << ":cic=" << it->n; break;
+        }
+    }
+
+    if (opts.aggSec)
+        pkg << ":agg=" << opts.aggSec;
+    if (opts.hgramSec)
+    {
+        pkg << ":hgram=" << opts.hgramSec;
+        if (opts.hgramBins)
+            pkg << ":bins=" << opts.hgramBins << ":lo=" << opts.hgramLo
+                << ":hi=" << opts.hgramHi;
+        else
+            pkg << ":sub=" << opts.hgramSub;
+    }
+    if (opts.histMb)
+        pkg << ":histmb=" << opts.histMb;
+    else if (opts.histSec)
+        pkg << ":hist=" << opts.histSec;
+
+    // Захват подразумевает подписку без передачи данных.
+    if (opts.capPre || opts.capPost)
+        pkg << ":pre=" << std::dec << opts.capPre << ":post=" << opts.capPost;
+    else if (opts.quiet)
+        pkg << ":quiet=1";
 
     return pkg.str();
 }
 
 //-----------------------------------------------------------------------------
 
-std::string Statistic::m_getHexAddr(uint32_t & addr)
+void Statistic::m_addEvents(const trig::events_t & events,
+                            buffer::Buffer & data)
 {
-    std::stringstream pkg;
-    pkg << "0x" << std::setfill('0') << std::setw(8) << std::hex << addr;
+    // Идентификатор триггера, регистр/файл API, значение, фронт и время.
+    for (auto it = events.begin(); it != events.end(); it++)
+    {
+        if (data.size())
+            data.append(sep::dataSep);
+
+        data.appendDec(it->id);
+        data.append(sep::dataSep);
+        data.append(it->source);
+        data.append(sep::dataSep);
+        data.append(it->value);
+        data.append(sep::dataSep);
+        data.append(it->rise ? "RISE" : "FALL");
+        data.append(sep::dataSep);
+        data.appendDec(it->stamp);
+    }
+}
 
-    return pkg.str();
+//-----------------------------------------------------------------------------
+
+std::string Statistic::m_getTrigDef(const trig::params_t & params)
+{
+    std::stringstream def;
+    switch (params.cond)
+    {
+    case trig::cond_t::GT: def << "gt=" << params.level; break;
+    case trig::cond_t::LT: def << "lt=" << params.level; break;
+    case trig::cond_t::MASK:
+        def << "mask=" << m_getHexAddr(params.mask) << sep::baseSep
+            << m_getHexAddr(params.pattern);
+        break;
+    }
+
+    if (params.hyst)
+        def << sep::optSep << "hyst=" << params.hyst;
+    if (params.debounce > 1)
+        def << sep::optSep << "deb=" << std::dec << params.debounce;
+    if (params.edge == trig::edge_t::FALL)
+        def << sep::optSep << "edge=fall";
+    else if (params.edge == trig::edge_t::BOTH)
+        def << sep::optSep << "edge=both";
+
+    return def.str();
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_delAllDevs()
+void Statistic::m_addCaptures()
 {
-    // Удалить все устройства из списка активных задач.
+    std::lock_guard<std::mutex> lock(m_dataMutex);
     for (auto it = m_devs.begin(); it != m_devs.end(); it++)
     {
-        // Удалить все устройства из пула.
-        it->second->removeAll();
-        // Удалить пул для этого тика.
-        m_deleteDevsMem(it->second);
+        auto & entries = it->second->getEntries();
+        for (auto dev = entries.begin(); dev != entries.end(); dev++)
+        {
+            if ((*dev)->capture.state != dev::Devices::capState_t::READY)
+                continue;
+
+            // Захват освобождается (и может начаться следующий) только после
+            // передачи всех частей.
+            if (m_pushCapture(*dev))
+                it->second->releaseCapture(*dev);
+        }
     }
-    m_devs.resize(0);
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_delAllApis()
+bool Statistic::m_pushCapture(dev::Devices::devEntry_t * entry)
 {
-    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    auto & cap = entry->capture;
+    auto regs = entry->devInfo.second;
+    std::vector<unsigned int> subs {entry->id};
+
+    // Идентификатор назначается при передаче первой части.
+    if (!cap.id)
+        cap.id = m_nextCapture++;
+
+    // Части содержат целое количество отсчетов.
+    auto sampleSize = sizeof(uint64_t) + regs * sizeof(uint32_t);
+    auto perChunk = std::max(size_t(1), s_chunkSize / sampleSize);
+    auto chunks = (cap.count + perChunk - 1) / perChunk;
+    auto & data = m_pkgData;
+
+    // Части добавляются, пока для них есть место в очереди; остальные
+    // передаются в следующих тиках, когда поток отправки освободит очередь.
+    // Так захват любого размера не вытесняет сам себя и не теряется при
+    // переполнении.
+    for (; cap.sent < chunks; cap.sent++)
     {
-        // Удалить все файлы API из пула чтения.
-        it->second->removeAll();
-        // Удалить пул для этого тика.
-        m_deleteFilesMem(it->second);
+        auto chunk = cap.sent;
+        auto first = chunk * perChunk;
+        auto last = std::min(cap.count, first + perChunk);
+
+        // Заголовок части: идентификатор захвата, номер части и количество
+        // частей, устройство, триггер, отсчеты до срабатывания и после него,
+        // номер первого отсчета части и количество отсчетов в части.
+        data.clear();
+        data.appendDec(cap.id);
+        data.append(sep::dataSep);
+        data.appendDec(chunk);
+        data.append(sep::baseSep);
+        data.appendDec(chunks);
+        data.append(sep::dataSep);
+        data.appendHex(entry->devInfo.first);
+        data.append(sep::baseSep);
+        data.appendDec(regs);
+        data.append(sep::dataSep);
+        data.appendDec(cap.trigger);
+        data.append(sep::dataSep);
+        data.appendDec(cap.pre);
+        data.append(sep::dataSep);
+        data.appendDec(cap.count - cap.pre - 1);
+        data.append(sep::dataSep);
+        data.appendDec(first);
+        data.append(sep::dataSep);
+        data.appendDec(last - first);
+        data.append(sep::dataSep);
+        data.append(m_binTag);
+        data.append(sep::dataSep);
+
+        // Отсчеты: метка времени (64 бита) и значения регистров.
+        for (auto i = first; i < last; i++)
+        {
+            data.appendWord(uint32_t(cap.stamps[i]));
+            data.appendWord(uint32_t(cap.stamps[i] >> 32));
+            for (unsigned int reg = 0; reg < regs; reg++)
+                data.appendWord(cap.data[i * regs + reg]);
+        }
+
+        if (!m_hasCaptureRoom(data.size()))
+            return false;
+
+        m_pushToQueue(data, subs, ring::type_t::CAPTURE);
     }
-    m_apis.resize(0);
+
+    return true;
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_addData(std::stringstream & devsData,
-                          std::stringstream & apisData)
+bool Statistic::m_hasCaptureRoom(size_t bytes)
 {
+    if (!m_dataQ.size())
+        return true;
+
+    return m_dataQ.size() + 1 <= m_queueCfg.packets / 2 &&
+           m_dataQ.bytes() + bytes <= m_queueCfg.bytes / 2;
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addHgrams()
+{
+    auto & data = m_pkgData;
+    std::vector<unsigned int> subs;
+
+    data.clear();
+
     std::lock_guard<std::mutex> lock(m_dataMutex);
+    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    {
+        auto & entries = it->second->getEntries();
+        for (auto dev = entries.begin(); dev != entries.end(); dev++)
+        {
+            if (!it->second->isHgramReady(*dev))
+                continue;
+
+            if (data.size())
+                data.append(sep::dataSep);
+            m_addHgram(*dev, data);
+            subs.push_back((*dev)->id);
+            it->second->releaseHgram(*dev);
+        }
+    }
 
-    // Пройти по списку устройств и если время считывания совпадает, то добавить данные в пакет.
-    m_addDevsData(devsData);
-    // Пройти по списку файлов API и если время считывания совпадает, то добавить данные в пакет.
-    m_addApisData(apisData);
+    if (data.size())
+        m_pushToQueue(data, subs, ring::type_t::HGRAM);
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_addPkgToQueue(std::stringstream & devsData,
-                                std::stringstream & apisData)
+void Statistic::m_addHgram(dev::Devices::devEntry_t * entry,
+                           buffer::Buffer & data)
 {
-    std::lock_guard<std::mutex> lock(m_dataQMutex);
+    auto & opts = entry->opts;
+    auto size = entry->hgramBuckets.getSize();
+
+    // Базовый адрес/количество регистров, количество значений за период и
+    // интервалы ("lin/<lo>/<hi>/<bins>" или "log/<sub>").
+    data.appendHex(entry->devInfo.first);
+    data.append(sep::baseSep);
+    data.appendDec(entry->devInfo.second);
+    data.append(sep::dataSep);
+    data.appendDec(entry->hgramCnt);
+    data.append(sep::dataSep);
+    if (opts.hgramBins)
+    {
+        data.append("lin");
+        data.append(sep::baseSep);
+        data.appendDouble(opts.hgramLo, s_hgramPrecision);
+        data.append(sep::baseSep);
+        data.appendDouble(opts.hgramHi, s_hgramPrecision);
+        data.append(sep::baseSep);
+        data.appendDec(opts.hgramBins);
+    }
+    else
+    {
+        data.append("log");
+        data.append(sep::baseSep);
+        data.appendDec(opts.hgramSub);
+    }
 
-    // СОВМЕСТИТЬ ДАННЫЕ ???
+    // Для каждого регистра количество непустых интервалов и пары
+    // "номер интервала/количество значений".
+    for (unsigned int reg = 0; reg < entry->devInfo.second; reg++)
+    {
+        auto counts = &entry->hgramCounts[reg * size];
+        data.append(sep::dataSep);
+        data.appendDec(size - size_t(std::count(counts, counts + size, 0u)));
+        for (size_t i = 0; i < size; i++)
+        {
+            if (!counts[i])
+                continue;
 
-    // Добавить пакет с данными от устройств (если есть).
-    if (devsData.str().size())
-        m_dataQ.push(std::move(devsData));
-    // Добавить пакет с данными от файлов API (если есть).
-    if (apisData.str().size())
-        m_dataQ.push(std::move(apisData));
+            data.append(sep::dataSep);
+            data.appendDec(i);
+            data.append(sep::baseSep);
+            data.appendDec(counts[i]);
+        }
+    }
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_addDevsData(std::stringstream & devsData)
+void Statistic::m_readDerivedConfig()
 {
-    dev::devsRegion_t * region;
+    auto params = cfg::ini::parseConfig("/opt/control/conf", "tpoprotocol.ini",
+                                        "DERIVED");
+    if (!params)
+        return;
 
-    for (auto it = m_devs.begin(); it != m_devs.end(); it++)
+    auto keys = params->getKeys();
+    for (auto it = keys.begin(); it != keys.end(); it++)
     {
-        // Пропустить, если время считывания данных не настало.
-        if (!m_timer.isNow(it->first))
+        std::string error;
+        if (addDerived(*it, params->get(*it), error))
             continue;
 
-        // Прочитать данные из устройств.
-        it->second->read(&region);
-        // Добавить данные в пакет.
-        m_addRegs(devsData, region);
+        std::stringstream msg;
+        msg << "Derived channel \"" << *it << "\" isn't added: " << error;
+        LOGGER_ERROR(msg.str());
     }
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_addApisData(std::stringstream & apisData)
+void Statistic::m_indexDerived()
 {
-    for (auto it = m_apis.begin(); it != m_apis.end(); it++)
+    m_derivedRegs.clear();
+    m_derivedApis.clear();
+
+    for (size_t i = 0; i < m_derived.size(); i++)
     {
-        // Пропустить, если время считывания данных не настало.
-        if (!m_timer.isNow(it->first))
+        auto & sources = m_derived[i].program.getSources();
+        for (size_t j = 0; j < sources.size(); j++)
+        {
+            if (sources[j].api)
+                m_derivedApis.insert({sources[j].alias, {i, j}});
+            else
+                m_derivedRegs.insert({sources[j].addr, {i, j}});
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_updateDerived(groupJob_t & job)
+{
+    if (job.apis)
+    {
+        auto & entries = job.apis->getEntries();
+        for (auto it = entries.begin(); it != entries.end(); it++)
+        {
+            if (!(*it)->numeric)
+                continue;
+
+            auto range = m_derivedApis.equal_range((*it)->file.second);
+            for (auto src = range.first; src != range.second; src++)
+                m_setDerivedSrc(src->second, (*it)->number);
+        }
+        return;
+    }
+
+    // Группа не прочитана.
+    if (!job.region)
+        return;
+
+    // Регистры устройства находятся по диапазону адресов (с учетом устройств
+    // без передачи данных).
+    auto & entries = job.devs->getEntries();
+    for (auto it = entries.begin(); it != entries.end(); it++)
+    {
+        if (!(*it)->sampleReady)
             continue;
 
-        // Прочитать данные из устройств.
-        it->second->read(apisData);
+        auto base = (*it)->devInfo.first;
+        auto end = uint64_t(base) + uint64_t((*it)->devInfo.second) * sizeof(uint32_t);
+        auto & region = *(*it)->region;
+        for (auto src = m_derivedRegs.lower_bound(base);
+             src != m_derivedRegs.end() && src->first < end; src++)
+        {
+            auto index = (src->first - base) / sizeof(uint32_t);
+            m_setDerivedSrc(src->second, region[index].second);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_setDerivedSrc(const derivedSrc_t & src, double value)
+{
+    auto & channel = m_derived[src.first];
+    if (!channel.seen[src.second])
+    {
+        channel.seen[src.second] = true;
+        channel.missing--;
+    }
+
+    channel.values[src.second] = value;
+    channel.updated = true;
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addDerived(buffer::Buffer & data)
+{
+    for (auto it = m_derived.begin(); it != m_derived.end(); it++)
+    {
+        // Канал вычисляется, когда прочитаны все его источники.
+        if (!it->updated || it->missing)
+            continue;
+
+        it->updated = false;
+        if (data.size())
+            data.append(sep::dataSep);
+        data.append(it->name);
+        data.append(sep::dataSep);
+        data.appendDouble(it->program.run(it->values.data()),
+                          s_derivedPrecision);
     }
 }
 
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addApisSubs(dev::DevsApi * apis,
+                              std::vector<unsigned int> & subs)
+{
+    auto & entries = apis->getEntries();
+    for (auto it = entries.begin(); it != entries.end(); it++)
+        subs.push_back((*it)->id);
+}
+
+
 //-----------------------------------------------------------------------------
 
 void Statistic::m_parseData()
 {
-    std::stringstream devsData;
-    std::stringstream apisData;
+    // Буферы тика используются повторно.
+    m_devsData.clear();
+    m_apisData.clear();
+    m_aggData.clear();
+    m_eventData.clear();
+    m_derivedData.clear();
+
+    // Очередь заполнена - применить политику переполнения (DROP_OLDEST
+    // выполняется потоком отправки).
+    if (m_queueCfg.overflow != overflow_t::DROP_OLDEST && m_isQueueFull())
+    {
+        if (m_queueCfg.overflow == overflow_t::MERGE)
+            m_mergeData();
+        else
+            m_dropData();
+        return;
+    }
+
+    // Передать накопленные данные, когда в очереди появилось место.
+    if (m_merged)
+        m_addMergedToQueue();
 
     // Добавить данные устройств/API, если они имеются.
-    m_addData(devsData, apisData);
+    m_addData(m_devsData, m_apisData, m_aggData, m_eventData, m_derivedData);
+
+    // События передаются раньше данных тика.
+    if (m_eventData.size())
+    {
+        std::vector<unsigned int> noSubs;
+        m_pushToQueue(m_eventData, noSubs, ring::type_t::EVENT);
+    }
+
+    // Передать захваты, собранные после срабатывания триггеров.
+    m_addCaptures();
+
+    // Добавить агрегаты, окно которых завершилось.
+    if (m_aggData.size())
+        m_pushToQueue(m_aggData, m_aggSubs, ring::type_t::AGG);
+
+    // Передать гистограммы, период которых завершился.
+    m_addHgrams();
+
+    // Добавить значения производных каналов.
+    if (m_derivedData.size())
+    {
+        std::vector<unsigned int> noSubs;
+        m_pushToQueue(m_derivedData, noSubs, ring::type_t::DERIVED);
+    }
 
     // Когда не было считанных данных.
-    if (!(devsData.str().size() || apisData.str().size()))
+    if (!(m_devsData.size() || m_apisData.size()))
         return;
 
-    // Добавить сформированный пакет в очередь пакетов.
-    m_addPkgToQueue(devsData, apisData);
+    // Добавить сформированный пакет в очередь пакетов (с оповещением потока отправки).
+    m_addPkgToQueue(m_devsData, m_apisData);
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addReg(dev::region_t & reg, buffer::Buffer & data,
+                         format_t format, encoding_t encoding)
+{
+    if (encoding == encoding_t::BINARY)
+    {
+        if (format == format_t::COMPACT)
+            m_addRegBinCompact(reg, data);
+        else
+            m_addRegBin(reg, data);
+        return;
+    }
 
-    // Оповестить ждущий поток, что есть данные для считывания.
-    m_pkg->notify_one();
+    if (format == format_t::COMPACT)
+        m_addRegTextCompact(reg, data);
+    else
+        m_addRegText(reg, data);
 }
 
 //-----------------------------------------------------------------------------
 
-void Statistic::m_addReg(dev::region_t & reg, std::stringstream & data)
+void Statistic::m_addRegText(dev::region_t & reg, buffer::Buffer & data)
 {
     for (auto it = reg.begin(); it != reg.end(); )
     {
-        data << m_getHexAddr(it->first);
-        data << sep::dataSep;
-        data << m_getHexAddr(it->second);
+        data.appendHex(it->first);
+        data.append(sep::dataSep);
+        data.appendHex(it->second);
 
         if (++it != reg.end())
-            data << sep::dataSep;
+            data.append(sep::dataSep);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addRegTextCompact(dev::region_t & reg,
+                                    buffer::Buffer & data)
+{
+    if (!reg.size())
+        return;
+
+    // Базовый адрес и количество регистров указываются один раз.
+    data.appendHex(reg.front().first);
+    data.append(sep::baseSep);
+    data.appendDec(reg.size());
+
+    for (auto it = reg.begin(); it != reg.end(); it++)
+    {
+        data.append(sep::dataSep);
+        data.appendHex(it->second);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addRegBin(dev::region_t & reg, buffer::Buffer & data)
+{
+    for (auto it = reg.begin(); it != reg.end(); it++)
+    {
+        data.appendWord(it->first);
+        data.appendWord(it->second);
     }
 }
 
+//-----------------------------------------------------------------------------
+
+void Statistic::m_addRegBinCompact(dev::region_t & reg,
+                                   buffer::Buffer & data)
+{
+    if (!reg.size())
+        return;
+
+    // Базовый адрес и количество регистров указываются один раз.
+    data.appendWord(reg.front().first);
+    data.appendWord(uint32_t(reg.size()));
+
+    for (auto it = reg.begin(); it != reg.end(); it++)
+        data.appendWord(it->second);
+}
+
 //=============================================================================
 
 } // namespace stat
@@ -4,37 +4,78 @@
 //-----------------------------------------------------------------------------
 
 #include <list>
-#include <queue>
-#include <condition_variable>
+#include <map>
+#include <memory>
 #include <thread>
 #include <atomic>
 
 #include "device.h"
 #include "timers.h"
 #include "devapi.h"
+#include "ring.h"
+#include "workers.h"
+#include "hirate.h"
+#include "recorder.h"
+#include "expr.h"
 
 namespace statistic
 {
 
 //=============================================================================
 
+// Формат записи регионов устройств.
+enum class format_t
+{
+    LEGACY,     // Адрес и значение для каждого регистра.
+    COMPACT     // Базовый адрес и количество регистров, затем только значения.
+};
+
+// Кодирование данных устройств в пакете.
+enum class encoding_t
+{
+    TEXT,       // HEX-строки, разделенные запятыми.
+    BINARY      // 32-битные слова в порядке little-endian.
+};
+
+// Передача данных тика.
+enum class framing_t
+{
+    SPLIT,      // Отдельные пакеты для данных устройств и файлов API.
+    FRAME       // Один пакет тика с разделами устройств и файлов API.
+};
+
+// Политика при переполнении очереди пакетов.
+enum class overflow_t
+{
+    DROP_OLDEST,    // Отбросить самые старые пакеты в очереди.
+    DROP_NEWEST,    // Отбросить новые данные.
+    MERGE           // Накапливать новые данные до освобождения очереди.
+};
+
+//-----------------------------------------------------------------------------
+
 class Statistic
 {
 public:
 
-    Statistic(std::condition_variable * notify);
+    Statistic();
     ~Statistic();
 
     //-------------------------------------------------------------------------
 
     // Добавить устройство к пулу.
-    bool addDev(dev::devInfo_t & dev, timers::hz_t hz);
+    bool addDev(dev::devInfo_t & dev, timers::hz_t hz,
+                const dev::subOpts_t & opts = dev::subOpts_t());
     // Добавить файл API к пулу чтения.
     bool addFile(dev::file_t & file, timers::hz_t hz);
     // Удалить устройство из пула.
     bool delDev(uint32_t & addr);
     // Удалить файл API из пула.
     bool delFile(dev::file_t & file);
+    // Изменить частоту считывания активного устройства (без повторного отображения).
+    bool modDev(uint32_t & addr, timers::hz_t hz);
+    // Изменить частоту считывания активного файла API (без повторного открытия).
+    bool modFile(dev::file_t & file, timers::hz_t hz);
     // Вернуть список устройств, для которых собирается статистика.
     void getActiveDevs(std::stringstream & pkg);
     // Вернуть список файлов API, для которых собирается статистика.
@@ -43,13 +84,94 @@ public:
     bool readDevOnce(dev::devInfo_t & devInfo, std::stringstream & data);
     // Прочитать файл API один раз.
     bool readApiOnce(dev::file_t & fileInfo, std::stringstream & data);
+    // Прочитать устройство count раз подряд без пауз и записать отсчеты в
+    // data частями для отправки (ends - смещения концов частей).
+    bool readBurst(dev::devInfo_t & devInfo, unsigned int count,
+                   buffer::Buffer & data, std::vector<size_t> & ends);
 
     //-------------------------------------------------------------------------
 
-    // Прочитать статистику ждущим потоком.
-    bool readStatistic(std::stringstream & pkg);
+    // Установить формат записи регионов устройств и передачу данных тика.
+    void setFormat(format_t format, encoding_t encoding, framing_t framing);
+    // Получить текущий формат записи регионов устройств.
+    format_t getFormat();
+    // Получить текущее кодирование данных устройств.
+    encoding_t getEncoding();
+    // Получить текущую передачу данных тика.
+    framing_t getFraming();
+
+    //-------------------------------------------------------------------------
+
+    // Ожидать готовых пакетов со статистикой (блокирующая функция).
+    bool waitStatistic();
+    // Прервать ожидание пакетов (для остановки потока отправки).
+    void wakeStatistic();
+    // Получить до max самых старых пакетов со статистикой (возвращает количество).
+    size_t readStatistic(ring::pkg_t ** pkgs, size_t max);
+    // Освободить пакеты, полученные через readStatistic, после отправки.
+    void releaseStatistic(ring::pkg_t ** pkgs, size_t count);
     // Остановить сбор статистики.
     void stopStatistic();
+    // Вернуть состояние очереди пакетов и количество потерянных данных по подпискам.
+    void getQueueInfo(std::stringstream & pkg);
+    // Вернуть точность пробуждений планировщика сроков считывания.
+    void getSchedInfo(std::stringstream & pkg);
+
+    //-------------------------------------------------------------------------
+
+    // Добавить триггер на регистр считываемого устройства (id - идентификатор
+    // триггера).
+    bool addTrigger(uint32_t & addr, const trig::params_t & params,
+                    unsigned int & id);
+    // Добавить триггер на значение считываемого файла API.
+    bool addTrigger(dev::file_t & file, const trig::params_t & params,
+                    unsigned int & id);
+    // Удалить триггер.
+    bool delTrigger(unsigned int id);
+    // Вернуть список триггеров (идентификатор, регистр/файл API, условие).
+    void getTriggers(std::stringstream & pkg);
+
+    //-------------------------------------------------------------------------
+
+    // Вернуть состояние истории устройства (false - устройство не считывается
+    // или история не ведется).
+    bool getHistoryInfo(uint32_t & addr, std::stringstream & pkg);
+    // Вернуть отсчеты истории устройства в диапазоне номеров или меток времени
+    // (включительно) частями для отправки.
+    bool getHistory(uint32_t & addr, bool byTime, uint64_t from, uint64_t to,
+                    std::vector<std::string> & chunks);
+
+    //-------------------------------------------------------------------------
+
+    // Начать запись отправляемых пакетов на накопитель (columnar - данные
+    // устройств хранятся колоночными блоками отсчетов).
+    bool startRecord(const std::string & name, bool columnar);
+    // Остановить запись (info - имя, количество пакетов и байт записи).
+    bool stopRecord(std::stringstream & info);
+    // Проверить идет ли запись.
+    bool isRecording();
+    // Вернуть список записей.
+    void getRecords(std::stringstream & pkg);
+    // Начать воспроизведение записи (realtime - с исходными интервалами).
+    bool replayRecord(const std::string & name, bool realtime, uint64_t from);
+    // Остановить воспроизведение записи.
+    bool stopReplay();
+    // Вернуть минимум/максимум/среднее регистра записи в диапазоне меток
+    // времени (не больше points интервалов) частями для отправки.
+    bool getRecordLod(const std::string & name, uint32_t & addr, uint64_t from,
+                      uint64_t to, size_t points,
+                      std::vector<std::string> & chunks);
+
+    //-------------------------------------------------------------------------
+
+    // Добавить или заменить производный канал (false - недопустимое имя или
+    // ошибка в выражении, error - описание).
+    bool addDerived(const std::string & name, const std::string & def,
+                    std::string & error);
+    // Удалить производный канал.
+    bool delDerived(const std::string & name);
+    // Вернуть список производных каналов (имя и выражение).
+    void getDerived(std::stringstream & pkg);
 
     //-------------------------------------------------------------------------
 
@@ -61,14 +183,14 @@ private:
     //-------------------------------------------------------------------------
 
     // Задача для устройств (частота считывания и указатель на класс устройств).
-    typedef std::pair<timers::ticks_t, dev::Devices *> devJob_t;
+    typedef std::pair<timers::period_t, dev::Devices *> devJob_t;
     // Список устройств, для которых собирается статистика.
     std::list<devJob_t> m_devs;
 
     //-------------------------------------------------------------------------
 
     // Задача для файлов API (частота считывания и указатель на класс файлов API).
-    typedef std::pair<timers::ticks_t, dev::DevsApi *> apiJob_t;
+    typedef std::pair<timers::period_t, dev::DevsApi *> apiJob_t;
     // Список файлов API, для которых собирается статистика.
     std::list<apiJob_t> m_apis;
 
@@ -79,41 +201,345 @@ private:
 
     //-------------------------------------------------------------------------
 
+    // Устройство последней пачки считываний: отображение сохраняется для
+    // следующих пачек того же устройства.
+    std::unique_ptr<dev::Device> m_burstDev;
+    dev::devInfo_t m_burstInfo;
+    // Буферы отсчетов пачки (общие для всех устройств, емкость сохраняется
+    // между пачками).
+    std::vector<uint64_t> m_burstStamps;
+    std::vector<uint32_t> m_burstData;
+    // Для пачек считываний из нескольких подключений.
+    std::mutex m_burstMutex;
+
+    //-------------------------------------------------------------------------
+
+    // Триггер для списка (копируется под m_dataMutex).
+    typedef struct trigEntry
+    {
+        unsigned int id;        // Идентификатор триггера.
+        uint32_t addr;          // Адрес регистра (0 - триггер файла API).
+        std::string file;       // Файл API.
+        trig::params_t params;  // Условие.
+    } trigEntry_t;
+
+    // Данные для ответов на запросы истории, уровней детализации записи и
+    // списка триггеров: данные копируются под m_dataMutex, а ответ
+    // формируется после его освобождения, чтобы не задерживать сбор
+    // статистики (емкость сохраняется между запросами).
+    std::vector<uint32_t> m_replyWords;
+    std::vector<trigEntry_t> m_replyTrigs;
+    buffer::Buffer m_replyBuf;
+    // Для ответов на запросы из нескольких подключений.
+    std::mutex m_replyMutex;
+
+    //-------------------------------------------------------------------------
+
     // Проверить есть ли такое устройство в списке активных.
     bool m_isDevExist(uint32_t & addr);
+    // Добавить устройство для высокочастотного считывания.
+    bool m_addHighRate(dev::devInfo_t & dev, timers::hz_t hz);
+    // Изменить частоту, если устройство считывается или будет считываться
+    // высокочастотно (отображение переходит вместе с устройством).
+    bool m_modHighRate(uint32_t & addr, timers::hz_t hz);
     // Проверить существует ли такой файл API в списке активных.
     bool m_isFileExist(dev::file_t & fileName);
 
     //-------------------------------------------------------------------------
 
-    // Очередь сформированных пакетов для отправки пользователю.
-    std::queue<std::stringstream> m_dataQ;
-    // Мьютекс для работы с очередью пакетов.
-    std::mutex m_dataQMutex;
-    // Для оповещения ждущего сервера, что есть готовый пакет для отправки.
-    std::shared_ptr<std::condition_variable> m_pkg;
+    // Параметры очереди пакетов.
+    typedef struct queueCfg
+    {
+        size_t packets;         // Максимальное количество пакетов в очереди.
+        size_t bytes;           // Максимальное количество байт в очереди.
+        overflow_t overflow;    // Политика при переполнении.
+    } queueCfg_t;
+
+    // Имена политик переполнения очереди (в конфигурационном файле и ответах).
+    static const std::map<std::string, overflow_t> s_overflows;
+    // Начальный размер пакета в очереди на отправку.
+    static const size_t s_slotCapacity = 8192;
+    // Параметры очереди по умолчанию.
+    static const size_t s_queuePackets = 256;
+    static const size_t s_queueBytes = 2 * 1024 * 1024;
+
+    // Параметры очереди пакетов (читаются из конфигурационного файла).
+    queueCfg_t m_queueCfg;
+    // Очередь сформированных пакетов для отправки пользователю (поток сбора
+    // статистики - производитель, поток отправки - потребитель).
+    ring::PkgRing m_dataQ;
+    // Высокочастотное считывание (своя очередь пакетов с оповещением через
+    // eventfd очереди m_dataQ, поэтому поток отправки ожидает обе очереди).
+    hirate::Sampler m_hirate;
+    // Запись отправляемых пакетов и их воспроизведение (своя очередь пакетов
+    // с оповещением через eventfd очереди m_dataQ).
+    rec::Recorder m_recorder;
+    // Количество пакетов из m_dataQ и m_hirate в последней пачке readStatistic.
+    size_t m_readCnt;
+    size_t m_hirateCnt;
+
+    // Прочитать параметры очереди из конфигурационного файла.
+    queueCfg_t m_readQueueConfig();
+    // Проверить достигнуты ли ограничения очереди.
+    bool m_isQueueFull();
+    // Проверить превышены ли ограничения очереди.
+    bool m_isQueueOver();
+
+    //-------------------------------------------------------------------------
+
+    // Максимальное количество подписок (устройств и файлов API).
+    static const unsigned int s_maxSubs = 1024;
+    // Занятые идентификаторы подписок.
+    std::vector<bool> m_usedIds;
+    // Количество потерянных считываний по идентификаторам подписок.
+    std::unique_ptr<std::atomic<uint64_t>[]> m_drops;
+    // Общее количество потерянных считываний.
+    std::atomic<uint64_t> m_dropsTotal;
+    // Идентификаторы подписок, данные которых добавлены в пакеты текущего тика.
+    std::vector<unsigned int> m_devsSubs;
+    std::vector<unsigned int> m_apisSubs;
+    std::vector<unsigned int> m_aggSubs;
+    // Флаг наличия накопленных данных (политика MERGE).
+    bool m_merged;
+
+    // Задержка от публикации пакета до его отправки (изменяется только
+    // потоком отправки): количество пакетов, сумма и максимум в нс.
+    std::atomic<uint64_t> m_sentCnt;
+    std::atomic<uint64_t> m_latencySum;
+    std::atomic<uint64_t> m_latencyMax;
+
+    //-------------------------------------------------------------------------
+
+    // Параметры потоков чтения групп.
+    typedef struct workersCfg
+    {
+        unsigned int threads;   // Количество потоков (0 - чтение в потоке сбора статистики).
+        std::vector<int> cpus;  // Ядра для закрепления потоков.
+    } workersCfg_t;
+
+    // Задача чтения группы устройств или файлов API за тик.
+    typedef struct groupJob
+    {
+        dev::Devices * devs;            // Группа устройств (nullptr - группа файлов API).
+        dev::DevsApi * apis;            // Группа файлов API.
+        buffer::Buffer data;            // Прочитанные данные группы.
+        std::vector<unsigned int> subs; // Идентификаторы подписок группы.
+        buffer::Buffer aggData;         // Агрегаты, окно которых завершилось.
+        std::vector<unsigned int> aggSubs; // Идентификаторы подписок агрегатов.
+        buffer::Buffer eventData;       // События сработавших триггеров.
+        dev::devsRegion_t * region;     // Прочитанные регионы (nullptr - нет).
+    } groupJob_t;
+
+    // Параметры потоков чтения (читаются из конфигурационного файла).
+    workersCfg_t m_workersCfg;
+    // Пул потоков для параллельного чтения групп.
+    workers::Pool m_pool;
+    // Задачи текущего тика (используются повторно).
+    std::vector<groupJob_t> m_jobs;
+    // Количество задач текущего тика.
+    size_t m_jobsCnt;
+
+    // Прочитать параметры потоков чтения из конфигурационного файла.
+    workersCfg_t m_readWorkersConfig();
+    // Собрать группы, время считывания которых наступило.
+    void m_collectJobs();
+    // Прочитать группу (выполняется потоками пула).
+    void m_readGroup(groupJob_t & job, format_t format, encoding_t encoding);
+    // Объединить данные групп в пакеты тика в фиксированном порядке.
+    void m_mergeJobs(buffer::Buffer & devsData, buffer::Buffer & apisData,
+                     buffer::Buffer & aggData, buffer::Buffer & eventData,
+                     encoding_t encoding);
+
+    // Выделить идентификатор подписки (s_maxSubs - нет свободных).
+    unsigned int m_allocId();
+    // Освободить идентификатор подписки.
+    void m_freeId(unsigned int id);
+    // Учесть потерю считываний подписок.
+    void m_countDrops(std::vector<unsigned int> & subs);
+    // Считать данные текущего тика без передачи, учитывая потери (политика
+    // DROP_NEWEST).
+    void m_dropData();
+    // Накопить данные текущего тика (политика MERGE).
+    void m_mergeData();
+    // Добавить накопленные данные в очередь.
+    void m_addMergedToQueue();
+    // Добавить накопленные данные устройства в пакет.
+    void m_addMergedReg(dev::Devices::devEntry_t * entry,
+                        buffer::Buffer & data);
+
+    //-------------------------------------------------------------------------
+
+    // Формат записи регионов устройств.
+    std::atomic<format_t> m_format;
+    // Кодирование данных устройств.
+    std::atomic<encoding_t> m_encoding;
+    // Передача данных тика.
+    std::atomic<framing_t> m_framing;
+    // Метка начала бинарных данных устройств в пакете.
+    const std::string m_binTag = "BIN";
 
     //-------------------------------------------------------------------------
 
     // Добавить данные из устройств.
-    void m_addRegs(std::stringstream & data, dev::devsRegion_t * region);
+    void m_addRegs(buffer::Buffer & data, dev::devsRegion_t * region,
+                   format_t format, encoding_t encoding);
     // Добавить регион устройства.
-    void m_addReg(dev::region_t & reg, std::stringstream & data);
+    void m_addReg(dev::region_t & reg, buffer::Buffer & data,
+                  format_t format, encoding_t encoding);
+    // Добавить регион устройства в текстовом виде (адрес и значение).
+    void m_addRegText(dev::region_t & reg, buffer::Buffer & data);
+    // Добавить регион устройства в текстовом виде (база, количество и значения).
+    void m_addRegTextCompact(dev::region_t & reg, buffer::Buffer & data);
+    // Добавить регион устройства в бинарном виде (адрес и значение).
+    void m_addRegBin(dev::region_t & reg, buffer::Buffer & data);
+    // Добавить регион устройства в бинарном виде (база, количество и значения).
+    void m_addRegBinCompact(dev::region_t & reg, buffer::Buffer & data);
     // Добавить частоту считывания.
-    std::string m_getFreq(timers::ticks_t & ticks);
+    std::string m_getFreq(timers::period_t & period);
     // Добавить адрес в HEX формате в пакет.
-    std::string m_getHexAddr(uint32_t & addr);
+    std::string m_getHexAddr(const uint32_t & addr);
     // Добавить прочитанные данные.
-    void m_addData(std::stringstream & devsData, std::stringstream & apisData);
-    // Добавить данные устройств.
-    void m_addDevsData(std::stringstream & devsData);
-    // Добавить данные файлов API.
-    void m_addApisData(std::stringstream & apisData);
+    void m_addData(buffer::Buffer & devsData, buffer::Buffer & apisData,
+                   buffer::Buffer & aggData, buffer::Buffer & eventData,
+                   buffer::Buffer & derivedData);
+    // Добавить идентификаторы подписок устройств (withAgg - вместе с
+    // устройствами, данные которых передаются агрегатами).
+    void m_addDevsSubs(dev::Devices * devs, std::vector<unsigned int> & subs,
+                       bool withAgg = true);
+    // Добавить агрегаты устройств, окно агрегации которых завершилось.
+    void m_addAggs(dev::Devices * devs, buffer::Buffer & data,
+                   std::vector<unsigned int> & subs);
+    // Получить количество значений за sec секунд для периода (с учетом
+    // прореживания фильтрами; для окна агрегации и периода гистограмм).
+    unsigned int m_getWindow(double sec, const dev::subOpts_t & opts,
+                             timers::period_t & period);
+    // Получить параметры подписки в виде суффикса частоты (":box=10:agg=1").
+    std::string m_getOpts(const dev::subOpts_t & opts);
+    // Добавить идентификаторы подписок файлов API.
+    void m_addApisSubs(dev::DevsApi * apis, std::vector<unsigned int> & subs);
+
+    //-------------------------------------------------------------------------
+
+    // Идентификатор следующего триггера.
+    unsigned int m_nextTrigger;
+
+    // Добавить события сработавших триггеров.
+    void m_addEvents(const trig::events_t & events, buffer::Buffer & data);
+    // Получить условие триггера в виде строки запроса ("gt=100:hyst=5").
+    std::string m_getTrigDef(const trig::params_t & params);
+
+    //-------------------------------------------------------------------------
+
+    // Максимальный размер данных в одной части захвата.
+    static const size_t s_chunkSize = 8192;
+    // Идентификатор следующего захвата.
+    unsigned int m_nextCapture;
+
+    // Передать собранные захваты устройств.
+    void m_addCaptures();
+    // Передать очередные части захвата устройства, пока в очереди есть место
+    // (true - захват передан полностью).
+    bool m_pushCapture(dev::Devices::devEntry_t * entry);
+    // Есть ли в очереди место для части захвата размером bytes: части
+    // занимают не более половины ограничений очереди, остальное остается
+    // пакетам тика (в пустую очередь часть добавляется всегда).
+    bool m_hasCaptureRoom(size_t bytes);
+    // Передать гистограммы устройств, период которых завершился (одним
+    // пакетом).
+    void m_addHgrams();
+    // Добавить гистограммы устройства в пакет.
+    void m_addHgram(dev::Devices::devEntry_t * entry, buffer::Buffer & data);
+    // Количество значащих цифр границ линейных интервалов.
+    static const int s_hgramPrecision = 6;
+
+    //-------------------------------------------------------------------------
+
+    // Производный канал: выражение над значениями регистров и файлов API,
+    // которое вычисляется на каждом тике, где прочитан хотя бы один из его
+    // источников (остальные источники берутся из прошлых тиков).
+    typedef struct derived
+    {
+        std::string name;               // Имя канала.
+        std::string def;                // Исходное выражение.
+        expr::Program program;          // Скомпилированное выражение.
+        std::vector<double> values;     // Последние значения источников.
+        std::vector<bool> seen;         // Источник уже прочитан.
+        size_t missing;                 // Количество еще не прочитанных источников.
+        bool updated;                   // Источник прочитан на текущем тике.
+    } derived_t;
+
+    // Ссылка на источник производного канала (номер канала и источника).
+    typedef std::pair<size_t, size_t> derivedSrc_t;
+
+    // Максимальное количество производных каналов.
+    static const size_t s_maxDerived = 64;
+    // Максимальная длина имени производного канала.
+    static const size_t s_maxDerivedName = 64;
+    // Количество значащих цифр значения канала.
+    static const int s_derivedPrecision = 10;
+
+    // Производные каналы.
+    std::vector<derived_t> m_derived;
+    // Источники каналов по адресам регистров и alias-ам файлов API.
+    std::multimap<uint32_t, derivedSrc_t> m_derivedRegs;
+    std::multimap<std::string, derivedSrc_t> m_derivedApis;
+
+    // Прочитать производные каналы из конфигурационного файла.
+    void m_readDerivedConfig();
+    // Перестроить таблицы источников после изменения каналов.
+    void m_indexDerived();
+    // Обновить значения источников по данным прочитанной группы.
+    void m_updateDerived(groupJob_t & job);
+    // Обновить значение источника.
+    void m_setDerivedSrc(const derivedSrc_t & src, double value);
+    // Вычислить каналы, источники которых обновились, и добавить в пакет.
+    void m_addDerived(buffer::Buffer & data);
+
+    //-------------------------------------------------------------------------
+
+    // Максимальный размер истории подписки.
+    static const size_t s_maxHistoryBytes = 16 * 1024 * 1024;
+    // Максимальный общий размер буферов истории и захватов всех подписок
+    // (ограничения одной подписки не ограничивают память платы).
+    static const size_t s_maxSubsBytes = 64 * 1024 * 1024;
+    // Максимальный размер отсчетов истории в ответе на один запрос.
+    static const size_t s_maxHistoryReply = 1024 * 1024;
+
+    // Найти устройство, считываемое периодически (nullptr - не найдено).
+    dev::Devices::devEntry_t * m_findDev(uint32_t & addr, dev::Devices ** devs);
+    // Получить количество отсчетов истории (false - история не помещается).
+    bool m_getHistSamples(dev::subOpts_t & opts, unsigned int regs,
+                          timers::period_t & period);
+    // Получить размер буферов истории и захвата подписки.
+    static size_t m_getSubBytes(const dev::subOpts_t & opts, unsigned int regs);
+    // Проверить помещаются ли буферы подписки в общий объем (skip - подписка,
+    // буферы которой заменяются).
+    bool m_checkSubsBytes(const dev::subOpts_t & opts, unsigned int regs,
+                          dev::Devices::devEntry_t * skip = nullptr);
+    // Получить общий коэффициент прореживания фильтров подписки.
+    double m_getDecim(const dev::subOpts_t & opts);
+    // Проверить заданы ли параметры подписки (не поддерживаются
+    // высокочастотным считыванием).
+    bool m_hasSubOpts(const dev::subOpts_t & opts);
 
     //-------------------------------------------------------------------------
 
-    // Таймер для работы со статистикой.
-    timers::Tick m_timer;
+    // Планировщик сроков считывания групп.
+    timers::Scheduler m_timer;
+    // Периоды, сроки которых наступили в текущем пробуждении.
+    std::vector<timers::period_t> m_due;
+    // Проверить, наступил ли срок считывания группы с таким периодом.
+    bool m_isDue(const timers::period_t & period);
+    // Нагрузка на пробуждение (изменяется только потоком сбора статистики):
+    // количество пробуждений, сумма и максимум количества наступивших
+    // периодов, сумма и максимум времени обработки в нс.
+    std::atomic<uint64_t> m_loadWakes;
+    std::atomic<uint64_t> m_loadPeriods;
+    std::atomic<uint64_t> m_loadPeriodsMax;
+    std::atomic<uint64_t> m_loadBusy;
+    std::atomic<uint64_t> m_loadBusyMax;
+    // Учесть нагрузку пробуждения.
+    void m_countLoad(size_t periods, uint64_t busy);
     // Поток сбора статистики.
     std::thread m_statThread;
     // Переменная, обозначающая, что поток запущен.
@@ -147,25 +573,57 @@ private:
 
     // Проверить существует ли такая частота считывания для устройств.
     std::list<devJob_t>::const_iterator
-    m_isDevTickExist(timers::ticks_t & ticks);
+    m_isDevPeriodExist(timers::period_t & period);
     // Проверить существует ли такая частота считывания для файлов API.
     std::list<apiJob_t>::const_iterator
-    m_isFileTickExist(timers::ticks_t & ticks);
+    m_isFilePeriodExist(timers::period_t & period);
 
     //-------------------------------------------------------------------------
 
-    // Добавить устройство в пул сбора статистики.
-    void m_addDev(dev::devInfo_t & dev, timers::ticks_t & ticks);
+    // Добавить устройство в пул сбора статистики (mapped - отображение
+    // устройства, переданное пулу; nullptr - отобразить заново).
+    void m_addDev(dev::devInfo_t & dev, timers::period_t & period,
+                  unsigned int id, const dev::subOpts_t & opts,
+                  dev::Device * mapped = nullptr);
     // Добавить файл API в пул сбора статистики.
-    void m_addFile(dev::file_t & file, timers::ticks_t & ticks);
+    void m_addFile(dev::file_t & file, timers::period_t & period,
+                   unsigned int id);
+    // Добавить извлеченное устройство в пул с указанной частотой считывания.
+    void m_insertDev(dev::Devices::devEntry_t * entry, timers::period_t & period);
+    // Добавить извлеченный файл API в пул с указанной частотой считывания.
+    void m_insertFile(dev::DevsApi::apiEntry_t * entry, timers::period_t & period);
 
     //-------------------------------------------------------------------------
 
     // Сформировать пакет для отправки из полученных данных от устройств/API.
     void m_parseData();
     // Добавить пакет в очередь.
-    void m_addPkgToQueue(std::stringstream & devsData,
-                         std::stringstream & apisData);
+    void m_addPkgToQueue(buffer::Buffer & devsData, buffer::Buffer & apisData);
+    // Добавить раздел данных в пакет тика.
+    void m_addSection(const char * name, buffer::Buffer & data,
+                      buffer::Buffer & frame);
+
+    // Буферы данных тика: устройства, файлы API, агрегаты, события и
+    // производные каналы. Буферы очищаются на каждом тике без освобождения
+    // памяти, поэтому после прогрева формирование пакетов не выделяет память.
+    buffer::Buffer m_devsData;
+    buffer::Buffer m_apisData;
+    buffer::Buffer m_aggData;
+    buffer::Buffer m_eventData;
+    buffer::Buffer m_derivedData;
+    // Буфер пакета тика, накопленных данных, частей захвата и гистограмм.
+    buffer::Buffer m_pkgData;
+
+    // Номер пакета тика (увеличивается для каждого пакета тика).
+    uint64_t m_tick;
+    // Время считывания данных тика (нс, CLOCK_MONOTONIC).
+    uint64_t m_tickStamp;
+    // Метки разделов пакета тика.
+    static constexpr const char * s_devSection = "DEV";
+    static constexpr const char * s_apiSection = "API";
+    // Скопировать данные в свободный слот очереди и опубликовать его.
+    void m_pushToQueue(buffer::Buffer & data, std::vector<unsigned int> & subs,
+                       ring::type_t type = ring::type_t::STAT);
 };
 
 //=============================================================================
@@ -1,6 +1,7 @@
 #include <iostream>
-#include <thread>
+#include <algorithm>
 #include <math.h>
+#include <numeric>
 
 #include "timers.h"
 
@@ -10,64 +11,250 @@ namespace timers
 
 //=============================================================================
 
-Tick::Tick()
-    : m_curTick(1)
-{}
+Scheduler::Scheduler(hz_t maxHz)
+    : m_maxHz(maxHz), m_epoch(period_t(now())), m_changed(false), m_stat(),
+      m_latenessSum(0), m_jitterSum(0), m_lastLateness(0)
+{
+    // Сроки сна абсолютные по CLOCK_MONOTONIC, как и сроки расписания.
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    if (pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) != 0)
+        LOGGER_ERROR("Can't set scheduler wake condition clock");
+    pthread_cond_init(&m_wakeCond, &attr);
+    pthread_condattr_destroy(&attr);
+}
 
 //-----------------------------------------------------------------------------
 
-Tick & Tick::operator++()
+Scheduler::~Scheduler()
 {
-    m_curTick++;
-    if (m_curTick > m_maxTickCnt)
-        m_curTick = 1;
+    pthread_cond_destroy(&m_wakeCond);
+}
+
+//-----------------------------------------------------------------------------
+
+period_t Scheduler::hzToPeriod(hz_t & hz)
+{
+    if (hz <= 0 || hz > m_maxHz)
+        return 0;
+
+    auto period = period_t(llround(1e9 / hz));
+    if (period > m_maxPeriod)
+        return 0;
 
-    return *this;
+    return period;
 }
 
 //-----------------------------------------------------------------------------
 
-ticks_t Tick::getCurTick()
+hz_t Scheduler::periodToHz(period_t & period)
 {
-    return m_curTick;
+    auto hz = 1e9 / hz_t(period);
+    // Максимальное количество знаков после запятой - 3.
+    double f = pow(10, 3);
+    return round(hz*f) / f;
 }
 
 //-----------------------------------------------------------------------------
 
-bool Tick::isNow(ticks_t & jiffy)
+void Scheduler::add(period_t & period)
 {
-    // Если по модулю равно 0, значит время считывания наступило.
-    return !(m_curTick % jiffy);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (auto it = m_heap.begin(); it != m_heap.end(); it++)
+        {
+            // Период уже есть в расписании.
+            if (it->period == period)
+            {
+                it->refs++;
+                return;
+            }
+        }
+
+        auto offset = m_chooseOffset(period);
+        auto now = period_t(timers::now());
+        deadline_t deadline {m_firstDeadline(period, offset, now), period,
+                             offset, 1};
+        m_heap.push_back(deadline);
+        std::push_heap(m_heap.begin(), m_heap.end(), m_later);
+    }
+
+    // Новый срок может быть раньше текущего срока сна.
+    wake();
 }
 
 //-----------------------------------------------------------------------------
 
-ticks_t Tick::hzToTicks(hz_t & hz)
+void Scheduler::remove(period_t & period)
 {
-    if (hz < 0)
-        return 0;
+    std::lock_guard<std::mutex> lock(m_mutex);
 
-    if (hz <= m_maxTicks)
-        return m_maxTicks / hz;
-    else
-        return 0;
+    for (auto it = m_heap.begin(); it != m_heap.end(); it++)
+    {
+        if (it->period != period)
+            continue;
+
+        if (--it->refs)
+            return;
+
+        m_heap.erase(it);
+        std::make_heap(m_heap.begin(), m_heap.end(), m_later);
+        return;
+    }
 }
 
 //-----------------------------------------------------------------------------
 
-hz_t Tick::ticksToHz(ticks_t & ticks)
+void Scheduler::clear()
 {
-    auto hz = hz_t(m_maxTicks) / ticks;
-    // Максимальное количество знаков после запятой - 1.
-    double f = pow(10, 1);
-    return int(hz*f) / f;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_heap.resize(0);
 }
 
 //-----------------------------------------------------------------------------
 
-void Tick::sleep()
+void Scheduler::sleep()
 {
-    std::this_thread::sleep_for(std::chrono::milliseconds(m_sleepTime));
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto until = period_t(timers::now()) + m_maxSleep;
+    if (m_heap.size())
+        until = std::min(until, m_heap.front().when);
+
+    // Флаг проверяется, а ожидание начинается под m_mutex: wake не может
+    // выставить флаг между проверкой и сном, поэтому оповещение не теряется.
+    // Расписание изменилось после прошлого сна - срок будет пересчитан.
+    if (!m_changed)
+    {
+        struct timespec deadline;
+        deadline.tv_sec = time_t(until / 1000000000LL);
+        deadline.tv_nsec = long(until % 1000000000LL);
+
+        // Ожидание прерывается оповещением из wake или сроком.
+        pthread_cond_timedwait(&m_wakeCond, m_mutex.native_handle(), &deadline);
+    }
+
+    m_changed = false;
+}
+
+//-----------------------------------------------------------------------------
+
+void Scheduler::wake()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_changed = true;
+    }
+
+    pthread_cond_signal(&m_wakeCond);
+}
+
+//-----------------------------------------------------------------------------
+
+void Scheduler::popDue(std::vector<period_t> & due)
+{
+    due.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto now = period_t(timers::now());
+
+    if (!m_heap.size() || m_heap.front().when > now)
+        return;
+
+    // Точность пробуждения оценивается по ближайшему сроку.
+    auto lateness = now - m_heap.front().when;
+    m_stat.wakeups++;
+    m_latenessSum += lateness;
+    m_jitterSum += llabs(lateness - m_lastLateness);
+    m_lastLateness = lateness;
+    m_stat.maxLateness = std::max(m_stat.maxLateness, lateness);
+
+    while (m_heap.size() && m_heap.front().when <= now)
+    {
+        std::pop_heap(m_heap.begin(), m_heap.end(), m_later);
+        auto & deadline = m_heap.back();
+        due.push_back(deadline.period);
+
+        // Следующий срок отсчитывается от предыдущего срока (без накопления
+        // ошибки). Если поток отстал больше, чем на период, сроки пропускаются.
+        deadline.when += deadline.period;
+        if (deadline.when <= now)
+        {
+            auto skipped = (now - deadline.when) / deadline.period + 1;
+            deadline.when += skipped * deadline.period;
+            m_stat.missed += (unsigned long long)skipped;
+        }
+
+        std::push_heap(m_heap.begin(), m_heap.end(), m_later);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+schedStat_t Scheduler::getStat()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto stat = m_stat;
+    if (stat.wakeups)
+    {
+        stat.drift = m_latenessSum / (long long)stat.wakeups;
+        stat.jitter = m_jitterSum / (long long)stat.wakeups;
+    }
+
+    return stat;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Scheduler::m_later(const deadline_t & a, const deadline_t & b)
+{
+    return a.when > b.when;
+}
+
+//-----------------------------------------------------------------------------
+
+period_t Scheduler::m_chooseOffset(period_t & period)
+{
+    period_t best = 0;
+    period_t bestDist = -1;
+
+    for (unsigned int i = 0; i < s_phaseCandidates; i++)
+    {
+        auto offset = period * i / s_phaseCandidates;
+        // Минимальное расстояние до сроков запланированных периодов. Сроки
+        // двух периодов сближаются на величину, кратную НОД периодов, поэтому
+        // расстояние считается по модулю НОД.
+        auto dist = period;
+        for (auto it = m_heap.begin(); it != m_heap.end(); it++)
+        {
+            auto gcd = std::gcd(period, it->period);
+            auto diff = ((offset - it->offset) % gcd + gcd) % gcd;
+            dist = std::min(dist, std::min(diff, gcd - diff));
+        }
+
+        if (dist > bestDist)
+        {
+            best = offset;
+            bestDist = dist;
+        }
+    }
+
+    return best;
+}
+
+//-----------------------------------------------------------------------------
+
+period_t Scheduler::m_firstDeadline(period_t & period, period_t & offset,
+                                    period_t now)
+{
+    // Ближайший срок на сетке периода со сдвигом от начала отсчета.
+    auto elapsed = now - m_epoch - offset;
+    if (elapsed < 0)
+        return m_epoch + offset;
+
+    return m_epoch + offset + (elapsed / period + 1) * period;
 }
 
 //-----------------------------------------------------------------------------
@@ -77,6 +264,15 @@ hz_t strToHz(std::string & data)
     return stod(data);
 }
 
+//-----------------------------------------------------------------------------
+
+uint64_t now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ULL + uint64_t(ts.tv_nsec);
+}
+
 //=============================================================================
 
 } // namespace timers
@@ -1,6 +1,15 @@
 #ifndef TIMERS_H
 #define TIMERS_H
 
+//-----------------------------------------------------------------------------
+
+#include <vector>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <time.h>
+#include <stdint.h>
+
 #include "logger-library/logger.h"
 
 //-----------------------------------------------------------------------------
@@ -12,43 +21,69 @@ namespace timers
 
 // Для обозначения частоты обновления.
 typedef double hz_t;
-// Для обозначения тиков цикла.
-typedef long ticks_t;
+// Для обозначения периода считывания (в наносекундах).
+typedef long long period_t;
 
 //-------------------------------------------------------------------------
 
 // Перевести строку в Гц.
 hz_t strToHz(std::string & data);
+// Получить текущее время CLOCK_MONOTONIC в наносекундах (общие часы для
+// сроков, меток отсчетов, событий и пакетов).
+uint64_t now();
+
+//-----------------------------------------------------------------------------
+
+// Статистика точности пробуждений планировщика (в наносекундах).
+typedef struct schedStat
+{
+    unsigned long long wakeups;     // Количество пробуждений по сроку.
+    long long drift;                // Среднее опоздание пробуждения относительно срока.
+    long long jitter;               // Среднее изменение опоздания между пробуждениями.
+    long long maxLateness;          // Максимальное опоздание.
+    unsigned long long missed;      // Количество пропущенных сроков.
+} schedStat_t;
 
 //-----------------------------------------------------------------------------
 
-// Класс для работы со временем сна цикла.
-class Tick
+// Планировщик периодических сроков: для каждого периода хранится следующий
+// абсолютный срок (CLOCK_MONOTONIC), сроки упорядочены в куче, поток спит
+// ровно до ближайшего срока. Каждому периоду назначается сдвиг фазы
+// относительно общего начала отсчета, максимально удаленный от сроков уже
+// запланированных периодов, чтобы считывания разных периодов не совпадали.
+class Scheduler
 {
 public:
 
-    Tick();
-    ~Tick() {}
+    Scheduler(hz_t maxHz = s_defaultMaxHz);
+    ~Scheduler();
 
     //-------------------------------------------------------------------------
 
-    Tick & operator++();
+    // Перевести Гц в период (0 - частота недопустима).
+    period_t hzToPeriod(hz_t & hz);
+    // Перевести период в Гц.
+    hz_t periodToHz(period_t & period);
 
     //-------------------------------------------------------------------------
 
-    // Получить текущий номер тика.
-    ticks_t getCurTick();
-    // Перевести Гц в количество тиков.
-    ticks_t hzToTicks(hz_t & hz);
-    // Перевести тики в Гц.
-    hz_t ticksToHz(ticks_t & ticks);
+    // Добавить период в расписание (повторное добавление увеличивает счетчик).
+    void add(period_t & period);
+    // Удалить период из расписания (удаляется, когда счетчик станет нулевым).
+    void remove(period_t & period);
+    // Удалить все периоды из расписания.
+    void clear();
 
     //-------------------------------------------------------------------------
 
-    // Заснуть на определенный срок.
+    // Заснуть до ближайшего срока или до вызова wake (блокирующая функция).
     void sleep();
-    // Проверить наступило ли время считывания конкретного пула.
-    bool isNow(ticks_t & ticks);
+    // Прервать сон потока планировщика (после изменения расписания или для остановки).
+    void wake();
+    // Получить периоды, сроки которых наступили, и запланировать их следующие сроки.
+    void popDue(std::vector<period_t> & due);
+    // Получить статистику точности пробуждений.
+    schedStat_t getStat();
 
 private:
 
@@ -57,22 +92,61 @@ private:
 
     //-------------------------------------------------------------------------
 
-    // Для обозначения времени сна основного цикла.
-    typedef long sleepTime_t;
+    // Максимальная частота обновления по умолчанию - 100 раз в секунду.
+    static constexpr hz_t s_defaultMaxHz = 100;
+    // Максимальная частота обновления.
+    const hz_t m_maxHz;
+    // Максимальный период - сутки.
+    const period_t m_maxPeriod = 86400LL * 1000000000LL;
+    // Максимальное время сна при пустом расписании.
+    const period_t m_maxSleep = 1000000000LL;
+
+    //-------------------------------------------------------------------------
+
+    // Срок периода.
+    typedef struct deadline
+    {
+        period_t when;          // Абсолютный срок (нс, CLOCK_MONOTONIC).
+        period_t period;        // Период.
+        period_t offset;        // Сдвиг фазы относительно начала отсчета.
+        unsigned int refs;      // Количество групп с этим периодом.
+    } deadline_t;
+
+    // Для работы с расписанием.
+    std::mutex m_mutex;
+    // Куча сроков (ближайший срок - первый).
+    std::vector<deadline_t> m_heap;
+    // Начало отсчета для выравнивания сроков.
+    period_t m_epoch;
+
+    //-------------------------------------------------------------------------
+
+    // Условие для прерывания сна (ожидание по CLOCK_MONOTONIC вместе с
+    // m_mutex, поэтому оповещение из wake не теряется).
+    pthread_cond_t m_wakeCond;
+    // Флаг изменения расписания (сон нужно пересчитать, под m_mutex).
+    bool m_changed;
 
     //-------------------------------------------------------------------------
 
-    // Сколько миллисекунд спит цикл.
-    const sleepTime_t m_sleepTime = 10;
-    // Максимальная частота обновления устройств - 100 раз в секунду.
-    const ticks_t m_maxTicks = 100;
-    // Максимальное количество тиков, после которого текущий тик сбрасывается в единицу.
-    const ticks_t m_maxTickCnt = 1000;
+    // Статистика (под m_mutex).
+    schedStat_t m_stat;
+    // Сумма опозданий и изменений опоздания.
+    long long m_latenessSum;
+    long long m_jitterSum;
+    // Опоздание предыдущего пробуждения.
+    long long m_lastLateness;
 
     //-------------------------------------------------------------------------
 
-    // Для обозначения текущего тика.
-    ticks_t m_curTick;
+    // Сравнение сроков для кучи (ближайший срок наверху).
+    static bool m_later(const deadline_t & a, const deadline_t & b);
+    // Количество проверяемых сдвигов фазы нового периода.
+    static const unsigned int s_phaseCandidates = 64;
+    // Выбрать сдвиг фазы, наиболее удаленный от сроков запланированных периодов.
+    period_t m_chooseOffset(period_t & period);
+    // Первый срок периода со сдвигом фазы offset от начала отсчета.
+    period_t m_firstDeadline(period_t & period, period_t & offset, period_t now);
 };
 
 //=============================================================================
@@ -0,0 +1,241 @@
+//=============================================================================
+// Чтение колоночных записей платы и выгрузка отсчетов устройств в CSV.
+//
+// Сборка на компьютере пользователя (без библиотек платы):
+//   make recreader
+//
+// Запуск:
+//   recreader <каталог записи> [-b <база>] [-f <от, нс>] [-t <до, нс>] [-s]
+//
+// -b - выгружать только устройство с указанным базовым адресом,
+// -f/-t - диапазон меток времени (CLOCK_MONOTONIC платы),
+// -s - вывести только сводку блоков (без распаковки).
+// Блоки, которые не попадают в диапазон по минимуму/максимуму меток времени
+// из конца блока, пропускаются без распаковки.
+//=============================================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "column.h"
+
+//-----------------------------------------------------------------------------
+
+// Заголовок записи сегмента (совпадает с rec::recHeader_t).
+typedef struct recHeader
+{
+    uint32_t size;
+    uint32_t type;
+    uint64_t stamp;
+} recHeader_t;
+
+// Тип записи сегмента для блока отсчетов (rec::Recorder::s_chunkType).
+static const uint32_t s_chunkType = 0x100;
+// Выравнивание записей в сегменте.
+static const size_t s_align = 8;
+
+//-----------------------------------------------------------------------------
+
+// Параметры выгрузки.
+typedef struct options
+{
+    std::string dir;        // Каталог записи.
+    bool anyBase;           // Выгружать все устройства.
+    uint32_t base;          // Базовый адрес устройства.
+    uint64_t from;          // Начало диапазона меток времени.
+    uint64_t to;            // Конец диапазона меток времени.
+    bool summary;           // Только сводка блоков.
+} options_t;
+
+// Счетчики блоков.
+typedef struct counters
+{
+    uint64_t chunks;        // Всего блоков.
+    uint64_t skipped;       // Пропущено без распаковки.
+    uint64_t rows;          // Выгружено отсчетов.
+} counters_t;
+
+//-----------------------------------------------------------------------------
+
+static void usage(const char * name)
+{
+    fprintf(stderr, "Usage: %s <recording dir> [-b base] [-f from_ns] "
+                    "[-t to_ns] [-s]\n", name);
+}
+
+//-----------------------------------------------------------------------------
+
+static bool parseArgs(int argc, char ** argv, options_t & opts)
+{
+    opts = {"", true, 0, 0, UINT64_MAX, false};
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-b" && hasValue)
+        {
+            opts.anyBase = false;
+            opts.base = uint32_t(strtoul(argv[++i], nullptr, 0));
+        }
+        else if (arg == "-f" && hasValue)
+            opts.from = strtoull(argv[++i], nullptr, 0);
+        else if (arg == "-t" && hasValue)
+            opts.to = strtoull(argv[++i], nullptr, 0);
+        else if (arg == "-s")
+            opts.summary = true;
+        else if (arg[0] != '-' && !opts.dir.size())
+            opts.dir = arg;
+        else
+            return false;
+    }
+
+    return opts.dir.size() && opts.from <= opts.to;
+}
+
+//-----------------------------------------------------------------------------
+
+static void printChunk(const col::ChunkReader & reader, const options_t & opts,
+                       counters_t & counters)
+{
+    auto & header = reader.getHeader();
+
+    if (opts.summary)
+    {
+        auto stamps = reader.getStat(0);
+        printf("0x%08" PRIx32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu64 ",%" PRIu64,
+               header.base, header.regs, header.rows, stamps.min, stamps.max);
+        for (uint32_t i = 1; i <= header.regs; i++)
+        {
+            auto stat = reader.getStat(i);
+            printf(",%" PRIu64 "/%" PRIu64, stat.min, stat.max);
+        }
+        printf("\n");
+        return;
+    }
+
+    std::vector<std::vector<uint64_t>> columns(header.regs + 1);
+    for (uint32_t i = 0; i <= header.regs; i++)
+    {
+        if (!reader.decode(i, columns[i]))
+        {
+            fprintf(stderr, "Broken chunk of device 0x%08" PRIx32 "\n",
+                    header.base);
+            return;
+        }
+    }
+
+    for (uint32_t row = 0; row < header.rows; row++)
+    {
+        auto stamp = columns[0][row];
+        if (stamp < opts.from || stamp > opts.to)
+            continue;
+
+        printf("%" PRIu64, stamp);
+        if (opts.anyBase)
+            printf(",0x%08" PRIx32, header.base);
+        for (uint32_t i = 1; i <= header.regs; i++)
+            printf(",%" PRIu64, columns[i][row]);
+        printf("\n");
+        counters.rows++;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+static void readSegment(const std::string & path, const options_t & opts,
+                        counters_t & counters, bool & headerPrinted)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    size_t offset = 0;
+    while (offset + sizeof(recHeader_t) <= data.size())
+    {
+        recHeader_t record;
+        memcpy(&record, data.data() + offset, sizeof(record));
+        if (!record.size || offset + sizeof(record) + record.size > data.size())
+            break;
+
+        auto payload = data.data() + offset + sizeof(record);
+        offset += (sizeof(record) + record.size + s_align - 1) / s_align * s_align;
+
+        // Пакеты (события, захваты и т.д.) не выгружаются.
+        col::ChunkReader reader;
+        if (record.type != s_chunkType || !reader.open(payload, record.size))
+            continue;
+
+        counters.chunks++;
+
+        // Пропустить блок по заголовку и диапазону меток времени.
+        auto & header = reader.getHeader();
+        auto stamps = reader.getStat(0);
+        if ((!opts.anyBase && header.base != opts.base) ||
+            stamps.max < opts.from || stamps.min > opts.to)
+        {
+            counters.skipped++;
+            continue;
+        }
+
+        // Заголовок CSV для одного устройства (адреса регистров).
+        if (!opts.anyBase && !opts.summary && !headerPrinted)
+        {
+            printf("stamp");
+            for (uint32_t i = 0; i < header.regs; i++)
+                printf(",0x%08" PRIx32, header.base + i * uint32_t(sizeof(uint32_t)));
+            printf("\n");
+            headerPrinted = true;
+        }
+
+        printChunk(reader, opts, counters);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+    options_t opts;
+    if (!parseArgs(argc, argv, opts))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Сегменты читаются по порядку номеров (имена - номера с нулями).
+    std::error_code err;
+    std::vector<std::string> segments;
+    for (const auto & entry : std::filesystem::directory_iterator(opts.dir, err))
+    {
+        if (entry.path().extension() == ".rec")
+            segments.push_back(entry.path().string());
+    }
+    std::sort(segments.begin(), segments.end());
+
+    if (!segments.size())
+    {
+        fprintf(stderr, "No segments in %s\n", opts.dir.c_str());
+        return 1;
+    }
+
+    if (opts.anyBase && !opts.summary)
+        printf("stamp,base,values\n");
+
+    counters_t counters {0, 0, 0};
+    bool headerPrinted = false;
+    for (auto it = segments.begin(); it != segments.end(); it++)
+        readSegment(*it, opts, counters, headerPrinted);
+
+    fprintf(stderr, "Chunks: %" PRIu64 ", skipped: %" PRIu64 ", rows: %" PRIu64 "\n",
+            counters.chunks, counters.skipped, counters.rows);
+    return 0;
+}
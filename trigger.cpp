@@ -0,0 +1,86 @@
+#include "trigger.h"
+
+#include <cmath>
+
+//-----------------------------------------------------------------------------
+
+namespace trig
+{
+
+//=============================================================================
+
+Trigger::Trigger(unsigned int id, const params_t & params)
+    : m_id(id), m_params(params), m_state(false), m_pending(0)
+{}
+
+//-----------------------------------------------------------------------------
+
+bool Trigger::check(double value, bool & rise)
+{
+    if (m_eval(value) == m_state)
+    {
+        m_pending = 0;
+        return false;
+    }
+
+    // Дребезг: новое состояние должно держаться несколько проверок подряд.
+    if (++m_pending < m_params.debounce)
+        return false;
+
+    m_pending = 0;
+    m_state = !m_state;
+    rise = m_state;
+
+    return m_params.edge == edge_t::BOTH ||
+           (m_params.edge == edge_t::RISE) == rise;
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned int Trigger::getId() const
+{
+    return m_id;
+}
+
+//-----------------------------------------------------------------------------
+
+const params_t & Trigger::getParams() const
+{
+    return m_params;
+}
+
+//-----------------------------------------------------------------------------
+
+bool Trigger::m_eval(double value)
+{
+    switch (m_params.cond)
+    {
+    // При выполненном условии порог сдвигается на гистерезис, чтобы шум
+    // около порога не вызывал повторных срабатываний.
+    case cond_t::GT:
+        if (m_state)
+            return value > m_params.level - m_params.hyst;
+        return value > m_params.level;
+
+    case cond_t::LT:
+        if (m_state)
+            return value < m_params.level + m_params.hyst;
+        return value < m_params.level;
+
+    case cond_t::MASK:
+    {
+        // Значения файлов API и производных каналов могут быть
+        // отрицательными или больше 32 бит: преобразование идет через
+        // int64_t (как в выражениях), а вне его диапазона (и для NaN) маска
+        // применяется к нулю.
+        auto bits = fabs(value) < 9.2e18 ? uint32_t(int64_t(value)) : 0u;
+        return (bits & m_params.mask) == m_params.pattern;
+    }
+    }
+
+    return false;
+}
+
+//=============================================================================
+
+} // namespace trig
@@ -0,0 +1,96 @@
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+//-----------------------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+
+namespace trig
+{
+
+//=============================================================================
+
+// Условие срабатывания триггера.
+enum class cond_t
+{
+    GT,         // Значение больше порога.
+    LT,         // Значение меньше порога.
+    MASK        // Биты значения по маске равны образцу.
+};
+
+// Фронт условия, по которому отправляется событие.
+enum class edge_t
+{
+    RISE,       // Условие стало выполняться.
+    FALL,       // Условие перестало выполняться.
+    BOTH        // Любое изменение условия.
+};
+
+// Параметры триггера.
+typedef struct params
+{
+    cond_t cond;            // Условие срабатывания.
+    double level;           // Порог (GT, LT).
+    uint32_t mask;          // Маска (MASK).
+    uint32_t pattern;       // Образец (MASK).
+    edge_t edge;            // Фронт, по которому отправляется событие.
+    double hyst;            // Гистерезис порога (GT, LT).
+    unsigned int debounce;  // Количество подряд проверок для смены состояния.
+} params_t;
+
+// Сработавший триггер.
+typedef struct event
+{
+    unsigned int id;        // Идентификатор триггера.
+    std::string source;     // Адрес регистра или alias файла API.
+    std::string value;      // Значение, на котором сработал триггер.
+    bool rise;              // Условие стало выполняться (false - перестало).
+    uint64_t stamp;         // Время проверки в нс (CLOCK_MONOTONIC).
+} event_t;
+
+// Вектор событий.
+typedef std::vector<event_t> events_t;
+
+//-----------------------------------------------------------------------------
+
+// Триггер на значение регистра или файла API. Проверяется при каждом
+// считывании и срабатывает только при смене состояния условия.
+class Trigger
+{
+public:
+
+    Trigger(unsigned int id, const params_t & params);
+
+    //-------------------------------------------------------------------------
+
+    // Проверить значение (true - сработал, rise - направление смены условия).
+    bool check(double value, bool & rise);
+    // Получить идентификатор триггера.
+    unsigned int getId() const;
+    // Получить параметры триггера.
+    const params_t & getParams() const;
+
+private:
+
+    // Идентификатор триггера.
+    unsigned int m_id;
+    // Параметры триггера.
+    params_t m_params;
+    // Текущее состояние условия.
+    bool m_state;
+    // Количество подряд проверок с состоянием, отличным от текущего.
+    unsigned int m_pending;
+
+    // Вычислить условие для значения с учетом гистерезиса.
+    bool m_eval(double value);
+};
+
+//=============================================================================
+
+} // namespace trig
+
+#endif // TRIGGER_H
@@ -1,5 +1,9 @@
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <algorithm>
 #include <unistd.h>
+#include <errno.h>
 
 #include "udpserver.h"
 #include "netsock-library/csockaddr.h"
@@ -72,6 +76,17 @@ bool udpserver::UdpServer::start()
 
 //-----------------------------------------------------------------------------
 
+void udpserver::UdpServer::stop()
+{
+    // Прервать ожидание пакета в recvfrom (отправка остается доступной, сокет
+    // закрывается в деструкторе). Для неподключенного сокета UDP shutdown
+    // возвращает ENOTCONN, но ожидающий поток все равно пробуждается.
+    if (shutdown(m_sock, SHUT_RD) < 0 && errno != ENOTCONN)
+        LOGGER_ERROR("Can't shutdown socket");
+}
+
+//-----------------------------------------------------------------------------
+
 int udpserver::UdpServer::recvData(byte_t * buf, size_t & size)
 {
     // Если пакет укладывается в пределы.
@@ -100,6 +115,79 @@ bool udpserver::UdpServer::sendData(const byte_t * buf, const size_t & size)
 
 //-----------------------------------------------------------------------------
 
+bool udpserver::UdpServer::sendData(const byte_t * head, const size_t & headSize,
+                                    const byte_t * buf, const size_t & size)
+{
+    if (head == nullptr || buf == nullptr)
+    {
+        LOGGER_ERROR("Send buffer is nullptr");
+        return false;
+    }
+
+    // Структура адреса отправки.
+    auto send = m_sender->getBerkley();
+
+    struct iovec iov[2];
+    iov[0].iov_base = const_cast<byte_t *>(head);
+    iov[0].iov_len = headSize;
+    iov[1].iov_base = const_cast<byte_t *>(buf);
+    iov[1].iov_len = size;
+
+    struct msghdr msg = {};
+    msg.msg_name = send.addr;
+    msg.msg_namelen = send.size;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    // Отправка пакета.
+    auto ret = sendmsg(m_sock, &msg, 0);
+    return (ret > 0);
+}
+
+//-----------------------------------------------------------------------------
+
+bool udpserver::UdpServer::sendData(const pkgParts_t * pkgs, size_t count)
+{
+    // Структура адреса отправки.
+    auto send = m_sender->getBerkley();
+
+    struct iovec iov[s_batch][2];
+    struct mmsghdr msgs[s_batch];
+
+    while (count)
+    {
+        auto batch = std::min(count, s_batch);
+        for (size_t i = 0; i < batch; i++)
+        {
+            iov[i][0].iov_base = const_cast<byte_t *>(pkgs[i].head);
+            iov[i][0].iov_len = pkgs[i].headSize;
+            iov[i][1].iov_base = const_cast<byte_t *>(pkgs[i].buf);
+            iov[i][1].iov_len = pkgs[i].size;
+
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_name = send.addr;
+            msgs[i].msg_hdr.msg_namelen = send.size;
+            msgs[i].msg_hdr.msg_iov = iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 2;
+        }
+
+        // Отправка пакетов (может быть отправлено меньше, чем запрошено).
+        auto ret = sendmmsg(m_sock, msgs, (unsigned int)batch, 0);
+        if (ret <= 0)
+        {
+            LOGGER_ERROR("Can't send packets");
+            return false;
+        }
+
+        pkgs += ret;
+        count -= size_t(ret);
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
 bool udpserver::UdpServer::m_sockCreate()
 {
     // Инициализация сокета.
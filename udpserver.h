@@ -24,6 +24,15 @@ class UdpServer
 {
 public:
 
+    // Пакет из заголовка и данных (для отправки нескольких пакетов за раз).
+    typedef struct pkgParts
+    {
+        const byte_t * head;    // Заголовок пакета.
+        size_t headSize;        // Размер заголовка.
+        const byte_t * buf;     // Данные пакета.
+        size_t size;            // Размер данных.
+    } pkgParts_t;
+
     UdpServer();
     ~UdpServer();
 
@@ -40,6 +49,11 @@ public:
     int recvData(byte_t * buf, size_t & size);
     // Отправка данных пакета.
     bool sendData(const byte_t * buf, const size_t & size);
+    // Отправка пакета из заголовка и данных без их объединения в один буфер.
+    bool sendData(const byte_t * head, const size_t & headSize,
+                  const byte_t * buf, const size_t & size);
+    // Отправка нескольких пакетов за один системный вызов.
+    bool sendData(const pkgParts_t * pkgs, size_t count);
 
 private:
 
@@ -48,6 +62,8 @@ private:
 
     // Максимальный размер пакета UDP.
     DEF_CONST size_t s_udp = 65535;
+    // Максимальное количество пакетов за один вызов sendmmsg.
+    DEF_CONST size_t s_batch = 32;
     // Keep-Alive в секундах.
     struct timeval m_keepAlive;
 
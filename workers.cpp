@@ -0,0 +1,152 @@
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include "workers.h"
+
+//-----------------------------------------------------------------------------
+
+namespace workers
+{
+
+//=============================================================================
+
+Pool::Pool(unsigned int threads, const std::vector<int> & cpus)
+    : m_activated(true), m_generation(0), m_job(nullptr), m_count(0),
+      m_next(0), m_pending(0), m_active(0)
+{
+    for (unsigned int i = 0; i < threads; i++)
+    {
+        m_threads.emplace_back(m_loop, this);
+        if (!m_threads.back().joinable())
+        {
+            LOGGER_ERROR("Can't start sampling worker thread");
+            m_threads.pop_back();
+            break;
+        }
+
+        // Закрепить поток за ядром (ядра назначаются по кругу).
+        if (cpus.size())
+            m_pin(m_threads.back(), cpus[i % cpus.size()]);
+    }
+
+    std::stringstream msg;
+    msg << "Sampling workers started: " << m_threads.size();
+    LOGGER_INFO(msg.str());
+}
+
+//-----------------------------------------------------------------------------
+
+Pool::~Pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_activated = false;
+    }
+    m_jobCv.notify_all();
+
+    for (auto it = m_threads.begin(); it != m_threads.end(); it++)
+    {
+        if (it->joinable())
+            it->join();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Pool::run(size_t count, const job_t & job)
+{
+    // Без потоков или для одной задачи передача потокам не нужна.
+    if (!m_threads.size() || count <= 1)
+    {
+        for (size_t i = 0; i < count; i++)
+            job(i);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // Передать набор задач потокам.
+    m_job = &job;
+    m_count = count;
+    m_next = 0;
+    m_pending = count;
+    m_generation++;
+    m_jobCv.notify_all();
+
+    // Дождаться завершения всех задач (и выхода потоков из разбора задач,
+    // чтобы они не взяли индекс из следующего набора).
+    m_doneCv.wait(lock, [this] { return !m_pending && !m_active; });
+    m_job = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+
+size_t Pool::size()
+{
+    return m_threads.size();
+}
+
+//-----------------------------------------------------------------------------
+
+void Pool::m_loop(Pool * pool)
+{
+    uint64_t generation = 0;
+    std::unique_lock<std::mutex> lock(pool->m_mutex);
+
+    while (true)
+    {
+        pool->m_jobCv.wait(lock, [pool, generation] {
+            return pool->m_generation != generation || !pool->m_activated;
+        });
+        if (!pool->m_activated)
+            break;
+
+        generation = pool->m_generation;
+        auto job = pool->m_job;
+        auto count = pool->m_count;
+        // Набор уже выполнен другими потоками.
+        if (!job)
+            continue;
+
+        pool->m_active++;
+        lock.unlock();
+
+        // Разбирать задачи, пока они не закончатся.
+        size_t done = 0;
+        size_t i;
+        while ((i = pool->m_next.fetch_add(1)) < count)
+        {
+            (*job)(i);
+            done++;
+        }
+
+        lock.lock();
+        pool->m_active--;
+        pool->m_pending -= done;
+        if (!pool->m_pending && !pool->m_active)
+            pool->m_doneCv.notify_one();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void Pool::m_pin(std::thread & thread, int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    auto ret = pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+    if (ret != 0)
+    {
+        std::stringstream msg;
+        msg << "Can't pin sampling worker to CPU " << cpu << " (" << ret
+            << ") : " << strerror(ret);
+        LOGGER_WARNING(msg.str());
+    }
+}
+
+//=============================================================================
+
+} // namespace workers
@@ -0,0 +1,86 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+//-----------------------------------------------------------------------------
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include "logger-library/logger.h"
+
+//-----------------------------------------------------------------------------
+
+namespace workers
+{
+
+//=============================================================================
+
+// Пул потоков для параллельного выполнения задач одного тика.
+// Вызывающий поток передает количество задач и функцию задачи, потоки пула
+// разбирают задачи по индексам и вызывающий поток ждет завершения всех задач.
+class Pool
+{
+public:
+
+    // threads - количество потоков (0 - задачи выполняются вызывающим потоком),
+    // cpus - ядра для закрепления потоков (пустой - без закрепления).
+    Pool(unsigned int threads, const std::vector<int> & cpus);
+    ~Pool();
+
+    //-------------------------------------------------------------------------
+
+    // Тип задачи (аргумент - индекс задачи).
+    typedef std::function<void(size_t)> job_t;
+
+    // Выполнить count задач и дождаться их завершения (блокирующая функция).
+    void run(size_t count, const job_t & job);
+    // Получить количество потоков пула.
+    size_t size();
+
+private:
+
+    // Класс логирования.
+    logger::Logger log;
+
+    //-------------------------------------------------------------------------
+
+    // Потоки пула.
+    std::vector<std::thread> m_threads;
+    // Для блокировки при передаче задач потокам.
+    std::mutex m_mutex;
+    // Для оповещения потоков о новых задачах.
+    std::condition_variable m_jobCv;
+    // Для оповещения вызывающего потока о завершении задач.
+    std::condition_variable m_doneCv;
+    // Флаг работы потоков.
+    bool m_activated;
+    // Номер текущего набора задач (изменяется при каждом вызове run).
+    uint64_t m_generation;
+    // Функция задачи текущего набора.
+    const job_t * m_job;
+    // Количество задач текущего набора.
+    size_t m_count;
+    // Индекс следующей невыполненной задачи.
+    std::atomic<size_t> m_next;
+    // Количество незавершенных задач.
+    size_t m_pending;
+    // Количество потоков, разбирающих задачи текущего набора.
+    size_t m_active;
+
+    //-------------------------------------------------------------------------
+
+    // Функция потока пула.
+    static void m_loop(Pool * pool);
+    // Закрепить поток за ядром.
+    void m_pin(std::thread & thread, int cpu);
+};
+
+//=============================================================================
+
+} // namespace workers
+
+#endif // WORKERS_H